@@ -24,4 +24,4 @@ export VK_INSTANCE_LAYERS=VK_LAYER_KHRONOS_validation
 export VK_LAYER_PATH=/home/ace/source/Vulkan-ValidationLayers/bin/layers
 
 # run
-(gdb --batch -q -ex=run --args bin/vulkanisch.exe ${1-})
+(gdb --batch -q -ex=run --args bin/vulkanisch.exe "$@")
@@ -0,0 +1,39 @@
+#version 450
+
+// Bloom mip chain: 13-tap downsample, from the level above (bilinear sampler).
+// Overlapping 2x2 boxes, weighted so that isolated bright texels don't flicker.
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set=0, binding=1) uniform sampler2D inputPicture;
+
+vec3 fetch(vec2 offset)
+{
+  vec2 texel = 1.0 / textureSize(inputPicture, 0);
+  return texture(inputPicture, uv + offset * texel).rgb;
+}
+
+void main()
+{
+  vec3 a = fetch(vec2(-2, -2));
+  vec3 b = fetch(vec2(0, -2));
+  vec3 c = fetch(vec2(2, -2));
+  vec3 d = fetch(vec2(-2, 0));
+  vec3 e = fetch(vec2(0, 0));
+  vec3 f = fetch(vec2(2, 0));
+  vec3 g = fetch(vec2(-2, 2));
+  vec3 h = fetch(vec2(0, 2));
+  vec3 i = fetch(vec2(2, 2));
+  vec3 j = fetch(vec2(-1, -1));
+  vec3 k = fetch(vec2(1, -1));
+  vec3 l = fetch(vec2(-1, 1));
+  vec3 m = fetch(vec2(1, 1));
+
+  vec3 result = e * 0.125;
+  result += (a + c + g + i) * 0.03125;
+  result += (b + d + f + h) * 0.0625;
+  result += (j + k + l + m) * 0.125;
+
+  outColor = vec4(result, 1.0);
+}
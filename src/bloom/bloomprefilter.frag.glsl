@@ -0,0 +1,33 @@
+#version 450
+
+// First level of the bloom mip chain: threshold, then 2x2 downsample.
+// The threshold is applied per source texel, before any filtering.
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set=0, binding=1) uniform sampler2D inputPicture;
+
+vec3 threshold(ivec2 pos)
+{
+  ivec2 size = textureSize(inputPicture, 0);
+  vec3 color = texelFetch(inputPicture, min(pos, size - 1), 0).rgb;
+
+  if(length(color) < 1.5)
+    color = vec3(0);
+
+  return color;
+}
+
+void main()
+{
+  ivec2 pos = ivec2(gl_FragCoord.xy) * 2;
+
+  vec3 result = vec3(0);
+  result += threshold(pos + ivec2(0, 0));
+  result += threshold(pos + ivec2(1, 0));
+  result += threshold(pos + ivec2(0, 1));
+  result += threshold(pos + ivec2(1, 1));
+
+  outColor = vec4(result * 0.25, 1.0);
+}
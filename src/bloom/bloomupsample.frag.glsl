@@ -0,0 +1,24 @@
+#version 450
+
+// Bloom mip chain: 3x3 tent upsample, from the level below (bilinear sampler).
+// The result is blended over the current level (see 'BloomScatter').
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set=0, binding=1) uniform sampler2D inputPicture;
+
+vec3 fetch(vec2 offset)
+{
+  vec2 texel = 1.0 / textureSize(inputPicture, 0);
+  return texture(inputPicture, uv + offset * texel).rgb;
+}
+
+void main()
+{
+  vec3 result = fetch(vec2(0, 0)) * 4.0;
+  result += (fetch(vec2(-1, 0)) + fetch(vec2(1, 0)) + fetch(vec2(0, -1)) + fetch(vec2(0, 1))) * 2.0;
+  result += fetch(vec2(-1, -1)) + fetch(vec2(1, -1)) + fetch(vec2(-1, 1)) + fetch(vec2(1, 1));
+
+  outColor = vec4(result / 16.0, 1.0);
+}
@@ -1,8 +1,10 @@
 #include "common/app.h"
+#include "common/descriptorallocator.h"
 #include "common/matrix4.h"
 #include "common/util.h"
 #include "common/vkutil.h"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <vector>
@@ -122,15 +124,27 @@ struct VulkanTexture
   VkFramebuffer framebuffer;
 };
 
+// Per frame: the model transform is in 'MyPushConstantBlock'
 struct MyUniformBlock
 {
-  Matrix4f model;
   Matrix4f view;
   Matrix4f proj;
 };
 
+// Per draw, see 'shader.vert.glsl'
+struct MyPushConstantBlock
+{
+  PackedAffine model;
+};
+
 const auto HdrFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
 
+// Bloom mip chain: level 0 is half the swapchain resolution, each level halves it again
+const int BloomMipCount = 3;
+
+// Weight of the upsampled (wider) level, blended over the current one: higher spreads the bloom further
+const float BloomScatter = 0.5f;
+
 VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device)
 {
   VkDescriptorSetLayoutBinding setLayoutBindings[3]{};
@@ -209,36 +223,19 @@ void setupDescriptorSet(VkDevice device, VkDescriptorSet ds, std::vector<VulkanT
   vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
 }
 
-VkDescriptorPool createDescriptorPool(VkDevice device)
-{
-  VkDescriptorPoolSize sizes[2];
-
-  // Samplers
-  sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  sizes[0].descriptorCount = 16;
-
-  // Uniform buffers
-  sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  sizes[1].descriptorCount = 16;
-
-  // Create the global descriptor pool
-  VkDescriptorPoolCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  info.poolSizeCount = lengthof(sizes);
-  info.pPoolSizes = sizes;
-  info.maxSets = 16; // number of desc sets that can be allocated from this pool
-
-  VkDescriptorPool descriptorPool;
-  vkCreateDescriptorPool(device, &info, nullptr, &descriptorPool);
-  return descriptorPool;
-}
-
 VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout)
 {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(MyPushConstantBlock);
+
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = 1;
   pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
   VkPipelineLayout pipelineLayout;
 
@@ -350,7 +347,11 @@ VkPipeline createColorPipeline(VkDevice device, VkPipelineLayout pipelineLayout,
   return pipeline;
 }
 
-VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, const char* shaderPath)
+// With 'dynamicViewport', the viewport and scissor are set at draw time (e.g: mip chains).
+// With 'blendWithTarget', the output is blended over the target using the blend constant:
+// target = output * blendConstant + target * (1 - blendConstant)
+VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, const char* shaderPath,
+      bool dynamicViewport = false, bool blendWithTarget = false, float blendConstant = 0)
 {
   auto vertShaderCode = loadFile("bin/src/bloom/quad.vert.spv");
   auto fragShaderCode = loadFile(shaderPath);
@@ -421,6 +422,17 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   VkPipelineColorBlendAttachmentState colorBlendAttachment{};
   colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
+  if(blendWithTarget)
+  {
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_CONSTANT_COLOR;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+  }
+
   VkPipelineColorBlendStateCreateInfo colorBlending{};
   colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
   colorBlending.logicOpEnable = VK_FALSE;
@@ -428,6 +440,16 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   colorBlending.attachmentCount = 1;
   colorBlending.pAttachments = &colorBlendAttachment;
 
+  for(auto& c : colorBlending.blendConstants)
+    c = blendConstant;
+
+  const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = lengthof(dynamicStates);
+  dynamicState.pDynamicStates = dynamicStates;
+
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
   pipelineInfo.stageCount = lengthof(shaderStages);
@@ -438,6 +460,7 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   pipelineInfo.pRasterizationState = &rasterizer;
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = dynamicViewport ? &dynamicState : nullptr;
   pipelineInfo.layout = pipelineLayout;
   pipelineInfo.renderPass = renderPass;
 
@@ -467,20 +490,11 @@ VkBuffer createVertexBuffer(VkDevice device, size_t size)
   return vertexBuffer;
 }
 
-VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout)
-{
-  VkDescriptorSetAllocateInfo allocateInfo{};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocateInfo.descriptorPool = pool;
-  allocateInfo.descriptorSetCount = 1;
-  allocateInfo.pSetLayouts = &layout;
-  VkDescriptorSet result;
-  vkAllocateDescriptorSets(device, &allocateInfo, &result);
-  assert(result);
-  return result;
-}
-
-VulkanTexture createHdrOffscreenBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkRenderPass renderPass)
+VulkanTexture createHdrOffscreenBuffer(VkDevice device,
+      VkPhysicalDevice physicalDevice,
+      VkExtent2D extent,
+      VkRenderPass renderPass,
+      VkFilter filter = VK_FILTER_NEAREST)
 {
   VulkanTexture result{};
 
@@ -532,8 +546,8 @@ VulkanTexture createHdrOffscreenBuffer(VkDevice device, VkPhysicalDevice physica
   {
     VkSamplerCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    info.magFilter = VK_FILTER_NEAREST;
-    info.minFilter = VK_FILTER_NEAREST;
+    info.magFilter = filter;
+    info.minFilter = filter;
     info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
@@ -627,16 +641,17 @@ VkRenderPass createColorRenderPass(VkDevice device)
   return renderPass;
 }
 
-VkRenderPass createPostProcRenderPass(VkDevice device)
+// With VK_ATTACHMENT_LOAD_OP_LOAD, the previous content of the target is kept (blending)
+VkRenderPass createPostProcRenderPass(VkDevice device, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE)
 {
   VkAttachmentDescription attachmentDescription{};
   attachmentDescription.format = HdrFormat;
   attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-  attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachmentDescription.loadOp = loadOp;
   attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachmentDescription.initialLayout = loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
   attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
   VkAttachmentReference colorReference = {};
@@ -648,16 +663,16 @@ VkRenderPass createPostProcRenderPass(VkDevice device)
   subpass.colorAttachmentCount = 1;
   subpass.pColorAttachments = &colorReference;
 
-  // Use subpass dependencies for layout transitions
+  // Use subpass dependencies for layout transitions.
+  // The bloom passes sample the whole picture written by the previous pass: not by region.
   VkSubpassDependency dependencies[2]{};
 
   dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
   dependencies[0].dstSubpass = 0;
-  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
   dependencies[1].srcSubpass = 0;
   dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
@@ -665,7 +680,6 @@ VkRenderPass createPostProcRenderPass(VkDevice device)
   dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
   dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
   dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
   VkRenderPassCreateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -685,20 +699,24 @@ class Bloom : public IApp
 {
 public:
   Bloom(const AppCreationContext& ctx_)
-      : ctx(ctx_)
+      : descriptorAllocator(ctx_.device)
+      , ctx(ctx_)
   {
-    descriptorPool = createDescriptorPool(ctx.device);
     descriptorSetLayout = createDescriptorSetLayout(ctx.device);
 
     colorRenderPass = createColorRenderPass(ctx.device);
     postprocRenderPass = createPostProcRenderPass(ctx.device);
+    bloomUpsampleRenderPass = createPostProcRenderPass(ctx.device, VK_ATTACHMENT_LOAD_OP_LOAD);
 
     pipelineLayout = createPipelineLayout(ctx.device, descriptorSetLayout);
 
     colorPipeline = createColorPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, colorRenderPass);
-    thresholdPipeline = createPostprocPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/bloom/threshold.frag.spv");
-    horzBlurPipeline = createPostprocPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/bloom/horzblur.frag.spv");
-    vertBlurPipeline = createPostprocPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/bloom/vertblur.frag.spv");
+    prefilterPipeline =
+          createPostprocPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/bloom/bloomprefilter.frag.spv", true);
+    downsamplePipeline =
+          createPostprocPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/bloom/bloomdownsample.frag.spv", true);
+    upsamplePipeline = createPostprocPipeline(
+          ctx.device, pipelineLayout, ctx.swapchainExtent, bloomUpsampleRenderPass, "bin/src/bloom/bloomupsample.frag.spv", true, true, BloomScatter);
     tonemapPipeline = createPostprocPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, ctx.renderPass, "bin/src/bloom/tonemapping.frag.spv");
 
     // Create the vertex buffer and send it to the GPU
@@ -719,45 +737,49 @@ public:
       uniformBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, uniformBuffer);
     }
 
-    hdrBuffer[0] = createHdrOffscreenBuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, colorRenderPass);
-    hdrBuffer[1] = createHdrOffscreenBuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, postprocRenderPass);
-    hdrBuffer[2] = createHdrOffscreenBuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, postprocRenderPass);
+    hdrBuffer = createHdrOffscreenBuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, colorRenderPass);
 
-    // associate descriptor sets and buffers
-    descriptorSet[0] = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
-    setupDescriptorSet(ctx.device, descriptorSet[0], {hdrBuffer[0]}, uniformBuffer);
+    // bilinear sampling: the downsample/upsample filters rely on it
+    for(int i = 0; i < BloomMipCount; ++i)
+      bloomMips[i] = createHdrOffscreenBuffer(ctx.device, ctx.physicalDevice, getBloomMipExtent(i), postprocRenderPass, VK_FILTER_LINEAR);
 
-    descriptorSet[1] = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
-    setupDescriptorSet(ctx.device, descriptorSet[1], {hdrBuffer[1]}, uniformBuffer);
+    // associate descriptor sets and buffers
+    hdrDescriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
+    setupDescriptorSet(ctx.device, hdrDescriptorSet, {hdrBuffer}, uniformBuffer);
 
-    descriptorSet[2] = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
-    setupDescriptorSet(ctx.device, descriptorSet[2], {hdrBuffer[2]}, uniformBuffer);
+    for(int i = 0; i < BloomMipCount; ++i)
+    {
+      bloomMipDescriptorSet[i] = descriptorAllocator.allocate(descriptorSetLayout);
+      setupDescriptorSet(ctx.device, bloomMipDescriptorSet[i], {bloomMips[i]}, uniformBuffer);
+    }
 
-    descriptorSet[3] = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
-    setupDescriptorSet(ctx.device, descriptorSet[3], {hdrBuffer[0], hdrBuffer[1]}, uniformBuffer);
+    tonemapDescriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
+    setupDescriptorSet(ctx.device, tonemapDescriptorSet, {hdrBuffer, bloomMips[0]}, uniformBuffer);
   }
 
   ~Bloom()
   {
-    for(auto& buf : hdrBuffer)
-      destroyTexture(ctx.device, buf);
+    destroyTexture(ctx.device, hdrBuffer);
+
+    for(auto& mip : bloomMips)
+      destroyTexture(ctx.device, mip);
 
     vkDestroyRenderPass(ctx.device, colorRenderPass, nullptr);
     vkDestroyRenderPass(ctx.device, postprocRenderPass, nullptr);
+    vkDestroyRenderPass(ctx.device, bloomUpsampleRenderPass, nullptr);
 
     vkDestroyBuffer(ctx.device, uniformBuffer, nullptr);
     vkFreeMemory(ctx.device, uniformBufferMemory, nullptr);
     vkDestroyBuffer(ctx.device, vertexBuffer, nullptr);
     vkFreeMemory(ctx.device, vertexBufferMemory, nullptr);
     vkDestroyPipeline(ctx.device, colorPipeline, nullptr);
-    vkDestroyPipeline(ctx.device, thresholdPipeline, nullptr);
-    vkDestroyPipeline(ctx.device, horzBlurPipeline, nullptr);
-    vkDestroyPipeline(ctx.device, vertBlurPipeline, nullptr);
+    vkDestroyPipeline(ctx.device, prefilterPipeline, nullptr);
+    vkDestroyPipeline(ctx.device, downsamplePipeline, nullptr);
+    vkDestroyPipeline(ctx.device, upsamplePipeline, nullptr);
     vkDestroyPipeline(ctx.device, tonemapPipeline, nullptr);
     vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
 
     vkDestroyDescriptorSetLayout(ctx.device, descriptorSetLayout, nullptr);
-    vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
   }
 
   Camera m_camera;
@@ -766,14 +788,14 @@ public:
 
   void drawFrame(double time, VkFramebuffer framebuffer, VkCommandBuffer commandBuffer) override
   {
-    // Color render pass: write to hdrBuffer[0]
+    // Color render pass: write to hdrBuffer
     {
       VkClearValue clearColor{};
 
       VkRenderPassBeginInfo renderPassInfo{};
       renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
       renderPassInfo.renderPass = colorRenderPass;
-      renderPassInfo.framebuffer = hdrBuffer[0].framebuffer;
+      renderPassInfo.framebuffer = hdrBuffer.framebuffer;
       renderPassInfo.renderArea.offset = {0, 0};
       renderPassInfo.renderArea.extent = ctx.swapchainExtent;
       renderPassInfo.clearValueCount = 1;
@@ -787,79 +809,42 @@ public:
       VkDeviceSize offsets[] = {0};
       vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet[0], 0, nullptr);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &hdrDescriptorSet, 0, nullptr);
 
       MyUniformBlock constants{};
       const float angle = time * 3.5;
 
-      constants.model = rotateZ(angle * 0.3) * rotateY(angle * 0.2) * rotateX(angle * 0.25);
       constants.view = m_camera.mat;
       constants.proj = perspective(1.5, 4.0 / 3.0, 0.1, 100);
 
       // convert row-major (app) to column-major (GLSL)
-      constants.model = transpose(constants.model);
       constants.view = transpose(constants.view);
       constants.proj = transpose(constants.proj);
 
       writeToGpuMemory(ctx.device, uniformBufferMemory, &constants, sizeof constants);
 
-      vkCmdDraw(commandBuffer, lengthof(vertices), 1, 0, 0);
-
-      vkCmdEndRenderPass(commandBuffer);
-    }
-
-    // threshold render pass: read from hdrBuffer[0], write to hdrBuffer[1]
-    {
-      VkRenderPassBeginInfo renderPassInfo{};
-      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      renderPassInfo.renderPass = postprocRenderPass;
-      renderPassInfo.framebuffer = hdrBuffer[1].framebuffer;
-      renderPassInfo.renderArea.extent = ctx.swapchainExtent;
+      MyPushConstantBlock pushConstants{};
+      pushConstants.model = packAffine(rotateZ(angle * 0.3) * rotateY(angle * 0.2) * rotateX(angle * 0.25));
+      vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pushConstants, &pushConstants);
 
-      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, thresholdPipeline);
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet[0], 0, nullptr);
+      vkCmdDraw(commandBuffer, lengthof(vertices), 1, 0, 0);
 
-      vkCmdDraw(commandBuffer, 6, 1, 0, 0);
       vkCmdEndRenderPass(commandBuffer);
     }
 
-    for(int k = 0; k < 4; ++k)
-    {
-      // Horz blur render pass: read from hdrBuffer[1], write to hdrBuffer[2]
-      {
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = postprocRenderPass;
-        renderPassInfo.framebuffer = hdrBuffer[2].framebuffer;
-        renderPassInfo.renderArea.extent = ctx.swapchainExtent;
+    // Bloom mip chain, from half resolution.
+    // Prefilter (threshold + 2x2 downsample): read from hdrBuffer, write to bloomMips[0]
+    drawBloomPass(commandBuffer, postprocRenderPass, 0, prefilterPipeline, hdrDescriptorSet);
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, horzBlurPipeline);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet[1], 0, nullptr);
+    // Downsample: read from bloomMips[i - 1], write to bloomMips[i]
+    for(int i = 1; i < BloomMipCount; ++i)
+      drawBloomPass(commandBuffer, postprocRenderPass, i, downsamplePipeline, bloomMipDescriptorSet[i - 1]);
 
-        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-        vkCmdEndRenderPass(commandBuffer);
-      }
-
-      // Vert blur render pass: read from hdrBuffer[2], write to hdrBuffer[1]
-      {
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = postprocRenderPass;
-        renderPassInfo.framebuffer = hdrBuffer[1].framebuffer;
-        renderPassInfo.renderArea.extent = ctx.swapchainExtent;
-
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vertBlurPipeline);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet[2], 0, nullptr);
-
-        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-        vkCmdEndRenderPass(commandBuffer);
-      }
-    }
+    // Upsample: read from bloomMips[i + 1], blend over bloomMips[i]
+    for(int i = BloomMipCount - 2; i >= 0; --i)
+      drawBloomPass(commandBuffer, bloomUpsampleRenderPass, i, upsamplePipeline, bloomMipDescriptorSet[i + 1]);
 
-    // Tone-mapping render pass: read from hdrBuffer[0] and hdrBuffer[1], write to the swapchain framebuffer
+    // Tone-mapping render pass: read from hdrBuffer and bloomMips[0], write to the swapchain framebuffer
     {
       VkClearValue clearColor{};
 
@@ -874,7 +859,7 @@ public:
       vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
       vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, tonemapPipeline);
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet[3], 0, nullptr);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &tonemapDescriptorSet, 0, nullptr);
 
       vkCmdDraw(commandBuffer, 6, 1, 0, 0);
 
@@ -883,25 +868,68 @@ public:
   }
 
 private:
+  void drawBloomPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, int level, VkPipeline pipeline, VkDescriptorSet descriptorSet)
+  {
+    const VkExtent2D extent = getBloomMipExtent(level);
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = bloomMips[level].framebuffer;
+    renderPassInfo.renderArea.extent = extent;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = (float)extent.height;
+    viewport.width = (float)extent.width;
+    viewport.height = -(float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+  }
+
+  VkExtent2D getBloomMipExtent(int level) const
+  {
+    const uint32_t width = std::max(ctx.swapchainExtent.width >> (level + 1), 1u);
+    const uint32_t height = std::max(ctx.swapchainExtent.height >> (level + 1), 1u);
+    return {width, height};
+  }
+
   VkPipelineLayout pipelineLayout{};
 
   VkPipeline colorPipeline{};
-  VkPipeline thresholdPipeline{};
-  VkPipeline vertBlurPipeline{};
-  VkPipeline horzBlurPipeline{};
+  VkPipeline prefilterPipeline{};
+  VkPipeline downsamplePipeline{};
+  VkPipeline upsamplePipeline{};
   VkPipeline tonemapPipeline{};
 
   VkBuffer vertexBuffer{};
   VkDeviceMemory vertexBufferMemory{};
   VkDescriptorSetLayout descriptorSetLayout{};
-  VkDescriptorPool descriptorPool{};
-  VkDescriptorSet descriptorSet[4]{};
+  DescriptorAllocator descriptorAllocator;
+  VkDescriptorSet hdrDescriptorSet{};
+  VkDescriptorSet bloomMipDescriptorSet[BloomMipCount]{}; // samples bloomMips[i]
+  VkDescriptorSet tonemapDescriptorSet{};
   VkBuffer uniformBuffer{};
   VkDeviceMemory uniformBufferMemory{};
-  VulkanTexture hdrBuffer[3]{};
+  VulkanTexture hdrBuffer{};
+  VulkanTexture bloomMips[BloomMipCount]{};
 
   VkRenderPass colorRenderPass{};
   VkRenderPass postprocRenderPass{};
+  VkRenderPass bloomUpsampleRenderPass{};
 
   const AppCreationContext ctx;
 };
@@ -3,6 +3,6 @@ SHADERS+=$(GetMyDir)/shader.vert.glsl
 SHADERS+=$(GetMyDir)/shader.frag.glsl
 SHADERS+=$(GetMyDir)/quad.vert.glsl
 SHADERS+=$(GetMyDir)/tonemapping.frag.glsl
-SHADERS+=$(GetMyDir)/vertblur.frag.glsl
-SHADERS+=$(GetMyDir)/horzblur.frag.glsl
-SHADERS+=$(GetMyDir)/threshold.frag.glsl
+SHADERS+=$(GetMyDir)/bloomprefilter.frag.glsl
+SHADERS+=$(GetMyDir)/bloomdownsample.frag.glsl
+SHADERS+=$(GetMyDir)/bloomupsample.frag.glsl
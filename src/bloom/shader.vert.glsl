@@ -8,17 +8,22 @@ layout(location = 1) out vec3 outNormal;
 
 layout(set=0, binding=0, std140) uniform MyDescriptorSet
 {
-  mat4x4 model;
   mat4x4 view;
   mat4x4 proj;
 } UniformBlock;
 
+// Per draw: model transform (see 'PackedAffine')
+layout(push_constant) uniform MyPushConstantBlock
+{
+  vec4 modelRows[3];
+} PushConstant;
 
 void main()
 {
-  mat4x4 tx = UniformBlock.proj * UniformBlock.view * UniformBlock.model;
+  mat4x4 model = transpose(mat4x4(PushConstant.modelRows[0], PushConstant.modelRows[1], PushConstant.modelRows[2], vec4(0, 0, 0, 1)));
+  mat4x4 tx = UniformBlock.proj * UniformBlock.view * model;
   gl_Position = tx * vec4(inPosition, 1);
   outUv = vec2(0);
-  outNormal = (UniformBlock.model * vec4(inNormal, 0)).xyz;
+  outNormal = (model * vec4(inNormal, 0)).xyz;
 }
 
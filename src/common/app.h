@@ -4,6 +4,10 @@
 
 #include "matrix4.h"
 
+#include <vector>
+
+class ImmediateSubmitter;
+
 ///////////////////////////////////////////////////////////////////////////////
 // Demo app
 
@@ -27,10 +31,29 @@ struct AppCreationContext
   VkPhysicalDevice physicalDevice;
   VkRenderPass renderPass;
   VkExtent2D swapchainExtent;
+  VkFormat swapchainFormat;
+
+  // Queue 0 of each family, only used from the main thread. 'transferQueueFamily' has no graphics
+  // (a DMA engine) if the device has such a family, otherwise it's 'graphicsQueueFamily'.
+  uint32_t graphicsQueueFamily;
+  uint32_t transferQueueFamily;
+
+  // On the graphics queue, lives as long as the device: uploads and setup work (see immediatesubmit.h)
+  ImmediateSubmitter* immediate;
+
+  // One per swapchain image, in the same order.
+  // Apps writing the swapchain from their own render pass create their own framebuffers
+  // from 'swapchainImageViews', and find the image index from the framebuffer given to 'drawFrame'.
+  std::vector<VkFramebuffer> swapchainFramebuffers;
+  std::vector<VkImageView> swapchainImageViews;
 };
 
 using AppCreationFunc = IApp* (*)(const AppCreationContext& context);
 
 int registerApp(const char* name, AppCreationFunc creationFunc);
 
+// Runtime options, given on the command line as 'name=value' after the app name.
+// e.g: ./vulkanisch.exe FullDemo compact=1
+int getOption(const char* name, int defaultValue);
+
 #define REGISTER_APP(className) static int registered = registerApp(#className, [](const AppCreationContext& ctx) -> IApp* { return new className(ctx); });
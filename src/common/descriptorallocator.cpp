@@ -0,0 +1,319 @@
+#include "descriptorallocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional> // hash
+#include <stdexcept>
+
+namespace
+{
+// Descriptors per set in each pool, by type: generous enough for the layouts of the demos
+const struct
+{
+  VkDescriptorType type;
+  uint32_t countPerSet;
+} PoolRatios[] = {
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+      {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1},
+};
+
+// Sets in the first pool of a chain, each next pool has twice as many, up to 'MaxPoolSets'
+const uint32_t FirstPoolSets = 16;
+const uint32_t MaxPoolSets = 1024;
+
+VkDescriptorPool createPool(VkDevice device, uint32_t maxSets)
+{
+  std::vector<VkDescriptorPoolSize> sizes;
+
+  for(auto& ratio : PoolRatios)
+    sizes.push_back({ratio.type, ratio.countPerSet * maxSets});
+
+  VkDescriptorPoolCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  info.poolSizeCount = (uint32_t)sizes.size();
+  info.pPoolSizes = sizes.data();
+  info.maxSets = maxSets;
+
+  VkDescriptorPool pool;
+
+  if(vkCreateDescriptorPool(device, &info, nullptr, &pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor pool");
+
+  return pool;
+}
+
+bool isImageType(VkDescriptorType type)
+{
+  switch(type)
+  {
+  case VK_DESCRIPTOR_TYPE_SAMPLER:
+  case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+  case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+  case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+  case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+template<typename T>
+void hashCombine(size_t& seed, const T& value)
+{
+  seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+}
+
+DescriptorWrite bufferDescriptor(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize range, VkDeviceSize offset)
+{
+  DescriptorWrite r{};
+  r.binding = binding;
+  r.type = type;
+  r.buffer.buffer = buffer;
+  r.buffer.offset = offset;
+  r.buffer.range = range;
+  return r;
+}
+
+DescriptorWrite imageDescriptor(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+  DescriptorWrite r{};
+  r.binding = binding;
+  r.type = type;
+  r.image.sampler = sampler;
+  r.image.imageView = view;
+  r.image.imageLayout = layout;
+  return r;
+}
+
+void writeDescriptorSet(VkDevice device, VkDescriptorSet set, const std::vector<DescriptorWrite>& writes)
+{
+  std::vector<VkWriteDescriptorSet> writeInfo(writes.size());
+
+  for(size_t i = 0; i < writes.size(); ++i)
+  {
+    writeInfo[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo[i].dstSet = set;
+    writeInfo[i].dstBinding = writes[i].binding;
+    writeInfo[i].descriptorType = writes[i].type;
+    writeInfo[i].descriptorCount = 1;
+
+    if(isImageType(writes[i].type))
+      writeInfo[i].pImageInfo = &writes[i].image;
+    else
+      writeInfo[i].pBufferInfo = &writes[i].buffer;
+  }
+
+  vkUpdateDescriptorSets(device, (uint32_t)writeInfo.size(), writeInfo.data(), 0, nullptr);
+}
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device_, int frameSlotCount)
+    : device(device_)
+{
+  framePools.resize(std::max(frameSlotCount, 0));
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+  for(auto& pool : persistentPools.pools)
+    vkDestroyDescriptorPool(device, pool.pool, nullptr);
+
+  for(auto& chain : framePools)
+  {
+    for(auto& pool : chain.pools)
+      vkDestroyDescriptorPool(device, pool.pool, nullptr);
+  }
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+  stats.setCount++;
+  return allocateFrom(persistentPools, layout);
+}
+
+VkDescriptorSet DescriptorAllocator::getSet(VkDescriptorSetLayout layout, std::vector<DescriptorWrite> writes)
+{
+  std::sort(writes.begin(), writes.end(), [](const DescriptorWrite& a, const DescriptorWrite& b) { return a.binding < b.binding; });
+
+  CacheKey key{layout, std::move(writes)};
+
+  auto i = cache.find(key);
+
+  if(i != cache.end())
+  {
+    stats.cacheHits++;
+    return i->second;
+  }
+
+  VkDescriptorSet set;
+  auto& recycled = forgottenSets[layout];
+
+  if(recycled.empty())
+    set = allocate(layout);
+  else
+  {
+    set = recycled.back();
+    recycled.pop_back();
+  }
+
+  writeDescriptorSet(device, set, key.writes);
+  cache[std::move(key)] = set;
+
+  return set;
+}
+
+void DescriptorAllocator::forgetHandle(uint64_t handle)
+{
+  // null handles are the unused members of the writes
+  if(!handle)
+    return;
+
+  for(auto i = cache.begin(); i != cache.end();)
+  {
+    bool uses = false;
+
+    for(auto& write : i->first.writes)
+    {
+      uses = uses || (uint64_t)write.buffer.buffer == handle || (uint64_t)write.image.imageView == handle ||
+            (uint64_t)write.image.sampler == handle;
+    }
+
+    if(uses)
+    {
+      forgottenSets[i->first.layout].push_back(i->second);
+      i = cache.erase(i);
+    }
+    else
+      ++i;
+  }
+}
+
+void DescriptorAllocator::beginFrame(int frameIndex)
+{
+  if(framePools.empty())
+    throw std::runtime_error("descriptor allocator: no frame slots for transient sets");
+
+  currentFrameSlot = frameIndex % (int)framePools.size();
+  resetChain(framePools[currentFrameSlot]);
+}
+
+VkDescriptorSet DescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes)
+{
+  if(currentFrameSlot < 0)
+    throw std::runtime_error("descriptor allocator: transient set allocated before 'beginFrame'");
+
+  VkDescriptorSet set = allocateFrom(framePools[currentFrameSlot], layout);
+  writeDescriptorSet(device, set, writes);
+  stats.transientSetCount++;
+
+  return set;
+}
+
+void DescriptorAllocator::printSummary() const
+{
+  fprintf(stderr, "Descriptors: %d pools, %d sets (%d shared through the cache), %d transient sets over %d frame slot resets\n", stats.poolCount,
+        stats.setCount, stats.cacheHits, stats.transientSetCount, stats.transientPoolResets);
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrom(PoolChain& chain, VkDescriptorSetLayout layout)
+{
+  VkDescriptorSetAllocateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  info.descriptorSetCount = 1;
+  info.pSetLayouts = &layout;
+
+  // The pools before 'current' are full, the ones after it are empty (after a reset).
+  // Running out of descriptors of one type is only reported by the driver, with an error
+  // (VK_ERROR_OUT_OF_POOL_MEMORY with Vulkan 1.1): any error moves on to the next pool.
+  for(; chain.current < chain.pools.size(); ++chain.current)
+  {
+    auto& pool = chain.pools[chain.current];
+
+    if(pool.setCount >= pool.maxSets)
+      continue;
+
+    info.descriptorPool = pool.pool;
+
+    VkDescriptorSet set;
+
+    if(vkAllocateDescriptorSets(device, &info, &set) == VK_SUCCESS)
+    {
+      pool.setCount++;
+      return set;
+    }
+  }
+
+  Pool pool{};
+  pool.maxSets = std::min(FirstPoolSets << std::min<size_t>(chain.pools.size(), 16), MaxPoolSets);
+  pool.pool = createPool(device, pool.maxSets);
+  pool.setCount = 1;
+  chain.pools.push_back(pool);
+  stats.poolCount++;
+
+  info.descriptorPool = pool.pool;
+
+  VkDescriptorSet set;
+
+  // a fresh pool which can't hold one set: the layout needs more than 'PoolRatios' gives
+  if(vkAllocateDescriptorSets(device, &info, &set) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate descriptor set: layout too large for the pool sizes");
+
+  return set;
+}
+
+void DescriptorAllocator::resetChain(PoolChain& chain)
+{
+  for(auto& pool : chain.pools)
+  {
+    vkResetDescriptorPool(device, pool.pool, 0);
+    pool.setCount = 0;
+  }
+
+  chain.current = 0;
+  stats.transientPoolResets++;
+}
+
+bool DescriptorAllocator::CacheKey::operator==(const CacheKey& other) const
+{
+  if(layout != other.layout || writes.size() != other.writes.size())
+    return false;
+
+  for(size_t i = 0; i < writes.size(); ++i)
+  {
+    auto& a = writes[i];
+    auto& b = other.writes[i];
+
+    if(a.binding != b.binding || a.type != b.type)
+      return false;
+
+    if(a.buffer.buffer != b.buffer.buffer || a.buffer.offset != b.buffer.offset || a.buffer.range != b.buffer.range)
+      return false;
+
+    if(a.image.sampler != b.image.sampler || a.image.imageView != b.image.imageView || a.image.imageLayout != b.image.imageLayout)
+      return false;
+  }
+
+  return true;
+}
+
+size_t DescriptorAllocator::CacheKeyHash::operator()(const CacheKey& key) const
+{
+  size_t seed = 0;
+  hashCombine(seed, (uint64_t)key.layout);
+
+  for(auto& write : key.writes)
+  {
+    hashCombine(seed, write.binding);
+    hashCombine(seed, (int)write.type);
+    hashCombine(seed, (uint64_t)write.buffer.buffer);
+    hashCombine(seed, write.buffer.offset);
+    hashCombine(seed, (uint64_t)write.image.imageView);
+    hashCombine(seed, (uint64_t)write.image.sampler);
+  }
+
+  return seed;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "glad/vulkan.h"
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Descriptor set allocation
+//
+// Pools are created on demand, with generic sizes, each new one twice as large as
+// the previous one: apps don't size pools. Three kinds of sets:
+// - 'allocate': lives as long as the allocator, written by the app,
+// - 'getSet': described by its layout and its descriptors. The same description
+//   gives back the same set, written once. The cache is keyed on the handle values:
+//   before destroying a buffer, view or sampler used by such sets, call 'forget' with it,
+//   or a new object with the same handle value would get the stale set,
+// - 'allocateTransient': only valid until its frame slot comes back (see 'beginFrame').
+//   The pools of a slot are reset as a whole, no set is freed individually.
+//
+//   DescriptorAllocator descriptors(device);
+//   auto set = descriptors.getSet(layout, {bufferDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer, size)});
+
+struct DescriptorWrite
+{
+  uint32_t binding;
+  VkDescriptorType type;
+  VkDescriptorBufferInfo buffer; // buffer types
+  VkDescriptorImageInfo image; // image types, the sampler is ignored by storage images and input attachments
+};
+
+DescriptorWrite bufferDescriptor(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize range, VkDeviceSize offset = 0);
+DescriptorWrite imageDescriptor(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout);
+
+void writeDescriptorSet(VkDevice device, VkDescriptorSet set, const std::vector<DescriptorWrite>& writes);
+
+struct DescriptorAllocatorStats
+{
+  int poolCount = 0;
+  int setCount = 0; // 'allocate', and the cache misses of 'getSet'
+  int cacheHits = 0; // 'getSet' calls which returned an existing set
+  int transientSetCount = 0; // since the creation of the allocator
+  int transientPoolResets = 0;
+};
+
+class DescriptorAllocator
+{
+public:
+  // 'frameSlotCount': number of transient slots, greater than the number of frames in flight (0: no transient sets)
+  DescriptorAllocator(VkDevice device, int frameSlotCount = 0);
+  ~DescriptorAllocator();
+
+  DescriptorAllocator(const DescriptorAllocator&) = delete;
+  DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+  VkDescriptorSet getSet(VkDescriptorSetLayout layout, std::vector<DescriptorWrite> writes);
+
+  // Drops the cached sets using 'handle' (a VkBuffer, VkImageView or VkSampler). The GPU must be
+  // done with them: they're recycled by the next cache misses of 'getSet' with the same layout.
+  template<typename Handle>
+  void forget(Handle handle)
+  {
+    forgetHandle((uint64_t)handle);
+  }
+
+  // Resets the pools of the slot 'frameIndex % frameSlotCount': the GPU must be done with
+  // the frame which last used it. The transient sets are then allocated from this slot.
+  void beginFrame(int frameIndex);
+  VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout, const std::vector<DescriptorWrite>& writes);
+
+  const DescriptorAllocatorStats& getStats() const { return stats; }
+
+  // One line, to stderr
+  void printSummary() const;
+
+private:
+  struct Pool
+  {
+    VkDescriptorPool pool;
+    uint32_t maxSets;
+    uint32_t setCount = 0;
+  };
+
+  // Pools of growing sizes, filled in order
+  struct PoolChain
+  {
+    std::vector<Pool> pools;
+    size_t current = 0;
+  };
+
+  struct CacheKey
+  {
+    VkDescriptorSetLayout layout;
+    std::vector<DescriptorWrite> writes; // sorted by binding
+
+    bool operator==(const CacheKey& other) const;
+  };
+
+  struct CacheKeyHash
+  {
+    size_t operator()(const CacheKey& key) const;
+  };
+
+  VkDescriptorSet allocateFrom(PoolChain& chain, VkDescriptorSetLayout layout);
+  void forgetHandle(uint64_t handle);
+  void resetChain(PoolChain& chain);
+
+  const VkDevice device;
+
+  PoolChain persistentPools;
+  std::vector<PoolChain> framePools; // one per slot
+  int currentFrameSlot = -1;
+
+  std::unordered_map<CacheKey, VkDescriptorSet, CacheKeyHash> cache;
+  std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> forgottenSets; // by layout, see 'forget'
+
+  DescriptorAllocatorStats stats;
+};
@@ -0,0 +1,767 @@
+#include "framegraph.h"
+
+#include "vkutil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace
+{
+bool isDepthFormat(VkFormat format)
+{
+  switch(format)
+  {
+  case VK_FORMAT_D16_UNORM:
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_X8_D24_UNORM_PACK32:
+  case VK_FORMAT_D32_SFLOAT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Layout of the images between passes
+VkImageLayout getReadLayout(VkFormat format)
+{
+  return isDepthFormat(format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+// Stages and accesses of a pass writing to an attachment of this format
+VkPipelineStageFlags getAttachmentStages(VkFormat format)
+{
+  if(isDepthFormat(format))
+    return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+  return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+}
+
+VkAccessFlags getAttachmentWriteAccess(VkFormat format)
+{
+  return isDepthFormat(format) ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+}
+
+VkAccessFlags getAttachmentAccess(VkFormat format)
+{
+  if(isDepthFormat(format))
+    return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+}
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+double toMegabytes(VkDeviceSize size) { return size / (1024.0 * 1024.0); }
+}
+
+FrameGraph::FrameGraph(VkDevice device_, VkPhysicalDevice physicalDevice_)
+    : device(device_)
+    , physicalDevice(physicalDevice_)
+{
+}
+
+FrameGraph::~FrameGraph()
+{
+  for(auto& pass : passes)
+  {
+    vkDestroyFramebuffer(device, pass.framebuffer, nullptr);
+    vkDestroyRenderPass(device, pass.renderPass, nullptr);
+  }
+
+  for(auto& image : images)
+  {
+    if(image.imported)
+      continue;
+
+    for(auto view : image.layerViews)
+      vkDestroyImageView(device, view, nullptr);
+
+    vkDestroySampler(device, image.sampler, nullptr);
+    vkDestroyImageView(device, image.view, nullptr);
+    vkDestroyImage(device, image.image, nullptr);
+  }
+
+  vkFreeMemory(device, memory, nullptr);
+}
+
+FrameGraphImage FrameGraph::createImage(const char* name, VkExtent2D extent, VkFormat format, VkFilter filter, VkImageUsageFlags extraUsage)
+{
+  if(planned)
+    throw std::runtime_error("frame graph: can't create images after 'compile'");
+
+  Image image{};
+  image.name = name;
+  image.extent = extent;
+  image.format = format;
+  image.filter = filter;
+  image.usage = extraUsage;
+  images.push_back(image);
+
+  return (int)images.size() - 1;
+}
+
+FrameGraphImage FrameGraph::createImageArray(const char* name, VkExtent2D extent, uint32_t layerCount, VkFormat format, VkFilter filter)
+{
+  const FrameGraphImage result = createImage(name, extent, format, filter);
+  images[result].array = true;
+  images[result].layerCount = layerCount;
+  return result;
+}
+
+FrameGraphImage FrameGraph::importImage(const char* name, VkExtent2D extent, VkFormat format, VkImage vkImage, VkImageView view, VkSampler sampler)
+{
+  if(planned)
+    throw std::runtime_error("frame graph: can't import images after 'compile'");
+
+  Image image{};
+  image.name = name;
+  image.extent = extent;
+  image.format = format;
+  image.imported = true;
+  image.image = vkImage;
+  image.view = view;
+  image.sampler = sampler;
+  images.push_back(image);
+
+  return (int)images.size() - 1;
+}
+
+void FrameGraph::addPass(FrameGraphPassDesc desc)
+{
+  if(planned)
+    throw std::runtime_error("frame graph: can't add passes after 'compile'");
+
+  if(desc.depthWrite.size() > 1)
+    throw std::runtime_error("frame graph: a pass can only write one depth attachment");
+
+  if(desc.colorWrites.empty() && desc.depthWrite.empty())
+    throw std::runtime_error("frame graph: a pass must write at least one attachment");
+
+  for(auto& write : desc.colorWrites)
+  {
+    if(std::find(desc.reads.begin(), desc.reads.end(), write.image) != desc.reads.end())
+      throw std::runtime_error("frame graph: a pass can't sample an image it renders to");
+  }
+
+  for(auto& write : desc.colorWrites)
+  {
+    if(write.layer >= images[write.image].layerCount)
+      throw std::runtime_error("frame graph: pass '" + desc.name + "' renders to a layer out of its image");
+  }
+
+  for(auto& write : desc.depthWrite)
+  {
+    if(write.layer >= images[write.image].layerCount)
+      throw std::runtime_error("frame graph: pass '" + desc.name + "' renders to a layer out of its image");
+  }
+
+  Pass pass{};
+  pass.desc = std::move(desc);
+  passes.push_back(std::move(pass));
+}
+
+void FrameGraph::markOutput(FrameGraphImage image) { images[image].output = true; }
+void FrameGraph::markHistory(FrameGraphImage image) { images[image].history = true; }
+
+void FrameGraph::setSamplerCompare(FrameGraphImage image, VkCompareOp op)
+{
+  if(planned || images[image].imported)
+    throw std::runtime_error("frame graph: the sampler of '" + images[image].name + "' can't be changed");
+
+  images[image].compare = true;
+  images[image].compareOp = op;
+}
+
+void FrameGraph::compile()
+{
+  plan();
+  allocateImages(true);
+
+  for(int passIndex : executedPasses)
+  {
+    if(!passes[passIndex].desc.external)
+      createRenderPass(passes[passIndex]);
+  }
+
+  computeBarriers();
+
+  compiled = true;
+}
+
+void FrameGraph::computeMemoryLayout()
+{
+  plan();
+  allocateImages(false);
+}
+
+void FrameGraph::plan()
+{
+  if(planned)
+    throw std::runtime_error("frame graph: already compiled");
+
+  cullPasses();
+  computeLifetimes();
+
+  planned = true;
+}
+
+// Walks the passes backwards, from the outputs: a pass is needed if something needed
+// reads what it writes. Overwriting an image ends the need for its previous content.
+// The need is tracked per layer: passes rendering to the layers of an array image are independent.
+void FrameGraph::cullPasses()
+{
+  std::vector<std::vector<bool>> needed(images.size());
+
+  for(size_t i = 0; i < images.size(); ++i)
+    needed[i].assign(images[i].layerCount, images[i].output || images[i].history);
+
+  for(int i = (int)passes.size() - 1; i >= 0; --i)
+  {
+    auto& pass = passes[i];
+
+    std::vector<FrameGraphWrite> writes = pass.desc.colorWrites;
+    writes.insert(writes.end(), pass.desc.depthWrite.begin(), pass.desc.depthWrite.end());
+
+    pass.culled = true;
+
+    for(auto& write : writes)
+    {
+      if(needed[write.image][write.layer])
+        pass.culled = false;
+    }
+
+    if(pass.culled)
+      continue;
+
+    // imported images belong to the app: their content is always kept
+    for(auto& write : pass.desc.colorWrites)
+      pass.storeColor.push_back(needed[write.image][write.layer] || images[write.image].imported);
+
+    for(auto& write : pass.desc.depthWrite)
+      pass.storeDepth = needed[write.image][write.layer] || images[write.image].imported;
+
+    for(auto& write : writes)
+      needed[write.image][write.layer] = write.load == FrameGraphLoad::Keep;
+
+    for(auto image : pass.desc.reads)
+      needed[image].assign(images[image].layerCount, true);
+  }
+
+  for(size_t i = 0; i < images.size(); ++i)
+  {
+    const bool neededBefore = std::find(needed[i].begin(), needed[i].end(), true) != needed[i].end();
+
+    if(neededBefore && !images[i].imported && !images[i].history)
+      throw std::runtime_error("frame graph: transient image '" + images[i].name + "' is read before being written");
+  }
+
+  for(size_t i = 0; i < passes.size(); ++i)
+  {
+    if(!passes[i].culled)
+      executedPasses.push_back((int)i);
+  }
+}
+
+void FrameGraph::computeLifetimes()
+{
+  for(int k = 0; k < (int)executedPasses.size(); ++k)
+  {
+    auto& desc = passes[executedPasses[k]].desc;
+
+    std::vector<FrameGraphImage> used = desc.reads;
+
+    for(auto& write : desc.colorWrites)
+      used.push_back(write.image);
+
+    for(auto& write : desc.depthWrite)
+      used.push_back(write.image);
+
+    for(auto index : used)
+    {
+      auto& image = images[index];
+
+      if(image.firstUse < 0)
+        image.firstUse = k;
+
+      image.lastUse = k;
+    }
+  }
+
+  // outputs are read after the graph, history images are alive across frames
+  for(auto& image : images)
+  {
+    if((image.output || image.history) && image.firstUse >= 0)
+      image.lastUse = (int)executedPasses.size();
+
+    if(image.history && image.firstUse >= 0)
+      image.firstUse = 0;
+  }
+}
+
+// Creates the transient images, then places them in one allocation.
+// Biggest images first: each one goes at the lowest offset where it doesn't overlap
+// the memory of an image alive at the same time.
+// Without 'bindMemory', the images are only created for their memory requirements.
+void FrameGraph::allocateImages(bool bindMemory)
+{
+  std::vector<int> order;
+  uint32_t memoryTypeBits = ~0u;
+
+  for(int i = 0; i < (int)images.size(); ++i)
+  {
+    auto& image = images[i];
+
+    if(image.imported || image.firstUse < 0)
+      continue;
+
+    const bool depth = isDepthFormat(image.format);
+
+    VkImageCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.extent = {image.extent.width, image.extent.height, 1};
+    info.format = image.format;
+    info.mipLevels = 1;
+    info.arrayLayers = image.layerCount;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    info.usage = (depth ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) | VK_IMAGE_USAGE_SAMPLED_BIT | image.usage;
+
+    if(vkCreateImage(device, &info, nullptr, &image.image) != VK_SUCCESS)
+      throw std::runtime_error("frame graph: failed to create image '" + image.name + "'");
+
+    order.push_back(i);
+  }
+
+  if(order.empty())
+    return;
+
+  std::vector<VkMemoryRequirements> requirements(images.size());
+
+  for(int i : order)
+  {
+    vkGetImageMemoryRequirements(device, images[i].image, &requirements[i]);
+    memoryTypeBits &= requirements[i].memoryTypeBits;
+    images[i].memorySize = requirements[i].size;
+    unaliasedMemorySize += requirements[i].size;
+  }
+
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return requirements[a].size > requirements[b].size; });
+
+  std::vector<int> placed;
+
+  for(int i : order)
+  {
+    auto& image = images[i];
+    const VkDeviceSize alignment = requirements[i].alignment;
+
+    auto overlapsInTime = [&](const Image& other) { return other.firstUse <= image.lastUse && image.firstUse <= other.lastUse; };
+
+    auto fitsAt = [&](VkDeviceSize offset) {
+      for(int j : placed)
+      {
+        auto& other = images[j];
+
+        if(overlapsInTime(other) && offset < other.memoryOffset + other.memorySize && other.memoryOffset < offset + image.memorySize)
+          return false;
+      }
+
+      return true;
+    };
+
+    VkDeviceSize best = 0;
+
+    if(!fitsAt(0))
+    {
+      best = ~VkDeviceSize(0);
+
+      for(int j : placed)
+      {
+        auto& other = images[j];
+        const VkDeviceSize candidate = alignUp(other.memoryOffset + other.memorySize, alignment);
+
+        if(overlapsInTime(other) && candidate < best && fitsAt(candidate))
+          best = candidate;
+      }
+    }
+
+    image.memoryOffset = best;
+    memorySize = std::max(memorySize, best + image.memorySize);
+    placed.push_back(i);
+  }
+
+  if(!bindMemory)
+  {
+    for(int i : order)
+    {
+      vkDestroyImage(device, images[i].image, nullptr);
+      images[i].image = VK_NULL_HANDLE;
+    }
+
+    return;
+  }
+
+  {
+    VkMemoryAllocateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize = memorySize;
+    info.memoryTypeIndex = findMemoryType(physicalDevice, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if(vkAllocateMemory(device, &info, nullptr, &memory) != VK_SUCCESS)
+      throw std::runtime_error("frame graph: failed to allocate image memory");
+  }
+
+  for(int i : order)
+  {
+    auto& image = images[i];
+    const bool depth = isDepthFormat(image.format);
+
+    vkBindImageMemory(device, image.image, memory, image.memoryOffset);
+
+    {
+      VkImageViewCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      info.viewType = image.array ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+      info.format = image.format;
+      info.subresourceRange = {VkImageAspectFlags(depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT), 0, 1, 0, image.layerCount};
+      info.image = image.image;
+      vkCreateImageView(device, &info, nullptr, &image.view);
+
+      // framebuffer attachments: a single layer
+      if(image.array)
+      {
+        image.layerViews.resize(image.layerCount);
+
+        for(uint32_t layer = 0; layer < image.layerCount; ++layer)
+        {
+          info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+          info.subresourceRange.baseArrayLayer = layer;
+          info.subresourceRange.layerCount = 1;
+          vkCreateImageView(device, &info, nullptr, &image.layerViews[layer]);
+        }
+      }
+    }
+
+    {
+      VkSamplerCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+      info.magFilter = image.filter;
+      info.minFilter = image.filter;
+      info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+      info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+      info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+      info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+      info.compareEnable = image.compare;
+      info.compareOp = image.compareOp;
+      info.maxAnisotropy = 1.0f;
+      info.maxLod = 1.0f;
+      info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+      vkCreateSampler(device, &info, nullptr, &image.sampler);
+    }
+  }
+}
+
+// One subpass, no dependencies: the barriers are recorded by 'execute'.
+// Every attachment ends in its read layout, whether it's stored or not.
+void FrameGraph::createRenderPass(Pass& pass)
+{
+  std::vector<VkAttachmentDescription> attachments;
+  std::vector<VkAttachmentReference> colorReferences;
+  VkAttachmentReference depthReference{};
+  std::vector<VkImageView> views;
+
+  auto addAttachment = [&](const FrameGraphWrite& write, bool store) {
+    auto& image = images[write.image];
+
+    if(attachments.empty())
+      pass.extent = image.extent;
+    else if(image.extent.width != pass.extent.width || image.extent.height != pass.extent.height)
+      throw std::runtime_error("frame graph: the attachments of pass '" + pass.desc.name + "' don't have the same size");
+
+    const VkAttachmentLoadOp loadOps[] = {VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_LOAD};
+    const bool keep = write.load == FrameGraphLoad::Keep;
+
+    VkAttachmentDescription description{};
+    description.format = image.format;
+    description.samples = VK_SAMPLE_COUNT_1_BIT;
+    description.loadOp = loadOps[(int)write.load];
+    description.storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    description.initialLayout = keep ? getReadLayout(image.format) : VK_IMAGE_LAYOUT_UNDEFINED;
+    description.finalLayout = getReadLayout(image.format);
+
+    attachments.push_back(description);
+    views.push_back(image.array ? image.layerViews[write.layer] : image.view);
+
+    return (uint32_t)attachments.size() - 1;
+  };
+
+  for(size_t i = 0; i < pass.desc.colorWrites.size(); ++i)
+    colorReferences.push_back({addAttachment(pass.desc.colorWrites[i], pass.storeColor[i]), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+
+  for(auto& write : pass.desc.depthWrite)
+    depthReference = {addAttachment(write, pass.storeDepth), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = (uint32_t)colorReferences.size();
+  subpass.pColorAttachments = colorReferences.data();
+  subpass.pDepthStencilAttachment = pass.desc.depthWrite.empty() ? nullptr : &depthReference;
+
+  {
+    VkRenderPassCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    info.attachmentCount = (uint32_t)attachments.size();
+    info.pAttachments = attachments.data();
+    info.subpassCount = 1;
+    info.pSubpasses = &subpass;
+
+    if(vkCreateRenderPass(device, &info, nullptr, &pass.renderPass) != VK_SUCCESS)
+      throw std::runtime_error("frame graph: failed to create render pass '" + pass.desc.name + "'");
+  }
+
+  {
+    VkFramebufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    info.renderPass = pass.renderPass;
+    info.attachmentCount = (uint32_t)views.size();
+    info.pAttachments = views.data();
+    info.width = pass.extent.width;
+    info.height = pass.extent.height;
+    info.layers = 1;
+
+    if(vkCreateFramebuffer(device, &info, nullptr, &pass.framebuffer) != VK_SUCCESS)
+      throw std::runtime_error("frame graph: failed to create framebuffer '" + pass.desc.name + "'");
+  }
+}
+
+// For each pass, merges into one barrier:
+// - read after write: the last writer of each sampled image,
+// - write after read/write: the readers and the last writer of each attachment,
+// - aliasing: the last users of the images previously living in the same memory.
+// Everything happening before the graph (imported images, previous frame) is covered by 'execute'.
+void FrameGraph::computeBarriers()
+{
+  struct State
+  {
+    VkPipelineStageFlags writerStages = 0;
+    VkAccessFlags writerAccess = 0;
+    VkPipelineStageFlags readerStages = 0;
+  };
+
+  // per layer
+  std::vector<std::vector<State>> states(images.size());
+
+  for(size_t i = 0; i < images.size(); ++i)
+    states[i].resize(images[i].layerCount);
+
+  auto sharesMemory = [&](const Image& a, const Image& b) {
+    return !a.imported && !b.imported && a.memoryOffset < b.memoryOffset + b.memorySize && b.memoryOffset < a.memoryOffset + a.memorySize;
+  };
+
+  for(int k = 0; k < (int)executedPasses.size(); ++k)
+  {
+    auto& pass = passes[executedPasses[k]];
+
+    for(auto index : pass.desc.reads)
+    {
+      for(auto& state : states[index])
+      {
+        if(state.writerStages)
+        {
+          pass.srcStages |= state.writerStages;
+          pass.srcAccess |= state.writerAccess;
+          pass.dstStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+          pass.dstAccess |= VK_ACCESS_SHADER_READ_BIT;
+        }
+      }
+    }
+
+    std::vector<FrameGraphWrite> writes = pass.desc.colorWrites;
+    writes.insert(writes.end(), pass.desc.depthWrite.begin(), pass.desc.depthWrite.end());
+
+    for(auto& write : writes)
+    {
+      auto& image = images[write.image];
+      auto& state = states[write.image][write.layer];
+      const VkPipelineStageFlags stages = getAttachmentStages(image.format);
+      const VkAccessFlags access = getAttachmentAccess(image.format);
+
+      // execution dependency only
+      if(state.readerStages)
+      {
+        pass.srcStages |= state.readerStages;
+        pass.dstStages |= stages;
+      }
+
+      if(state.writerStages)
+      {
+        pass.srcStages |= state.writerStages;
+        pass.srcAccess |= state.writerAccess;
+        pass.dstStages |= stages;
+        pass.dstAccess |= access;
+      }
+
+      if(image.firstUse == k)
+      {
+        for(auto& other : images)
+        {
+          if(&other == &image || other.lastUse < 0 || other.lastUse >= k || !sharesMemory(image, other))
+            continue;
+
+          pass.srcStages |= getAttachmentStages(other.format) | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+          pass.srcAccess |= getAttachmentWriteAccess(other.format);
+          pass.dstStages |= stages;
+          pass.dstAccess |= access;
+        }
+      }
+    }
+
+    for(auto index : pass.desc.reads)
+    {
+      for(auto& state : states[index])
+        state.readerStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
+
+    for(auto& write : writes)
+    {
+      auto& state = states[write.image][write.layer];
+      state.writerStages = getAttachmentStages(images[write.image].format);
+      state.writerAccess = getAttachmentWriteAccess(images[write.image].format);
+      state.readerStages = 0;
+    }
+  }
+}
+
+void FrameGraph::execute(VkCommandBuffer commandBuffer)
+{
+  if(!compiled)
+    throw std::runtime_error("frame graph: 'compile' must be called before 'execute'");
+
+  if(executedPasses.empty())
+    return;
+
+  // Before the graph: the app wrote the imported images (attachments, compute, transfers),
+  // and the previous frame may still be using the memory of the transient images.
+  {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    const VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    const VkPipelineStageFlags dstStages =
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  for(int passIndex : executedPasses)
+  {
+    auto& pass = passes[passIndex];
+
+    if(pass.srcStages)
+    {
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = pass.srcAccess;
+      barrier.dstAccessMask = pass.dstAccess;
+
+      vkCmdPipelineBarrier(commandBuffer, pass.srcStages, pass.dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    if(pass.desc.external)
+    {
+      pass.desc.record(commandBuffer);
+      continue;
+    }
+
+    std::vector<VkClearValue> clearValues;
+
+    for(auto& write : pass.desc.colorWrites)
+      clearValues.push_back(write.clearValue);
+
+    for(auto& write : pass.desc.depthWrite)
+      clearValues.push_back(write.clearValue);
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = pass.renderPass;
+    renderPassInfo.framebuffer = pass.framebuffer;
+    renderPassInfo.renderArea.extent = pass.extent;
+    renderPassInfo.clearValueCount = (uint32_t)clearValues.size();
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    pass.desc.record(commandBuffer);
+    vkCmdEndRenderPass(commandBuffer);
+  }
+
+  // After the graph: the outputs get sampled, or copied
+  {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+    const VkPipelineStageFlags srcStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    const VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+}
+
+const FrameGraph::Pass& FrameGraph::findPass(const char* passName) const
+{
+  for(auto& pass : passes)
+  {
+    if(pass.desc.name == passName)
+      return pass;
+  }
+
+  throw std::runtime_error(std::string("frame graph: unknown pass '") + passName + "'");
+}
+
+VkRenderPass FrameGraph::getRenderPass(const char* passName) const
+{
+  auto& pass = findPass(passName);
+
+  if(!compiled || pass.culled || pass.desc.external)
+    throw std::runtime_error(std::string("frame graph: pass '") + passName + "' has no render pass");
+
+  return pass.renderPass;
+}
+
+bool FrameGraph::isCulled(const char* passName) const { return findPass(passName).culled; }
+
+VkImage FrameGraph::getImage(FrameGraphImage image) const { return images[image].image; }
+VkImageView FrameGraph::getView(FrameGraphImage image) const { return images[image].view; }
+VkSampler FrameGraph::getSampler(FrameGraphImage image) const { return images[image].sampler; }
+
+void FrameGraph::printSummary() const
+{
+  for(auto& pass : passes)
+    fprintf(stderr, "  pass '%s': %s\n", pass.desc.name.c_str(), pass.culled ? "culled" : pass.desc.external ? "executed (external)" : "executed");
+
+  for(auto& image : images)
+  {
+    if(image.imported)
+      fprintf(stderr, "  image '%s': imported\n", image.name.c_str());
+    else if(image.firstUse < 0)
+      fprintf(stderr, "  image '%s': unused\n", image.name.c_str());
+    else
+      fprintf(stderr, "  image '%s': %ux%u, %u layer(s), passes %d to %d, %.1f MB at offset %.1f MB\n", image.name.c_str(), image.extent.width,
+            image.extent.height, image.layerCount, image.firstUse, image.lastUse, toMegabytes(image.memorySize), toMegabytes(image.memoryOffset));
+  }
+
+  fprintf(stderr, "Frame graph: %d/%d passes executed, transient images: %.1f MB (%.1f MB without aliasing)\n", (int)executedPasses.size(),
+        (int)passes.size(), toMegabytes(memorySize), toMegabytes(unaliasedMemorySize));
+}
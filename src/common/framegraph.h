@@ -0,0 +1,181 @@
+#pragma once
+
+#include "glad/vulkan.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Frame graph
+//
+// Graphics passes declare the images they sample, and the images they render to.
+// From there, 'compile' derives:
+// - which passes are needed: the ones contributing to an output, the others are culled,
+// - the render pass of each pass: load/store ops and layouts,
+// - the barriers between passes,
+// - the placement of the transient images in a single memory allocation:
+//   images which are never alive at the same time share the same memory.
+//
+// Between passes, color images are in SHADER_READ_ONLY_OPTIMAL layout, depth images in
+// DEPTH_STENCIL_READ_ONLY_OPTIMAL. Transient images only live during the frame: they must be
+// written before being read, unless they're marked as history. Imported images are owned by the app
+// (e.g: written by a compute shader, or by a render pass outside of the graph), and are expected in
+// the same layouts.
+//
+// Array images are sampled as a whole, and rendered to one layer at a time.
+
+using FrameGraphImage = int;
+
+enum class FrameGraphLoad
+{
+  DontCare, // the pass overwrites the whole image
+  Clear,
+  Keep, // e.g: blending over the previous content
+};
+
+struct FrameGraphWrite
+{
+  FrameGraphImage image;
+  FrameGraphLoad load = FrameGraphLoad::DontCare;
+  VkClearValue clearValue{};
+  uint32_t layer = 0; // array images: the layer rendered to
+};
+
+struct FrameGraphPassDesc
+{
+  std::string name;
+  std::vector<FrameGraphWrite> colorWrites; // in attachment order
+  std::vector<FrameGraphWrite> depthWrite; // zero or one
+  std::vector<FrameGraphImage> reads; // sampled in the fragment shader
+
+  // Records the draws: the render pass is already begun.
+  std::function<void(VkCommandBuffer)> record;
+
+  // The pass begins its own render pass (e.g: one which also renders to the swapchain image):
+  // the graph only orders it, and records its barriers. Its attachments must end in their read layout.
+  bool external = false;
+};
+
+class FrameGraph
+{
+public:
+  FrameGraph(VkDevice device, VkPhysicalDevice physicalDevice);
+  ~FrameGraph();
+
+  FrameGraph(const FrameGraph&) = delete;
+  FrameGraph& operator=(const FrameGraph&) = delete;
+
+  // 'extraUsage' e.g: VK_IMAGE_USAGE_TRANSFER_SRC_BIT for readbacks: the graph only knows about attachments and sampling.
+  FrameGraphImage createImage(const char* name, VkExtent2D extent, VkFormat format, VkFilter filter = VK_FILTER_NEAREST, VkImageUsageFlags extraUsage = 0);
+  FrameGraphImage createImageArray(const char* name, VkExtent2D extent, uint32_t layerCount, VkFormat format, VkFilter filter = VK_FILTER_NEAREST);
+  FrameGraphImage importImage(const char* name, VkExtent2D extent, VkFormat format, VkImage image, VkImageView view, VkSampler sampler);
+
+  // Passes are executed in declaration order
+  void addPass(FrameGraphPassDesc pass);
+
+  // Read after the execution of the graph: its content is kept, and its writers aren't culled.
+  void markOutput(FrameGraphImage image);
+
+  // Its content is kept from one frame to the next (e.g: read by a pass before being written):
+  // its writers aren't culled, and no other image shares its memory. Before the first execution,
+  // the app must bring it to its read layout.
+  void markHistory(FrameGraphImage image);
+
+  // Depth images: sampled with a depth comparison (e.g: sampler2DShadow), which passes if 'reference op stored'.
+  // With VK_FILTER_LINEAR, each lookup returns the bilinear blend of 4 comparisons.
+  void setSamplerCompare(FrameGraphImage image, VkCompareOp op);
+
+  // Creates the images, memory, render passes and framebuffers. No more passes can be added after this.
+  void compile();
+
+  // Only computes the memory sizes (e.g: to report them at another resolution): creates no memory,
+  // render passes or framebuffers. The graph can't be executed. Instead of 'compile'.
+  void computeMemoryLayout();
+
+  // Records all the passes which weren't culled
+  void execute(VkCommandBuffer commandBuffer);
+
+  // After 'compile'. Only valid if the pass wasn't culled: pipelines must be created against it.
+  VkRenderPass getRenderPass(const char* passName) const;
+  bool isCulled(const char* passName) const;
+
+  // After 'compile'. Null handles for images only used by culled passes.
+  VkImage getImage(FrameGraphImage image) const;
+  VkImageView getView(FrameGraphImage image) const;
+  VkSampler getSampler(FrameGraphImage image) const;
+
+  // Memory used by the transient images: with aliasing, and as if each had its own allocation
+  VkDeviceSize getMemorySize() const { return memorySize; }
+  VkDeviceSize getUnaliasedMemorySize() const { return unaliasedMemorySize; }
+
+  // One line per pass and per image, to stderr
+  void printSummary() const;
+
+private:
+  struct Image
+  {
+    std::string name;
+    VkExtent2D extent;
+    VkFormat format;
+    VkFilter filter;
+    VkImageUsageFlags usage;
+    bool compare = false;
+    VkCompareOp compareOp = VK_COMPARE_OP_ALWAYS;
+    bool imported = false;
+    bool output = false;
+    bool history = false;
+    bool array = false;
+    uint32_t layerCount = 1;
+
+    VkImage image{};
+    VkImageView view{}; // all the layers
+    VkSampler sampler{};
+    std::vector<VkImageView> layerViews; // array images: one per layer, for the framebuffers
+
+    // in executed pass indices, -1 if unused
+    int firstUse = -1;
+    int lastUse = -1;
+    VkDeviceSize memoryOffset = 0;
+    VkDeviceSize memorySize = 0;
+  };
+
+  struct Pass
+  {
+    FrameGraphPassDesc desc;
+    bool culled = true;
+    std::vector<bool> storeColor; // the written content is read later
+    bool storeDepth = false;
+
+    VkRenderPass renderPass{};
+    VkFramebuffer framebuffer{};
+    VkExtent2D extent{};
+
+    // executed before the render pass
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    VkAccessFlags srcAccess = 0;
+    VkAccessFlags dstAccess = 0;
+  };
+
+  void plan();
+  void cullPasses();
+  void computeLifetimes();
+  void allocateImages(bool bindMemory);
+  void createRenderPass(Pass& pass);
+  void computeBarriers();
+  const Pass& findPass(const char* passName) const;
+
+  const VkDevice device;
+  const VkPhysicalDevice physicalDevice;
+
+  std::vector<Image> images;
+  std::vector<Pass> passes;
+  std::vector<int> executedPasses; // indices in 'passes'
+  bool planned = false;
+  bool compiled = false;
+
+  VkDeviceMemory memory{};
+  VkDeviceSize memorySize = 0;
+  VkDeviceSize unaliasedMemorySize = 0;
+};
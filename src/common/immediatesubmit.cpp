@@ -0,0 +1,206 @@
+#include "immediatesubmit.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+ImmediateSubmitter::ImmediateSubmitter(VkDevice device_, uint32_t queueFamily)
+    : device(device_)
+{
+  vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+  VkCommandPoolCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  info.queueFamilyIndex = queueFamily;
+  info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  if(vkCreateCommandPool(device, &info, nullptr, &pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create command pool");
+}
+
+ImmediateSubmitter::~ImmediateSubmitter()
+{
+  wait(lastTicket);
+
+  for(auto& slot : slots)
+    vkDestroyFence(device, slot.fence, nullptr);
+
+  // frees the command buffers
+  vkDestroyCommandPool(device, pool, nullptr);
+}
+
+void ImmediateSubmitter::execute(std::function<void(VkCommandBuffer)> record, std::function<void()> release)
+{
+  const ImmediateTicket ticket = executeAsync(record, release);
+
+  if(batchSlot < 0)
+    wait(ticket);
+}
+
+ImmediateTicket ImmediateSubmitter::executeAsync(std::function<void(VkCommandBuffer)> record, std::function<void()> release)
+{
+  ++stats.closures;
+
+  const int slot = batchSlot >= 0 ? batchSlot : acquireSlot();
+  record(slots[slot].commandBuffer);
+
+  if(release)
+    slots[slot].releases.push_back(release);
+
+  // the batch is submitted after the submissions which are already in flight
+  if(batchSlot >= 0)
+    return lastTicket + 1;
+
+  return submit(slot);
+}
+
+void ImmediateSubmitter::beginBatch()
+{
+  if(batchSlot >= 0)
+    throw std::runtime_error("ImmediateSubmitter: nested batch");
+
+  batchSlot = acquireSlot();
+}
+
+void ImmediateSubmitter::endBatch() { wait(endBatchAsync()); }
+
+ImmediateTicket ImmediateSubmitter::endBatchAsync()
+{
+  if(batchSlot < 0)
+    throw std::runtime_error("ImmediateSubmitter: no batch to end");
+
+  const int slot = batchSlot;
+  batchSlot = -1;
+
+  return submit(slot);
+}
+
+bool ImmediateSubmitter::isComplete(ImmediateTicket ticket)
+{
+  retireCompleted();
+  return ticket <= lastRetired;
+}
+
+void ImmediateSubmitter::wait(ImmediateTicket ticket)
+{
+  if(ticket > lastTicket)
+    throw std::runtime_error("ImmediateSubmitter: waiting for a batch which isn't submitted");
+
+  while(lastRetired < ticket)
+  {
+    for(auto& slot : slots)
+    {
+      if(slot.ticket != lastRetired + 1)
+        continue;
+
+      vkWaitForFences(device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+      retire(slot);
+      break;
+    }
+  }
+}
+
+void ImmediateSubmitter::printSummary() const
+{
+  fprintf(stderr, "Immediate submissions: %d submissions for %d closures, %d command buffers\n", stats.submissions, stats.closures,
+        stats.commandBuffers);
+}
+
+// A free slot (the completed ones are recycled first), or a new one
+int ImmediateSubmitter::acquireSlot()
+{
+  retireCompleted();
+
+  int found = -1;
+
+  for(int i = 0; i < (int)slots.size() && found < 0; ++i)
+  {
+    if(slots[i].ticket == 0 && i != batchSlot)
+      found = i;
+  }
+
+  if(found < 0)
+  {
+    Slot slot{};
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if(vkAllocateCommandBuffers(device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate command buffers");
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if(vkCreateFence(device, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS)
+      throw std::runtime_error("failed to create synchronization objects for an immediate submission");
+
+    slots.push_back(slot);
+    found = (int)slots.size() - 1;
+    ++stats.commandBuffers;
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  // implicitly resets the command buffer
+  if(vkBeginCommandBuffer(slots[found].commandBuffer, &beginInfo) != VK_SUCCESS)
+    throw std::runtime_error("failed to begin recording command buffer");
+
+  return found;
+}
+
+ImmediateTicket ImmediateSubmitter::submit(int index)
+{
+  auto& slot = slots[index];
+
+  if(vkEndCommandBuffer(slot.commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to record command buffer");
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &slot.commandBuffer;
+
+  if(vkQueueSubmit(queue, 1, &submitInfo, slot.fence) != VK_SUCCESS)
+    throw std::runtime_error("failed to submit command buffer");
+
+  slot.ticket = ++lastTicket;
+  ++stats.submissions;
+
+  return slot.ticket;
+}
+
+void ImmediateSubmitter::retire(Slot& slot)
+{
+  vkResetFences(device, 1, &slot.fence);
+
+  for(auto& release : slot.releases)
+    release();
+
+  slot.releases.clear();
+  slot.ticket = 0;
+  ++lastRetired;
+}
+
+void ImmediateSubmitter::retireCompleted()
+{
+  bool progress = true;
+
+  while(progress)
+  {
+    progress = false;
+
+    for(auto& slot : slots)
+    {
+      if(slot.ticket == lastRetired + 1 && vkGetFenceStatus(device, slot.fence) == VK_SUCCESS)
+      {
+        retire(slot);
+        progress = true;
+      }
+    }
+  }
+}
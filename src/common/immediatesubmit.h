@@ -0,0 +1,89 @@
+#pragma once
+
+#include "glad/vulkan.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Immediate submissions
+//
+// Command buffers recorded and submitted on the spot, for uploads and one-time
+// setup work. The command pool and the fences are created once, and recycled:
+// a submission costs a reset, a record and a vkQueueSubmit.
+// Between 'beginBatch' and 'endBatch', 'execute' only records: all the closures
+// go to the GPU in one submission, e.g. all the uploads of an app at startup.
+// Owned by main.cpp, given to the apps in AppCreationContext. Main thread only.
+//
+//   ctx.immediate->beginBatch();
+//   auto albedo = createTexture(*ctx.immediate, physicalDevice, pixels, 256, 256);
+//   auto normals = createTexture(*ctx.immediate, physicalDevice, normalPixels, 256, 256);
+//   ctx.immediate->endBatch();
+
+// Completion of a submission, see 'isComplete' and 'wait'
+using ImmediateTicket = uint64_t;
+
+struct ImmediateStats
+{
+  int submissions = 0;
+  int closures = 0; // calls to 'execute' and 'executeAsync'
+  int commandBuffers = 0; // allocated: the submissions in flight at the same time
+};
+
+class ImmediateSubmitter
+{
+public:
+  ImmediateSubmitter(VkDevice device, uint32_t queueFamily);
+  ~ImmediateSubmitter(); // waits for the submissions in flight
+
+  ImmediateSubmitter(const ImmediateSubmitter&) = delete;
+  ImmediateSubmitter& operator=(const ImmediateSubmitter&) = delete;
+
+  VkDevice getDevice() const { return device; }
+
+  // Records 'record', submits it and waits for the GPU. Inside a batch: only records.
+  // 'release' is called once the GPU is done with the commands, e.g. to destroy a staging buffer.
+  void execute(std::function<void(VkCommandBuffer)> record, std::function<void()> release = nullptr);
+
+  // Submits without waiting. Inside a batch: records, and returns the ticket of the batch.
+  ImmediateTicket executeAsync(std::function<void(VkCommandBuffer)> record, std::function<void()> release = nullptr);
+
+  void beginBatch();
+  void endBatch(); // submits the batch and waits
+  ImmediateTicket endBatchAsync();
+
+  // Both call the 'release' callbacks of the completed submissions
+  bool isComplete(ImmediateTicket ticket);
+  void wait(ImmediateTicket ticket);
+
+  const ImmediateStats& getStats() const { return stats; }
+
+  // One line, to stderr
+  void printSummary() const;
+
+private:
+  struct Slot
+  {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    ImmediateTicket ticket = 0; // 0: free
+    std::vector<std::function<void()>> releases;
+  };
+
+  int acquireSlot(); // begins its command buffer
+  ImmediateTicket submit(int slot);
+  void retire(Slot& slot);
+  void retireCompleted();
+
+  const VkDevice device;
+  VkQueue queue{};
+  VkCommandPool pool{};
+
+  std::vector<Slot> slots; // submissions are retired in ticket order: they're all on one queue
+  int batchSlot = -1; // recording, between 'beginBatch' and 'endBatch'
+  ImmediateTicket lastTicket = 0;
+  ImmediateTicket lastRetired = 0;
+
+  ImmediateStats stats;
+};
@@ -0,0 +1,326 @@
+#include "ktx2.h"
+
+#include "util.h" // loadFile
+
+#include <algorithm>
+#include <climits> // INT_MAX
+#include <cstdio>
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+const uint8_t Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Header
+{
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+
+static_assert(sizeof(Header) == 80, "KTX2 header layout");
+
+struct LevelIndex
+{
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+
+// Khronos Data Format color models
+enum ColorModel : uint8_t
+{
+  ModelRGBSDA = 1,
+  ModelBC1A = 128,
+  ModelBC3 = 130,
+  ModelBC5 = 132,
+  ModelBC7 = 134,
+};
+
+struct FormatInfo
+{
+  VkFormat format;
+  uint32_t blockSize; // bytes per 4x4 block, or per texel if not compressed
+  bool compressed;
+  ColorModel model;
+  bool srgb;
+};
+
+const FormatInfo Formats[] = {
+      {VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8, true, ModelBC1A, false},
+      {VK_FORMAT_BC1_RGB_SRGB_BLOCK, 8, true, ModelBC1A, true},
+      {VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 8, true, ModelBC1A, false},
+      {VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 8, true, ModelBC1A, true},
+      {VK_FORMAT_BC3_UNORM_BLOCK, 16, true, ModelBC3, false},
+      {VK_FORMAT_BC3_SRGB_BLOCK, 16, true, ModelBC3, true},
+      {VK_FORMAT_BC5_UNORM_BLOCK, 16, true, ModelBC5, false},
+      {VK_FORMAT_BC7_UNORM_BLOCK, 16, true, ModelBC7, false},
+      {VK_FORMAT_BC7_SRGB_BLOCK, 16, true, ModelBC7, true},
+      {VK_FORMAT_R8G8B8A8_UNORM, 4, false, ModelRGBSDA, false},
+      {VK_FORMAT_R8G8B8A8_SRGB, 4, false, ModelRGBSDA, true},
+};
+
+const FormatInfo* findFormat(VkFormat format)
+{
+  for(auto& info : Formats)
+  {
+    if(info.format == format)
+      return &info;
+  }
+
+  return nullptr;
+}
+
+template<typename T>
+void append(std::vector<uint8_t>& out, T value)
+{
+  auto bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof value);
+}
+
+void padTo(std::vector<uint8_t>& out, size_t alignment)
+{
+  while(out.size() % alignment)
+    out.push_back(0);
+}
+
+// Channel ids of the data format descriptor samples
+const uint8_t ChannelColor = 0; // BC1 (no alpha), BC7. RGBSDA: red
+const uint8_t ChannelGreen = 1; // BC5, RGBSDA
+const uint8_t ChannelBlue = 2; // RGBSDA
+const uint8_t ChannelAlpha = 15; // BC3, RGBSDA
+const uint8_t ChannelBC1Alpha = 1; // BC1 with punch-through alpha
+const uint8_t QualifierLinear = 0x10; // alpha of sRGB formats
+
+void appendSample(std::vector<uint8_t>& out, uint16_t bitOffset, int bitLength, uint8_t channel, uint32_t upper)
+{
+  append<uint16_t>(out, bitOffset);
+  append<uint8_t>(out, uint8_t(bitLength - 1));
+  append<uint8_t>(out, channel);
+  append<uint32_t>(out, 0); // sample position
+  append<uint32_t>(out, 0); // lower
+  append<uint32_t>(out, upper);
+}
+
+// Basic data format descriptor: only written for the tools reading the files, 'loadKtx2' ignores it
+std::vector<uint8_t> createDataFormatDescriptor(const FormatInfo& info)
+{
+  std::vector<uint8_t> samples;
+  const uint8_t alphaQualifier = info.srgb ? QualifierLinear : 0;
+
+  switch(info.model)
+  {
+  case ModelBC1A:
+  {
+    const bool alpha = info.format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || info.format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    appendSample(samples, 0, 64, alpha ? ChannelBC1Alpha : ChannelColor, 0xFFFFFFFF);
+    break;
+  }
+  case ModelBC3:
+    appendSample(samples, 0, 64, ChannelAlpha | alphaQualifier, 0xFFFFFFFF);
+    appendSample(samples, 64, 64, ChannelColor, 0xFFFFFFFF);
+    break;
+  case ModelBC5:
+    appendSample(samples, 0, 64, ChannelColor, 0xFFFFFFFF);
+    appendSample(samples, 64, 64, ChannelGreen, 0xFFFFFFFF);
+    break;
+  case ModelBC7:
+    appendSample(samples, 0, 128, ChannelColor, 0xFFFFFFFF);
+    break;
+  case ModelRGBSDA:
+    appendSample(samples, 0, 8, ChannelColor, 255);
+    appendSample(samples, 8, 8, ChannelGreen, 255);
+    appendSample(samples, 16, 8, ChannelBlue, 255);
+    appendSample(samples, 24, 8, ChannelAlpha | alphaQualifier, 255);
+    break;
+  }
+
+  const uint16_t blockSize = uint16_t(24 + samples.size());
+
+  std::vector<uint8_t> out;
+  append<uint32_t>(out, 4 + blockSize); // total size
+  append<uint32_t>(out, 0); // vendor: Khronos, type: basic
+  append<uint16_t>(out, 2); // version
+  append<uint16_t>(out, blockSize);
+  append<uint8_t>(out, info.model);
+  append<uint8_t>(out, 1); // primaries: BT.709
+  append<uint8_t>(out, info.srgb ? 2 : 1); // transfer function
+  append<uint8_t>(out, 0); // flags: straight alpha
+
+  const uint8_t blockDimension = info.compressed ? 3 : 0; // minus one
+  const uint8_t dimensions[4] = {blockDimension, blockDimension, 0, 0};
+  out.insert(out.end(), dimensions, dimensions + 4);
+
+  const uint8_t bytesPlane[8] = {uint8_t(info.blockSize)};
+  out.insert(out.end(), bytesPlane, bytesPlane + 8);
+
+  out.insert(out.end(), samples.begin(), samples.end());
+
+  return out;
+}
+}
+
+size_t getKtx2LevelSize(VkFormat format, int width, int height)
+{
+  auto info = findFormat(format);
+
+  if(!info)
+    return 0;
+
+  if(!info->compressed)
+    return size_t(width) * height * info->blockSize;
+
+  return size_t((width + 3) / 4) * ((height + 3) / 4) * info->blockSize;
+}
+
+Ktx2Image loadKtx2(const char* path)
+{
+  const auto file = loadFile(path);
+  const std::string context = std::string("KTX2 file '") + path + "': ";
+
+  Header header;
+
+  if(file.size() < sizeof header)
+    throw std::runtime_error(context + "truncated header");
+
+  memcpy(&header, file.data(), sizeof header);
+
+  if(memcmp(header.identifier, Identifier, sizeof Identifier))
+    throw std::runtime_error(context + "not a KTX2 file");
+
+  if(header.supercompressionScheme != 0)
+    throw std::runtime_error(context + "supercompression isn't supported");
+
+  if(header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1)
+    throw std::runtime_error(context + "only single 2D images are supported");
+
+  if(header.pixelWidth > INT_MAX || header.pixelHeight > INT_MAX)
+    throw std::runtime_error(context + "image too large");
+
+  if(header.levelCount == 0)
+    throw std::runtime_error(context + "no mip levels (to be generated at load time): not supported");
+
+  // down to 1x1, at most
+  uint32_t maxLevelCount = 1;
+
+  while(std::max(header.pixelWidth, header.pixelHeight) >> maxLevelCount)
+    ++maxLevelCount;
+
+  if(header.levelCount > maxLevelCount)
+    throw std::runtime_error(context + "more mip levels than the size allows");
+
+  Ktx2Image image{};
+  image.format = VkFormat(header.vkFormat);
+
+  if(!findFormat(image.format))
+    throw std::runtime_error(context + "unsupported format " + std::to_string(header.vkFormat));
+
+  if(file.size() < sizeof header + header.levelCount * sizeof(LevelIndex))
+    throw std::runtime_error(context + "truncated level index");
+
+  // Levels are stored smallest first: they're packed in level order in 'data'
+  for(uint32_t i = 0; i < header.levelCount; ++i)
+  {
+    LevelIndex index;
+    memcpy(&index, file.data() + sizeof header + i * sizeof index, sizeof index);
+
+    TextureLevel level{};
+    level.width = std::max<int>(header.pixelWidth >> i, 1);
+    level.height = std::max<int>(header.pixelHeight >> i, 1);
+    level.offset = image.data.size();
+    level.size = getKtx2LevelSize(image.format, level.width, level.height);
+
+    if(index.byteLength != level.size)
+      throw std::runtime_error(context + "unexpected size of level " + std::to_string(i));
+
+    if(index.byteOffset > file.size() || index.byteLength > file.size() - index.byteOffset)
+      throw std::runtime_error(context + "truncated level " + std::to_string(i));
+
+    image.data.insert(image.data.end(), file.begin() + index.byteOffset, file.begin() + index.byteOffset + index.byteLength);
+    image.levels.push_back(level);
+  }
+
+  return image;
+}
+
+void saveKtx2(const char* path, const Ktx2Image& image)
+{
+  auto info = findFormat(image.format);
+
+  if(!info || image.levels.empty())
+    throw std::runtime_error("saveKtx2: unsupported image");
+
+  const uint32_t levelCount = (uint32_t)image.levels.size();
+  const auto dfd = createDataFormatDescriptor(*info);
+
+  std::vector<uint8_t> kvd;
+  {
+    const char entry[] = "KTXwriter\0vulkanisch ktxencode"; // key and value, null-terminated
+    append<uint32_t>(kvd, sizeof entry);
+    kvd.insert(kvd.end(), entry, entry + sizeof entry);
+    padTo(kvd, 4);
+  }
+
+  Header header{};
+  memcpy(header.identifier, Identifier, sizeof Identifier);
+  header.vkFormat = image.format;
+  header.typeSize = 1;
+  header.pixelWidth = image.levels[0].width;
+  header.pixelHeight = image.levels[0].height;
+  header.faceCount = 1;
+  header.levelCount = levelCount;
+  header.dfdByteOffset = uint32_t(sizeof header + levelCount * sizeof(LevelIndex));
+  header.dfdByteLength = (uint32_t)dfd.size();
+  header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+  header.kvdByteLength = (uint32_t)kvd.size();
+
+  // the header and the level index are written last
+  std::vector<uint8_t> out(header.dfdByteOffset);
+  out.insert(out.end(), dfd.begin(), dfd.end());
+  out.insert(out.end(), kvd.begin(), kvd.end());
+
+  // Smallest level first, each one aligned on a block
+  std::vector<LevelIndex> index(levelCount);
+
+  for(uint32_t i = levelCount; i-- > 0;)
+  {
+    auto& level = image.levels[i];
+    padTo(out, info->blockSize);
+
+    index[i].byteOffset = out.size();
+    index[i].byteLength = level.size;
+    index[i].uncompressedByteLength = level.size;
+
+    out.insert(out.end(), image.data.begin() + level.offset, image.data.begin() + level.offset + level.size);
+  }
+
+  memcpy(out.data(), &header, sizeof header);
+  memcpy(out.data() + sizeof header, index.data(), index.size() * sizeof(LevelIndex));
+
+  FILE* fp = fopen(path, "wb");
+
+  if(!fp)
+    throw std::runtime_error(std::string("can't open '") + path + "' for writing");
+
+  const bool written = fwrite(out.data(), 1, out.size(), fp) == out.size();
+  fclose(fp);
+
+  if(!written)
+    throw std::runtime_error(std::string("failed to write '") + path + "'");
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "texture.h" // TextureLevel
+
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// KTX2 files
+//
+// 2D textures: one layer, one face, no supercompression. Formats: BC1/BC3/BC5/BC7,
+// and R8G8B8A8 as the uncompressed fallback for devices without BC support.
+// The files are written offline by 'ktxencode' (see src/ktxencode).
+//
+//   auto image = loadKtx2("bin/data/checkerboard-bc7.ktx2");
+//   auto texture = createTextureFromLevels(*ctx.immediate, ctx.physicalDevice, image.format, image.levels, image.data.data());
+
+struct Ktx2Image
+{
+  VkFormat format;
+  std::vector<TextureLevel> levels; // in 'data', the first one is the largest
+  std::vector<uint8_t> data;
+};
+
+Ktx2Image loadKtx2(const char* path);
+void saveKtx2(const char* path, const Ktx2Image& image);
+
+// 0 for the formats which aren't supported
+size_t getKtx2LevelSize(VkFormat format, int width, int height);
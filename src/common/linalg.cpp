@@ -214,3 +214,32 @@ Matrix4f perspective(float fovy, float aspect, float zNear, float zFar)
   r[2][3] = -(2.0 * zFar * zNear) / (zFar - zNear);
   return r;
 }
+
+Matrix4f orthographic(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+  assert(right != left);
+  assert(top != bottom);
+  assert(zFar != zNear);
+
+  Matrix4f r(0);
+  r[0][0] = 2.0 / (right - left);
+  r[1][1] = 2.0 / (top - bottom);
+  r[2][2] = -1.0 / (zFar - zNear);
+  r[0][3] = -(right + left) / (right - left);
+  r[1][3] = -(top + bottom) / (top - bottom);
+  r[2][3] = -zNear / (zFar - zNear);
+  r[3][3] = 1;
+  return r;
+}
+
+PackedAffine packAffine(const Matrix4f& m)
+{
+  assert(m[3][0] == 0 && m[3][1] == 0 && m[3][2] == 0 && m[3][3] == 1);
+
+  PackedAffine r;
+
+  for(int i = 0; i < 3; ++i)
+    r.rows[i] = {m[i][0], m[i][1], m[i][2], m[i][3]};
+
+  return r;
+}
@@ -1,4 +1,5 @@
 #include <climits>
+#include <cstdlib>
 #include <cstdint>
 #include <cstdio>
 #include <map>
@@ -8,6 +9,7 @@
 #include <vector>
 
 #include "app.h"
+#include "immediatesubmit.h"
 #include "util.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -25,6 +27,38 @@ int registerApp(const char* name, AppCreationFunc creationFunc)
   return 0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// runtime options
+auto& Options()
+{
+  static std::map<std::string, int> options;
+  return options;
+}
+
+int getOption(const char* name, int defaultValue)
+{
+  auto i = Options().find(name);
+  if(i == Options().end())
+    return defaultValue;
+
+  return i->second;
+}
+
+static void parseOptions(int argc, char* argv[])
+{
+  for(int i = 0; i < argc; ++i)
+  {
+    const std::string arg = argv[i];
+    const auto sep = arg.find('=');
+
+    if(sep == std::string::npos)
+      throw std::runtime_error("invalid option '" + arg + "', expected 'name=value'");
+
+    Options()[arg.substr(0, sep)] = atoi(arg.c_str() + sep + 1);
+    fprintf(stderr, "Option: %s\n", arg.c_str());
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Vulkan includes
 #include "glad/vulkan.h"
@@ -183,7 +217,10 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
 
   for(const auto& queueFamily : queueFamilies)
   {
-    if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+    // compute: some apps record compute dispatches along with their render passes
+    const VkQueueFlags requiredFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+
+    if((queueFamily.queueFlags & requiredFlags) == requiredFlags)
     {
       indices.graphicsFamily = i;
       indices.hasGraphicsFamily = true;
@@ -209,6 +246,27 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
   return indices;
 }
 
+// A transfer-only family (a DMA engine, copying in parallel with the graphics work) if there's one,
+// 'graphicsFamily' otherwise
+static uint32_t findTransferQueueFamily(VkPhysicalDevice device, uint32_t graphicsFamily)
+{
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+  for(uint32_t i = 0; i < queueFamilyCount; ++i)
+  {
+    const VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+    if((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+      return i;
+  }
+
+  return graphicsFamily;
+}
+
 static bool checkDeviceExtensionSupport(VkPhysicalDevice device)
 {
   uint32_t extensionCount;
@@ -318,7 +376,9 @@ static VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKH
   queueCreateInfo.queueCount = 1;
   queueCreateInfo.pQueuePriorities = &queuePriority;
 
-  VkDeviceQueueCreateInfo queueCreateInfos[2];
+  const uint32_t transferFamily = findTransferQueueFamily(physicalDevice, indices.graphicsFamily);
+
+  VkDeviceQueueCreateInfo queueCreateInfos[3];
   int count = 0;
 
   {
@@ -332,6 +392,13 @@ static VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKH
     queueCreateInfos[count++] = queueCreateInfo;
   }
 
+  // a transfer-only family is never the present one
+  if(transferFamily != indices.graphicsFamily)
+  {
+    queueCreateInfo.queueFamilyIndex = transferFamily;
+    queueCreateInfos[count++] = queueCreateInfo;
+  }
+
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.queueCreateInfoCount = count;
@@ -339,6 +406,17 @@ static VkDevice createLogicalDevice(VkPhysicalDevice physicalDevice, VkSurfaceKH
   createInfo.enabledExtensionCount = lengthof(RequiredDeviceExtensions);
   createInfo.ppEnabledExtensionNames = RequiredDeviceExtensions;
 
+  // Optional features: enabled whenever the device supports them,
+  // apps check the support with vkGetPhysicalDeviceFeatures.
+  VkPhysicalDeviceFeatures supportedFeatures{};
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+  VkPhysicalDeviceFeatures enabledFeatures{};
+  enabledFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+  enabledFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy; // see texture.h
+  enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+  createInfo.pEnabledFeatures = &enabledFeatures;
+
   VkDevice device;
 
   if(vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
@@ -462,6 +540,9 @@ public:
   {
     cleanupSwapChain();
 
+    immediate->printSummary();
+    immediate.reset();
+
     vkDestroyCommandPool(device, commandPool, nullptr);
 
     vkDestroyDevice(device, nullptr);
@@ -566,6 +647,8 @@ private:
 
   VkQueue graphicsQueue{};
   VkQueue presentQueue{};
+  uint32_t graphicsQueueFamily{};
+  uint32_t transferQueueFamily{};
 
   VkSwapchainKHR swapchain{};
   VkFormat swapchainImageFormat{};
@@ -633,7 +716,10 @@ private:
     loadVulkanUsingGlad(instance, physicalDevice);
 
     device = createLogicalDevice(physicalDevice, surface, &graphicsQueue, &presentQueue);
+    graphicsQueueFamily = findQueueFamilies(physicalDevice, surface).graphicsFamily;
+    transferQueueFamily = findTransferQueueFamily(physicalDevice, graphicsQueueFamily);
     createCommandPool();
+    immediate.reset(new ImmediateSubmitter(device, graphicsQueueFamily));
 
     recreateSwapChain();
 
@@ -667,6 +753,17 @@ private:
     ctx.physicalDevice = physicalDevice;
     ctx.swapchainExtent = swapchainExtent;
     ctx.renderPass = renderPass;
+    ctx.swapchainFormat = swapchainImageFormat;
+    ctx.graphicsQueueFamily = graphicsQueueFamily;
+    ctx.transferQueueFamily = transferQueueFamily;
+    ctx.immediate = immediate.get();
+
+    for(auto& swimg : swapchainImages)
+    {
+      ctx.swapchainFramebuffers.push_back(swimg.framebuffer);
+      ctx.swapchainImageViews.push_back(swimg.view);
+    }
+
     hostedApp.reset(hostedAppCreationFunc(ctx));
   }
 
@@ -895,6 +992,7 @@ private:
       throw std::runtime_error("failed to record command buffer");
   }
 
+  std::unique_ptr<ImmediateSubmitter> immediate;
   std::unique_ptr<IApp> hostedApp;
   Camera m_camera;
 };
@@ -908,6 +1006,9 @@ int main(int argc, char* argv[])
     if(argc >= 2)
       appName = argv[1];
 
+    if(argc >= 3)
+      parseOptions(argc - 2, argv + 2);
+
     auto i = Registry().find(appName);
     if(i == Registry().end())
     {
@@ -40,3 +40,17 @@ Matrix4f rotateZ(float angle);
 Matrix4f invertStandardMatrix(const Matrix4f& m);
 Matrix4f lookAt(Vec3f eye, Vec3f center, Vec3f up);
 Matrix4f perspective(float fovy, float aspect, float zNear, float zFar);
+
+// Maps [left;right]x[bottom;top] to [-1;1], and the depths [zNear;zFar] (looking down -Z) to [0;1]
+Matrix4f orthographic(float left, float right, float bottom, float top, float zNear, float zFar);
+
+// Affine transform for per-draw shader data (e.g: push constants): the first 3 rows,
+// the last one is always [0 0 0 1]. 48 bytes instead of 64. In GLSL:
+//   vec4 modelRows[3];
+//   mat4x4 model = transpose(mat4x4(modelRows[0], modelRows[1], modelRows[2], vec4(0, 0, 0, 1)));
+struct PackedAffine
+{
+  Vec4f rows[3];
+};
+
+PackedAffine packAffine(const Matrix4f& m);
@@ -0,0 +1,155 @@
+#include "shaderwatcher.h"
+
+#include <cstdio>
+#include <cstdlib> // system
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char* const BinDir = "bin"; // see 'BIN' in the Makefile
+}
+
+#ifdef __linux__
+
+namespace
+{
+const int PollTimeoutMs = 100; // how long the destructor may wait for the thread
+
+bool endsWith(const std::string& s, const std::string& suffix)
+{
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}
+
+ShaderWatcher::ShaderWatcher(const char* sourceDir_, std::function<void(const std::string&)> onCompiled_)
+    : sourceDir(sourceDir_)
+    , onCompiled(onCompiled_)
+{
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+  if(inotifyFd < 0)
+    throw std::runtime_error("shader hot-reload: failed to initialize inotify");
+
+  // editors either write the file in place, or write a new file and rename it
+  if(inotify_add_watch(inotifyFd, sourceDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+  {
+    close(inotifyFd);
+    throw std::runtime_error("shader hot-reload: can't watch '" + sourceDir + "'");
+  }
+
+  thread = std::thread([this]() { run(); });
+
+  fprintf(stderr, "Shader hot-reload: watching '%s/*.glsl'\n", sourceDir.c_str());
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+  stopping = true;
+  thread.join();
+  close(inotifyFd);
+}
+
+void ShaderWatcher::run()
+{
+  std::vector<char> buffer(64 * 1024);
+
+  while(!stopping)
+  {
+    pollfd fd{};
+    fd.fd = inotifyFd;
+    fd.events = POLLIN;
+
+    if(poll(&fd, 1, PollTimeoutMs) <= 0)
+      continue;
+
+    const ssize_t size = read(inotifyFd, buffer.data(), buffer.size());
+
+    if(size <= 0)
+      continue;
+
+    // one save can give several events for the same file: compile it once
+    std::vector<std::string> modified;
+
+    for(ssize_t offset = 0; offset < size;)
+    {
+      auto event = reinterpret_cast<const inotify_event*>(buffer.data() + offset);
+      offset += sizeof(inotify_event) + event->len;
+
+      if(event->len == 0)
+        continue;
+
+      const std::string name = event->name;
+
+      if(!endsWith(name, ".glsl"))
+        continue;
+
+      bool found = false;
+
+      for(auto& m : modified)
+        found = found || m == name;
+
+      if(!found)
+        modified.push_back(name);
+    }
+
+    for(auto& name : modified)
+      compile(name);
+  }
+}
+
+#else
+
+ShaderWatcher::ShaderWatcher(const char* sourceDir_, std::function<void(const std::string&)> onCompiled_)
+    : sourceDir(sourceDir_)
+    , onCompiled(onCompiled_)
+{
+  throw std::runtime_error("shader hot-reload: only supported on Linux (inotify)");
+}
+
+ShaderWatcher::~ShaderWatcher() {}
+
+void ShaderWatcher::run() {}
+
+#endif
+
+// e.g: 'blur.frag.glsl': stage 'frag', output 'bin/<sourceDir>/blur.frag.spv'
+void ShaderWatcher::compile(const std::string& fileName)
+{
+  const std::string baseName = fileName.substr(0, fileName.size() - 5); // without '.glsl'
+  const auto dot = baseName.rfind('.');
+
+  if(dot == std::string::npos)
+    return;
+
+  const std::string stage = baseName.substr(dot + 1);
+  const std::string sourcePath = sourceDir + "/" + fileName;
+  const std::string spvPath = std::string(BinDir) + "/" + sourceDir + "/" + baseName + ".spv";
+  const std::string tempPath = spvPath + ".tmp";
+
+  // same as the Makefile
+  const std::string command = "glslangValidator -V -o \"" + tempPath + "\" -S " + stage + " \"" + sourcePath + "\" --quiet";
+
+  if(system(command.c_str()) != 0)
+  {
+    fprintf(stderr, "Shader hot-reload: failed to compile '%s'\n", sourcePath.c_str());
+    remove(tempPath.c_str());
+    return;
+  }
+
+  // the app never loads a half-written file
+  if(rename(tempPath.c_str(), spvPath.c_str()) != 0)
+  {
+    fprintf(stderr, "Shader hot-reload: failed to replace '%s'\n", spvPath.c_str());
+    return;
+  }
+
+  fprintf(stderr, "Shader hot-reload: compiled '%s'\n", spvPath.c_str());
+  onCompiled(spvPath);
+}
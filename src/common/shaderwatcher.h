@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+///////////////////////////////////////////////////////////////////////////////
+// Shader hot-reload
+//
+// Watches the GLSL sources of a directory, and recompiles the modified ones on a
+// background thread, with the same command as the Makefile: 'src/app/x.frag.glsl'
+// gives 'bin/src/app/x.frag.spv'. The .spv is replaced atomically, once it's compiled.
+// Linux only (inotify).
+
+class ShaderWatcher
+{
+public:
+  // 'onCompiled' is called on the background thread, with the path of the new .spv file.
+  // Compilation errors are reported by the compiler: the previous .spv is kept.
+  ShaderWatcher(const char* sourceDir, std::function<void(const std::string& spvPath)> onCompiled);
+  ~ShaderWatcher();
+
+  ShaderWatcher(const ShaderWatcher&) = delete;
+  ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+private:
+  void run();
+  void compile(const std::string& fileName);
+
+  const std::string sourceDir;
+  const std::function<void(const std::string&)> onCompiled;
+
+  int inotifyFd = -1;
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+};
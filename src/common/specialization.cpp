@@ -0,0 +1,52 @@
+#include "specialization.h"
+
+#include <cstring> // memcpy
+
+Specialization& Specialization::set(uint32_t constantId, bool value)
+{
+  const VkBool32 boolValue = value ? VK_TRUE : VK_FALSE;
+  setRaw(constantId, &boolValue, sizeof boolValue);
+  return *this;
+}
+
+Specialization& Specialization::set(uint32_t constantId, int32_t value)
+{
+  setRaw(constantId, &value, sizeof value);
+  return *this;
+}
+
+Specialization& Specialization::set(uint32_t constantId, float value)
+{
+  setRaw(constantId, &value, sizeof value);
+  return *this;
+}
+
+const VkSpecializationInfo* Specialization::getInfo() const
+{
+  if(entries.empty())
+    return nullptr;
+
+  info.mapEntryCount = (uint32_t)entries.size();
+  info.pMapEntries = entries.data();
+  info.dataSize = data.size();
+  info.pData = data.data();
+
+  return &info;
+}
+
+// All the supported types are 4 bytes: a constant keeps its place when its value is replaced
+void Specialization::setRaw(uint32_t constantId, const void* value, uint32_t size)
+{
+  for(auto& entry : entries)
+  {
+    if(entry.constantID == constantId)
+    {
+      memcpy(data.data() + entry.offset, value, size);
+      return;
+    }
+  }
+
+  entries.push_back({constantId, (uint32_t)data.size(), size});
+  data.resize(data.size() + size);
+  memcpy(data.data() + entries.back().offset, value, size);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "glad/vulkan.h"
+
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Specialization constants of a shader stage
+//
+// Values by constant_id, packed into a VkSpecializationInfo. One SPIR-V module gives
+// as many pipelines as there are sets of values: the driver compiles each of them
+// with its values as constants (folded, loops unrolled), unlike uniforms.
+//
+//   Specialization constants;
+//   constants.set(0, true).set(1, 0.95f);
+//   stageInfo.pSpecializationInfo = constants.getInfo();
+
+class Specialization
+{
+public:
+  // Setting the same constant again replaces its value
+  Specialization& set(uint32_t constantId, bool value); // VkBool32
+  Specialization& set(uint32_t constantId, int32_t value);
+  Specialization& set(uint32_t constantId, float value);
+
+  // Null if no constant was set: the shader defaults apply.
+  // Valid until this object is modified or destroyed.
+  const VkSpecializationInfo* getInfo() const;
+
+private:
+  void setRaw(uint32_t constantId, const void* value, uint32_t size);
+
+  std::vector<VkSpecializationMapEntry> entries;
+  std::vector<uint8_t> data;
+  mutable VkSpecializationInfo info{};
+};
@@ -0,0 +1,456 @@
+#include "texture.h"
+
+#include "immediatesubmit.h"
+#include "vkutil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+// Clamped to the device limit
+const float MaxAnisotropy = 16.0f;
+
+struct MipLevel
+{
+  int width;
+  int height;
+  VkDeviceSize offset; // in the staging buffer
+};
+
+// 0 for the formats 'createTexture' doesn't support
+size_t getTexelSize(VkFormat format)
+{
+  switch(format)
+  {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    return 4;
+  case VK_FORMAT_R32G32B32A32_SFLOAT:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+bool isBlockCompressed(VkFormat format) { return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK; }
+
+// Down to 1x1
+uint32_t computeMipLevelCount(int width, int height)
+{
+  uint32_t count = 1;
+
+  while((width | height) >> count)
+    ++count;
+
+  return count;
+}
+
+uint8_t average(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { return uint8_t((a + b + c + d + 2) / 4); }
+float average(float a, float b, float c, float d) { return (a + b + c + d) * 0.25f; }
+
+// 2x2 box filter, 4 channels. Odd sizes: the last row/column is counted twice.
+// SRGB texels are averaged as they're stored, which slightly darkens the smaller levels.
+template<typename T>
+void downsample(const T* src, int srcWidth, int srcHeight, T* dst, int dstWidth, int dstHeight)
+{
+  for(int y = 0; y < dstHeight; ++y)
+  {
+    const int y0 = std::min(2 * y, srcHeight - 1);
+    const int y1 = std::min(2 * y + 1, srcHeight - 1);
+
+    for(int x = 0; x < dstWidth; ++x)
+    {
+      const int x0 = std::min(2 * x, srcWidth - 1);
+      const int x1 = std::min(2 * x + 1, srcWidth - 1);
+
+      for(int c = 0; c < 4; ++c)
+      {
+        dst[(y * dstWidth + x) * 4 + c] = average(src[(y0 * srcWidth + x0) * 4 + c], src[(y0 * srcWidth + x1) * 4 + c],
+              src[(y1 * srcWidth + x0) * 4 + c], src[(y1 * srcWidth + x1) * 4 + c]);
+      }
+    }
+  }
+}
+
+void transitionLevels(VkCommandBuffer commandBuffer,
+      VkImage image,
+      uint32_t baseLevel,
+      uint32_t levelCount,
+      VkImageLayout oldLayout,
+      VkImageLayout newLayout,
+      VkAccessFlags srcAccess,
+      VkAccessFlags dstAccess,
+      VkPipelineStageFlags dstStage)
+{
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1};
+
+  // all the previous work on the image is done by the transfer stage (or there's none)
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void createStagingBuffer(VkDevice device, VkPhysicalDevice physicalDevice, const void* data, VkDeviceSize size, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+  VkBufferCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  info.size = size;
+  info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if(vkCreateBuffer(device, &info, nullptr, &buffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to create staging buffer");
+
+  VkMemoryRequirements memReqs;
+  vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memReqs.size;
+  allocInfo.memoryTypeIndex =
+        findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  if(vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate staging memory");
+
+  vkBindBufferMemory(device, buffer, memory, 0);
+  writeToGpuMemory(device, memory, data, size);
+}
+
+void destroyStagingBuffer(VkDevice device, VkBuffer buffer, VkDeviceMemory memory)
+{
+  vkDestroyBuffer(device, buffer, nullptr);
+  vkFreeMemory(device, memory, nullptr);
+}
+
+// From the format, size and level count of 'texture'
+void createImage(VkDevice device, VkPhysicalDevice physicalDevice, Texture& texture, VkImageUsageFlags usage)
+{
+  {
+    VkImageCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = texture.format;
+    info.mipLevels = texture.mipLevels;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    info.extent = {(uint32_t)texture.width, (uint32_t)texture.height, 1};
+    info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | usage;
+
+    if(vkCreateImage(device, &info, nullptr, &texture.image) != VK_SUCCESS)
+      throw std::runtime_error("failed to create texture image");
+  }
+
+  {
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(device, texture.image, &memReqs);
+
+    VkMemoryAllocateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.allocationSize = memReqs.size;
+    info.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if(vkAllocateMemory(device, &info, nullptr, &texture.memory) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate texture memory");
+
+    vkBindImageMemory(device, texture.image, texture.memory, 0);
+    texture.memorySize = memReqs.size;
+  }
+}
+
+// The first 'levelCount' levels, from the staging buffer, which must be in TRANSFER_DST_OPTIMAL layout
+void copyLevels(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, const Texture& texture, const std::vector<TextureLevel>& levels, uint32_t levelCount)
+{
+  std::vector<VkBufferImageCopy> regions;
+
+  for(uint32_t i = 0; i < levelCount; ++i)
+  {
+    VkBufferImageCopy region{};
+    region.bufferOffset = levels[i].offset;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+    region.imageExtent = {(uint32_t)levels[i].width, (uint32_t)levels[i].height, 1};
+    regions.push_back(region);
+  }
+
+  vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+}
+
+// Anisotropy: only if the device supports it, main.cpp then enables the feature
+void createSamplerAndView(VkDevice device, VkPhysicalDevice physicalDevice, Texture& texture)
+{
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, texture.format, &formatProperties);
+  const bool linearFilter = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+  {
+    VkPhysicalDeviceFeatures features{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    texture.maxAnisotropy = 1.0f;
+
+    if(features.samplerAnisotropy && linearFilter)
+      texture.maxAnisotropy = std::min(MaxAnisotropy, properties.limits.maxSamplerAnisotropy);
+  }
+
+  {
+    const VkFilter filter = linearFilter ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    VkSamplerCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    info.magFilter = filter;
+    info.minFilter = filter;
+    info.mipmapMode = linearFilter ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    info.compareOp = VK_COMPARE_OP_NEVER;
+    info.minLod = 0.0f;
+    info.maxLod = float(texture.mipLevels);
+    info.anisotropyEnable = texture.maxAnisotropy > 1.0f;
+    info.maxAnisotropy = texture.maxAnisotropy;
+
+    if(vkCreateSampler(device, &info, nullptr, &texture.sampler) != VK_SUCCESS)
+      throw std::runtime_error("failed to create texture sampler");
+  }
+
+  {
+    VkImageViewCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    info.format = texture.format;
+    info.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
+    info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1};
+    info.image = texture.image;
+
+    if(vkCreateImageView(device, &info, nullptr, &texture.view) != VK_SUCCESS)
+      throw std::runtime_error("failed to create texture image view");
+  }
+}
+}
+
+Texture createTexture(ImmediateSubmitter& submitter, VkPhysicalDevice physicalDevice, const void* pixels, int width, int height, VkFormat format, bool mipmaps)
+{
+  const VkDevice device = submitter.getDevice();
+  const size_t texelSize = getTexelSize(format);
+
+  if(texelSize == 0)
+    throw std::runtime_error("createTexture: unsupported format");
+
+  Texture texture{};
+  texture.format = format;
+  texture.width = width;
+  texture.height = height;
+  texture.mipLevels = mipmaps ? computeMipLevelCount(width, height) : 1;
+  texture.firstLevelSize = width * height * texelSize;
+
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+  const VkFormatFeatureFlags blitFeatures =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+  if(texture.mipLevels == 1)
+    texture.mips = TextureMips::Single;
+  else if((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures)
+    texture.mips = TextureMips::Blit;
+  else
+    texture.mips = TextureMips::Cpu;
+
+  const bool blit = texture.mips == TextureMips::Blit;
+
+  // The staging buffer holds the first level when the GPU generates the others, the whole chain otherwise
+  std::vector<TextureLevel> levels;
+  size_t stagingSize = 0;
+
+  for(uint32_t i = 0; i < texture.mipLevels; ++i)
+  {
+    TextureLevel level{};
+    level.width = std::max(width >> i, 1);
+    level.height = std::max(height >> i, 1);
+    level.offset = stagingSize;
+    level.size = level.width * level.height * texelSize;
+    levels.push_back(level);
+
+    if(i == 0 || !blit)
+      stagingSize += level.size;
+  }
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingMemory;
+
+  // Each level is downsampled from the previous one. In system memory: the staging memory may be slow to read.
+  {
+    std::vector<uint8_t> chain(stagingSize);
+    memcpy(chain.data(), pixels, texture.firstLevelSize);
+
+    for(uint32_t i = 1; i < texture.mipLevels && !blit; ++i)
+    {
+      auto& src = levels[i - 1];
+      auto& level = levels[i];
+      uint8_t* base = chain.data();
+
+      if(texelSize == 4)
+        downsample(base + src.offset, src.width, src.height, base + level.offset, level.width, level.height);
+      else
+        downsample((const float*)(base + src.offset), src.width, src.height, (float*)(base + level.offset), level.width, level.height);
+    }
+
+    createStagingBuffer(device, physicalDevice, chain.data(), chain.size(), stagingBuffer, stagingMemory);
+  }
+
+  // the blits read the previous level
+  createImage(device, physicalDevice, texture, blit ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+
+  auto upload = [&](VkCommandBuffer commandBuffer) {
+    const uint32_t lastLevel = texture.mipLevels - 1;
+
+    transitionLevels(commandBuffer, texture.image, 0, texture.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+          VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    copyLevels(commandBuffer, stagingBuffer, texture, levels, blit ? 1 : texture.mipLevels);
+
+    if(!blit)
+    {
+      transitionLevels(commandBuffer, texture.image, 0, texture.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+      return;
+    }
+
+    // Each level is blitted from the previous one, which then becomes a transfer source
+    for(uint32_t i = 1; i < texture.mipLevels; ++i)
+    {
+      transitionLevels(commandBuffer, texture.image, i - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+      VkImageBlit region{};
+      region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1};
+      region.srcOffsets[1] = {levels[i - 1].width, levels[i - 1].height, 1};
+      region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+      region.dstOffsets[1] = {levels[i].width, levels[i].height, 1};
+
+      vkCmdBlitImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region,
+            VK_FILTER_LINEAR);
+    }
+
+    transitionLevels(commandBuffer, texture.image, 0, lastLevel, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+    transitionLevels(commandBuffer, texture.image, lastLevel, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+  };
+
+  submitter.execute(upload, [device, stagingBuffer, stagingMemory]() { destroyStagingBuffer(device, stagingBuffer, stagingMemory); });
+
+  createSamplerAndView(device, physicalDevice, texture);
+
+  return texture;
+}
+
+Texture createTextureFromLevels(ImmediateSubmitter& submitter,
+      VkPhysicalDevice physicalDevice,
+      VkFormat format,
+      const std::vector<TextureLevel>& levels,
+      const void* data)
+{
+  const VkDevice device = submitter.getDevice();
+  auto texture = allocateTexture(device, physicalDevice, format, levels);
+
+  // All the levels in one staging buffer, and one copy
+  size_t stagingSize = 0;
+
+  for(auto& level : levels)
+    stagingSize = std::max(stagingSize, level.offset + level.size);
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingMemory;
+  createStagingBuffer(device, physicalDevice, data, stagingSize, stagingBuffer, stagingMemory);
+
+  auto upload = [&](VkCommandBuffer commandBuffer) {
+    transitionLevels(commandBuffer, texture.image, 0, texture.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+          VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    copyLevels(commandBuffer, stagingBuffer, texture, levels, texture.mipLevels);
+
+    transitionLevels(commandBuffer, texture.image, 0, texture.mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+  };
+
+  submitter.execute(upload, [device, stagingBuffer, stagingMemory]() { destroyStagingBuffer(device, stagingBuffer, stagingMemory); });
+
+  return texture;
+}
+
+Texture allocateTexture(VkDevice device, VkPhysicalDevice physicalDevice, VkFormat format, const std::vector<TextureLevel>& levels)
+{
+  if(levels.empty())
+    throw std::runtime_error("allocateTexture: no levels");
+
+  if(!isTextureFormatSupported(physicalDevice, format))
+    throw std::runtime_error("allocateTexture: format not supported by the device");
+
+  Texture texture{};
+  texture.format = format;
+  texture.width = levels[0].width;
+  texture.height = levels[0].height;
+  texture.mipLevels = (uint32_t)levels.size();
+  texture.mips = levels.size() > 1 ? TextureMips::Loaded : TextureMips::Single;
+  texture.firstLevelSize = levels[0].size;
+
+  createImage(device, physicalDevice, texture, 0);
+  createSamplerAndView(device, physicalDevice, texture);
+
+  return texture;
+}
+
+void destroyTexture(VkDevice device, const Texture& texture)
+{
+  vkDestroyImageView(device, texture.view, nullptr);
+  vkDestroySampler(device, texture.sampler, nullptr);
+  vkDestroyImage(device, texture.image, nullptr);
+  vkFreeMemory(device, texture.memory, nullptr);
+}
+
+bool isTextureFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+  if(isBlockCompressed(format))
+  {
+    VkPhysicalDeviceFeatures features{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+    if(!features.textureCompressionBC)
+      return false;
+  }
+
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+  return formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+}
+
+void printTextureSummary(const char* name, const Texture& texture)
+{
+  static const char* const mipSources[] = {"single", "blit", "CPU", "loaded"};
+  const double bitsPerTexel = texture.firstLevelSize * 8.0 / (texture.width * texture.height);
+
+  fprintf(stderr, "Texture '%s': %dx%d, %.1f bits/texel, %d mip levels (%s), %.1f KB (first level: %.1f KB), anisotropy %.0fx\n", name,
+        texture.width, texture.height, bitsPerTexel, (int)texture.mipLevels, mipSources[(int)texture.mips], texture.memorySize / 1024.0,
+        texture.firstLevelSize / 1024.0, texture.maxAnisotropy);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "glad/vulkan.h"
+
+#include <vector>
+
+class ImmediateSubmitter;
+
+///////////////////////////////////////////////////////////////////////////////
+// Sampled textures
+//
+// 'createTexture' uploads the pixels of the first mip level, and builds the rest
+// of the chain: with vkCmdBlitImage if the format supports linear blits, with a
+// box filter on the CPU otherwise. The sampler covers all the levels, with trilinear
+// and anisotropic filtering (if the device supports it).
+// Formats: 8-bit RGBA/BGRA (UNORM or SRGB) and VK_FORMAT_R32G32B32A32_SFLOAT.
+//
+// 'createTextureFromLevels' uploads a complete chain as it is (e.g: block-compressed
+// levels from a KTX2 file, see ktx2.h), with a single copy. 'allocateTexture' only
+// creates the texture, for apps doing the copy themselves (see uploadstreamer.h).
+//
+// The uploads go through 'submitter': inside one of its batches, they're only recorded,
+// and the staging buffers live until the batch is done (see immediatesubmit.h).
+//
+//   auto texture = createTexture(*ctx.immediate, ctx.physicalDevice, pixels, 256, 256, VK_FORMAT_R8G8B8A8_SRGB);
+//   printTextureSummary("albedo", texture);
+
+enum class TextureMips
+{
+  Single,
+  Blit, // generated on the GPU
+  Cpu, // generated on the CPU: the format can't be blitted
+  Loaded, // given by the app
+};
+
+struct Texture
+{
+  VkImage image;
+  VkImageView view; // all the levels
+  VkDeviceMemory memory;
+  VkSampler sampler;
+
+  VkFormat format;
+  int width;
+  int height;
+  uint32_t mipLevels;
+  TextureMips mips;
+  VkDeviceSize firstLevelSize; // in bytes, as uploaded
+  VkDeviceSize memorySize; // of the image, with all its levels
+  float maxAnisotropy; // 1: no anisotropic filtering
+};
+
+// One level of a chain, in the data given to 'createTextureFromLevels'.
+// Block-compressed formats: rows of 4x4 blocks, partial blocks are padded.
+struct TextureLevel
+{
+  int width;
+  int height;
+  size_t offset;
+  size_t size;
+};
+
+// 'pixels': tightly packed rows of the first level. 'mipmaps': false for a single level.
+Texture createTexture(ImmediateSubmitter& submitter,
+      VkPhysicalDevice physicalDevice,
+      const void* pixels,
+      int width,
+      int height,
+      VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT,
+      bool mipmaps = true);
+
+// 'levels': the first one is the largest
+Texture createTextureFromLevels(ImmediateSubmitter& submitter,
+      VkPhysicalDevice physicalDevice,
+      VkFormat format,
+      const std::vector<TextureLevel>& levels,
+      const void* data);
+
+// Image (UNDEFINED layout, TRANSFER_DST usage), memory, view and sampler. Can be called from any thread.
+Texture allocateTexture(VkDevice device, VkPhysicalDevice physicalDevice, VkFormat format, const std::vector<TextureLevel>& levels);
+
+void destroyTexture(VkDevice device, const Texture& texture);
+
+// Can be sampled (BC formats: main.cpp enables 'textureCompressionBC' whenever the device supports it)
+bool isTextureFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format);
+
+// One line, to stderr: size, levels, bits per texel, and memory compared to the first level alone
+void printTextureSummary(const char* name, const Texture& texture);
@@ -0,0 +1,567 @@
+#include "uploadstreamer.h"
+
+#include "vkutil.h" // findMemoryType
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring> // memcpy
+#include <stdexcept>
+
+namespace
+{
+// Batches in flight: more staged assets wait for the next 'update'
+const int BatchCount = 4;
+
+// Copy offsets must be multiples of the texel block size (at most 16 bytes)
+const VkDeviceSize StagingAlignment = 16;
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+VkCommandPool createCommandPool(VkDevice device, uint32_t family)
+{
+  VkCommandPoolCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  info.queueFamilyIndex = family;
+  info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  VkCommandPool pool;
+
+  if(vkCreateCommandPool(device, &info, nullptr, &pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create command pool");
+
+  return pool;
+}
+
+VkCommandBuffer allocateCommandBuffer(VkDevice device, VkCommandPool pool)
+{
+  VkCommandBufferAllocateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  info.commandPool = pool;
+  info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  info.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+
+  if(vkAllocateCommandBuffers(device, &info, &commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate command buffers");
+
+  return commandBuffer;
+}
+
+void beginCommandBuffer(VkCommandBuffer commandBuffer)
+{
+  VkCommandBufferBeginInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if(vkBeginCommandBuffer(commandBuffer, &info) != VK_SUCCESS)
+    throw std::runtime_error("failed to begin recording command buffer");
+}
+
+void endCommandBuffer(VkCommandBuffer commandBuffer)
+{
+  if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to record command buffer");
+}
+
+// Vertex, index, uniform and storage buffers
+const VkAccessFlags BufferReadAccess =
+      VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+}
+
+UploadStreamer::UploadStreamer(VkDevice device_,
+      VkPhysicalDevice physicalDevice_,
+      uint32_t graphicsFamily_,
+      uint32_t transferFamily_,
+      VkDeviceSize stagingSize_)
+    : device(device_)
+    , physicalDevice(physicalDevice_)
+    , graphicsFamily(graphicsFamily_)
+    , transferFamily(transferFamily_)
+    , stagingSize(stagingSize_)
+{
+  vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
+  vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
+
+  graphicsPool = createCommandPool(device, graphicsFamily);
+  transferPool = createCommandPool(device, transferFamily);
+
+  {
+    VkBufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = stagingSize;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if(vkCreateBuffer(device, &info, nullptr, &stagingBuffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to create staging buffer");
+
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReqs.size;
+    allocInfo.memoryTypeIndex =
+          findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    if(vkAllocateMemory(device, &allocInfo, nullptr, &stagingMemory) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate staging memory");
+
+    vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
+
+    // mapped as long as the streamer lives: the background thread writes directly into it
+    void* data;
+    vkMapMemory(device, stagingMemory, 0, stagingSize, 0, &data);
+    stagingData = static_cast<uint8_t*>(data);
+  }
+
+  batches.resize(BatchCount);
+
+  for(auto& batch : batches)
+  {
+    batch.transferCommands = allocateCommandBuffer(device, transferPool);
+    batch.graphicsCommands = allocateCommandBuffer(device, graphicsPool);
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.copied) != VK_SUCCESS)
+      throw std::runtime_error("failed to create synchronization objects for an upload batch");
+
+    if(vkCreateFence(device, &fenceInfo, nullptr, &batch.done) != VK_SUCCESS)
+      throw std::runtime_error("failed to create synchronization objects for an upload batch");
+  }
+
+  thread = std::thread([this]() { run(); });
+}
+
+UploadStreamer::~UploadStreamer()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+  }
+
+  wakeUp.notify_all();
+  thread.join();
+
+  for(int i = 0; i < batchesInFlight; ++i)
+  {
+    auto& batch = batches[(firstBatch + i) % BatchCount];
+    vkWaitForFences(device, 1, &batch.done, VK_TRUE, UINT64_MAX);
+  }
+
+  // the handles of the assets which were never created are null
+  for(auto& asset : assets)
+  {
+    destroyTexture(device, asset->texture);
+    vkDestroyBuffer(device, asset->buffer, nullptr);
+    vkFreeMemory(device, asset->bufferMemory, nullptr);
+  }
+
+  for(auto& batch : batches)
+  {
+    vkDestroySemaphore(device, batch.copied, nullptr);
+    vkDestroyFence(device, batch.done, nullptr);
+  }
+
+  vkDestroyCommandPool(device, graphicsPool, nullptr);
+  vkDestroyCommandPool(device, transferPool, nullptr);
+
+  vkUnmapMemory(device, stagingMemory);
+  vkDestroyBuffer(device, stagingBuffer, nullptr);
+  vkFreeMemory(device, stagingMemory, nullptr);
+}
+
+int UploadStreamer::streamTexture(const char* name, std::function<Ktx2Image()> load)
+{
+  std::unique_ptr<Asset> asset(new Asset);
+  asset->name = name;
+  asset->loadTexture = load;
+
+  return enqueue(std::move(asset));
+}
+
+int UploadStreamer::streamBuffer(const char* name, VkBufferUsageFlags usage, std::function<std::vector<uint8_t>()> load)
+{
+  std::unique_ptr<Asset> asset(new Asset);
+  asset->name = name;
+  asset->loadBuffer = load;
+  asset->bufferUsage = usage;
+
+  return enqueue(std::move(asset));
+}
+
+int UploadStreamer::enqueue(std::unique_ptr<Asset> asset)
+{
+  asset->requestFrame = frameIndex;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    requests.push_back(asset.get());
+  }
+
+  wakeUp.notify_all();
+  assets.push_back(std::move(asset));
+
+  return (int)assets.size() - 1;
+}
+
+void UploadStreamer::printSummary() const
+{
+  const double averageLatency = stats.residentAssets ? stats.totalLatencyFrames / double(stats.residentAssets) : 0.0;
+
+  fprintf(stderr, "Uploads: %d assets resident (%.1f KB) in %d batches, %d failed, latency %.1f frames (max %d), %.1f MB ring on the %s queue\n",
+        stats.residentAssets, stats.uploadedBytes / 1024.0, stats.batches, stats.failedAssets, averageLatency, stats.maxLatencyFrames,
+        stagingSize / (1024.0 * 1024.0), transferFamily != graphicsFamily ? "transfer" : "graphics");
+}
+
+bool UploadStreamer::isResident(int id) const { return assets[id]->state == State::Resident; }
+
+const Texture& UploadStreamer::getTexture(int id) const { return assets[id]->texture; }
+
+VkBuffer UploadStreamer::getBuffer(int id) const { return assets[id]->buffer; }
+
+void UploadStreamer::update()
+{
+  ++frameIndex;
+
+  // Completed batches, in submission order
+  while(batchesInFlight > 0)
+  {
+    auto& batch = batches[firstBatch];
+
+    if(vkGetFenceStatus(device, batch.done) != VK_SUCCESS)
+      break;
+
+    retire(batch);
+    firstBatch = (firstBatch + 1) % BatchCount;
+    --batchesInFlight;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for(auto asset : staged)
+    {
+      asset->state = asset->failed ? State::Failed : State::Staged;
+
+      if(asset->failed)
+        stats.failedAssets++;
+
+      if(!asset->failed)
+        ready.push_back(asset);
+    }
+
+    staged.clear();
+  }
+
+  if(ready.empty() || batchesInFlight == BatchCount)
+    return;
+
+  auto& batch = batches[(firstBatch + batchesInFlight) % BatchCount];
+  batch.assets.swap(ready);
+  submit(batch);
+  stats.batches++;
+
+  for(auto asset : batch.assets)
+    asset->state = State::Submitted;
+  ++batchesInFlight;
+}
+
+void UploadStreamer::submit(Batch& batch)
+{
+  const bool handOver = transferFamily != graphicsFamily;
+
+  // With a transfer-only family, the release barriers only give the ownership: the access and
+  // the stage of the graphics work are given by the acquire barriers.
+  // Both barriers of a pair must describe the same layout transition.
+  std::vector<VkImageMemoryBarrier> toTransfer;
+  std::vector<VkImageMemoryBarrier> imageReleases;
+  std::vector<VkBufferMemoryBarrier> bufferReleases;
+
+  for(auto asset : batch.assets)
+  {
+    if(asset->buffer)
+    {
+      VkBufferMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = handOver ? 0 : BufferReadAccess;
+      barrier.srcQueueFamilyIndex = handOver ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = handOver ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+      barrier.buffer = asset->buffer;
+      barrier.size = VK_WHOLE_SIZE;
+      bufferReleases.push_back(barrier);
+      continue;
+    }
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = asset->texture.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, asset->texture.mipLevels, 0, 1};
+    toTransfer.push_back(barrier);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = handOver ? 0 : VK_ACCESS_SHADER_READ_BIT;
+    barrier.srcQueueFamilyIndex = handOver ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = handOver ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+    imageReleases.push_back(barrier);
+  }
+
+  beginCommandBuffer(batch.transferCommands);
+
+  if(!toTransfer.empty())
+  {
+    vkCmdPipelineBarrier(batch.transferCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+          (uint32_t)toTransfer.size(), toTransfer.data());
+  }
+
+  for(auto asset : batch.assets)
+  {
+    if(asset->buffer)
+    {
+      VkBufferCopy region{};
+      region.srcOffset = asset->stagingOffset;
+      region.size = asset->size;
+      vkCmdCopyBuffer(batch.transferCommands, stagingBuffer, asset->buffer, 1, &region);
+      continue;
+    }
+
+    std::vector<VkBufferImageCopy> regions;
+
+    for(uint32_t i = 0; i < asset->texture.mipLevels; ++i)
+    {
+      VkBufferImageCopy region{};
+      region.bufferOffset = asset->stagingOffset + asset->levels[i].offset;
+      region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+      region.imageExtent = {(uint32_t)asset->levels[i].width, (uint32_t)asset->levels[i].height, 1};
+      regions.push_back(region);
+    }
+
+    vkCmdCopyBufferToImage(batch.transferCommands, stagingBuffer, asset->texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(),
+          regions.data());
+  }
+
+  // a release barrier has no destination stage: the semaphore orders the acquire barrier after it
+  const VkPipelineStageFlags releaseStage = handOver ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+  vkCmdPipelineBarrier(batch.transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, releaseStage, 0, 0, nullptr, (uint32_t)bufferReleases.size(),
+        bufferReleases.data(), (uint32_t)imageReleases.size(), imageReleases.data());
+
+  endCommandBuffer(batch.transferCommands);
+
+  VkSubmitInfo transferSubmit{};
+  transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  transferSubmit.commandBufferCount = 1;
+  transferSubmit.pCommandBuffers = &batch.transferCommands;
+
+  if(!handOver)
+  {
+    if(vkQueueSubmit(transferQueue, 1, &transferSubmit, batch.done) != VK_SUCCESS)
+      throw std::runtime_error("failed to submit upload batch");
+
+    return;
+  }
+
+  transferSubmit.signalSemaphoreCount = 1;
+  transferSubmit.pSignalSemaphores = &batch.copied;
+
+  if(vkQueueSubmit(transferQueue, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+    throw std::runtime_error("failed to submit upload batch");
+
+  // Acquire barriers: the same as the release ones, with the accesses of the graphics work
+  for(auto& barrier : bufferReleases)
+  {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = BufferReadAccess;
+  }
+
+  for(auto& barrier : imageReleases)
+  {
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  }
+
+  beginCommandBuffer(batch.graphicsCommands);
+  vkCmdPipelineBarrier(batch.graphicsCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, 0, 0, nullptr,
+        (uint32_t)bufferReleases.size(), bufferReleases.data(), (uint32_t)imageReleases.size(), imageReleases.data());
+  endCommandBuffer(batch.graphicsCommands);
+
+  const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+  VkSubmitInfo graphicsSubmit{};
+  graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  graphicsSubmit.waitSemaphoreCount = 1;
+  graphicsSubmit.pWaitSemaphores = &batch.copied;
+  graphicsSubmit.pWaitDstStageMask = &waitStage;
+  graphicsSubmit.commandBufferCount = 1;
+  graphicsSubmit.pCommandBuffers = &batch.graphicsCommands;
+
+  if(vkQueueSubmit(graphicsQueue, 1, &graphicsSubmit, batch.done) != VK_SUCCESS)
+    throw std::runtime_error("failed to submit upload batch");
+}
+
+void UploadStreamer::retire(Batch& batch)
+{
+  vkResetFences(device, 1, &batch.done);
+
+  VkDeviceSize freed = 0;
+
+  for(auto asset : batch.assets)
+  {
+    asset->state = State::Resident;
+    freed += asset->stagingSpan;
+
+    const int latency = frameIndex - asset->requestFrame;
+    stats.residentAssets++;
+    stats.uploadedBytes += asset->size;
+    stats.totalLatencyFrames += latency;
+    stats.maxLatencyFrames = std::max(stats.maxLatencyFrames, latency);
+  }
+
+  batch.assets.clear();
+
+  // the ring is allocated in the order of the batches: the oldest bytes are freed
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stagingUsed -= freed;
+  }
+
+  wakeUp.notify_all();
+}
+
+void UploadStreamer::run()
+{
+  while(true)
+  {
+    Asset* asset;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeUp.wait(lock, [this]() { return stopping || !requests.empty(); });
+
+      if(stopping)
+        return;
+
+      asset = requests.front();
+      requests.pop_front();
+    }
+
+    try
+    {
+      stage(*asset);
+    }
+    catch(const std::exception& e)
+    {
+      // stopping, or a failed load: the resources are destroyed with the streamer
+      fprintf(stderr, "Upload '%s' failed: %s\n", asset->name.c_str(), e.what());
+      asset->failed = true;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    staged.push_back(asset);
+  }
+}
+
+// On the background thread
+void UploadStreamer::stage(Asset& asset)
+{
+  if(asset.loadTexture)
+  {
+    const auto image = asset.loadTexture();
+
+    asset.texture = allocateTexture(device, physicalDevice, image.format, image.levels);
+
+    // each level at an aligned offset, whatever the layout of 'image.data'
+    asset.levels = image.levels;
+
+    for(auto& level : asset.levels)
+    {
+      level.offset = asset.size;
+      asset.size = alignUp(asset.size + level.size, StagingAlignment);
+    }
+
+    asset.stagingOffset = allocateStaging(asset.size, asset.stagingSpan);
+
+    for(size_t i = 0; i < asset.levels.size(); ++i)
+      memcpy(stagingData + asset.stagingOffset + asset.levels[i].offset, image.data.data() + image.levels[i].offset, image.levels[i].size);
+
+    return;
+  }
+
+  const auto data = asset.loadBuffer();
+  asset.size = data.size();
+
+  {
+    VkBufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = data.size();
+    info.usage = asset.bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if(vkCreateBuffer(device, &info, nullptr, &asset.buffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to create buffer");
+
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device, asset.buffer, &memReqs);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReqs.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if(vkAllocateMemory(device, &allocInfo, nullptr, &asset.bufferMemory) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate buffer memory");
+
+    vkBindBufferMemory(device, asset.buffer, asset.bufferMemory, 0);
+  }
+
+  asset.stagingOffset = allocateStaging(alignUp(asset.size, StagingAlignment), asset.stagingSpan);
+  memcpy(stagingData + asset.stagingOffset, data.data(), data.size());
+}
+
+// Waits until the oldest uploads free enough space. 'span': the bytes taken from the ring,
+// including the end of the ring skipped by a wrap-around.
+VkDeviceSize UploadStreamer::allocateStaging(VkDeviceSize size, VkDeviceSize& span)
+{
+  if(size == 0 || size > stagingSize)
+    throw std::runtime_error("asset size " + std::to_string(size) + " doesn't fit in the staging ring");
+
+  std::unique_lock<std::mutex> lock(mutex);
+  VkDeviceSize offset;
+
+  while(true)
+  {
+    if(stopping)
+      throw std::runtime_error("the streamer is stopping");
+
+    // empty: starts over at the beginning, where any size fits
+    if(stagingUsed == 0)
+      stagingHead = 0;
+
+    const bool wrap = stagingHead + size > stagingSize;
+    offset = wrap ? 0 : stagingHead;
+    span = wrap ? stagingSize - stagingHead + size : size;
+
+    if(stagingUsed + span <= stagingSize)
+      break;
+
+    wakeUp.wait(lock);
+  }
+
+  stagingHead = (offset + size) % stagingSize;
+  stagingUsed += span;
+
+  return offset;
+}
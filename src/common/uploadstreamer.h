@@ -0,0 +1,166 @@
+#pragma once
+
+#include "glad/vulkan.h"
+
+#include "ktx2.h" // Ktx2Image
+#include "texture.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// Asynchronous uploads
+//
+// Assets are loaded, decoded and staged by a background thread, then copied by the
+// GPU while the app keeps rendering: they become resident a few frames later.
+// The thread writes into a persistently mapped staging ring: when it's full, the
+// thread waits for the GPU to be done with the oldest uploads.
+// 'update' is called once per frame, from the thread which submits the frames:
+// it submits the staged assets as one batch, and retires the completed batches.
+//
+// With a transfer-only queue family, the copies run on its queue, in parallel with the
+// graphics work. The resources are then handed over to the graphics family: a release
+// barrier on the transfer queue, and an acquire barrier on the graphics queue, after
+// a semaphore.
+//
+//   UploadStreamer streamer(ctx.device, ctx.physicalDevice, ctx.graphicsQueueFamily, ctx.transferQueueFamily);
+//   int id = streamer.streamTexture("albedo", []() { return loadKtx2("bin/data/albedo-bc7.ktx2"); });
+//
+//   // each frame, before recording
+//   streamer.update();
+//   auto& texture = streamer.isResident(id) ? streamer.getTexture(id) : placeholder;
+
+struct UploadStats
+{
+  int residentAssets = 0;
+  int failedAssets = 0;
+  int batches = 0; // submitted
+  VkDeviceSize uploadedBytes = 0; // of the resident assets
+  int totalLatencyFrames = 0; // from the request to residency, see 'update'
+  int maxLatencyFrames = 0;
+};
+
+class UploadStreamer
+{
+public:
+  // 'stagingSize': size of the ring, the largest asset it can upload
+  UploadStreamer(VkDevice device,
+        VkPhysicalDevice physicalDevice,
+        uint32_t graphicsFamily,
+        uint32_t transferFamily,
+        VkDeviceSize stagingSize = 16 * 1024 * 1024);
+  ~UploadStreamer();
+
+  UploadStreamer(const UploadStreamer&) = delete;
+  UploadStreamer& operator=(const UploadStreamer&) = delete;
+
+  // 'load' runs on the background thread. If it throws, the error is reported to stderr,
+  // and the asset never becomes resident. Returns the id of the asset.
+  int streamTexture(const char* name, std::function<Ktx2Image()> load);
+
+  // Device local buffer. The usage doesn't need TRANSFER_DST.
+  int streamBuffer(const char* name, VkBufferUsageFlags usage, std::function<std::vector<uint8_t>()> load);
+
+  void update();
+
+  // Once resident, assets can be used by the command buffers recorded after 'update'
+  bool isResident(int id) const;
+  const Texture& getTexture(int id) const;
+  VkBuffer getBuffer(int id) const;
+
+  const UploadStats& getStats() const { return stats; }
+
+  // One line, to stderr
+  void printSummary() const;
+
+private:
+  enum class State
+  {
+    Loading, // waiting for, or on the background thread
+    Staged, // in the ring, waiting for a free batch
+    Submitted,
+    Resident,
+    Failed,
+  };
+
+  struct Asset
+  {
+    std::string name;
+    std::function<Ktx2Image()> loadTexture; // one of the two
+    std::function<std::vector<uint8_t>()> loadBuffer;
+    VkBufferUsageFlags bufferUsage;
+    int requestFrame; // see 'frameIndex'
+
+    // Written by the background thread, until the asset is staged
+    Texture texture{};
+    VkBuffer buffer{};
+    VkDeviceMemory bufferMemory{};
+    std::vector<TextureLevel> levels; // offsets in the ring
+    VkDeviceSize size = 0; // in bytes
+    VkDeviceSize stagingOffset = 0;
+    VkDeviceSize stagingSpan = 0; // bytes taken from the ring, with the wrap-around
+    bool failed = false;
+
+    State state = State::Loading; // main thread only
+  };
+
+  // The uploads of one call to 'update'
+  struct Batch
+  {
+    VkCommandBuffer transferCommands; // copies, and the release barriers
+    VkCommandBuffer graphicsCommands; // acquire barriers: only used with a transfer-only family
+    VkSemaphore copied;
+    VkFence done;
+    std::vector<Asset*> assets;
+  };
+
+  int enqueue(std::unique_ptr<Asset> asset);
+  void run();
+  void stage(Asset& asset);
+  VkDeviceSize allocateStaging(VkDeviceSize size, VkDeviceSize& span);
+  void submit(Batch& batch);
+  void retire(Batch& batch);
+
+  const VkDevice device;
+  const VkPhysicalDevice physicalDevice;
+  const uint32_t graphicsFamily;
+  const uint32_t transferFamily;
+
+  VkQueue graphicsQueue{};
+  VkQueue transferQueue{};
+  VkCommandPool graphicsPool{};
+  VkCommandPool transferPool{};
+
+  // Staging ring: freed in allocation order, as the batches are retired
+  VkBuffer stagingBuffer{};
+  VkDeviceMemory stagingMemory{};
+  uint8_t* stagingData = nullptr;
+  const VkDeviceSize stagingSize;
+  VkDeviceSize stagingHead = 0; // next allocation, under 'mutex'
+  VkDeviceSize stagingUsed = 0; // under 'mutex'
+
+  std::vector<Batch> batches; // used in order, as a ring
+  int firstBatch = 0; // oldest in flight
+  int batchesInFlight = 0;
+
+  std::vector<std::unique_ptr<Asset>> assets; // by id
+  std::vector<Asset*> ready; // staged, waiting for a free batch
+  int frameIndex = 0; // calls to 'update'
+
+  // Shared with the background thread
+  std::mutex mutex;
+  std::condition_variable wakeUp; // new requests, freed staging space, or stopping
+  std::deque<Asset*> requests;
+  std::vector<Asset*> staged;
+  bool stopping = false;
+  std::thread thread;
+
+  UploadStats stats; // main thread only
+};
@@ -18,75 +18,6 @@ VkShaderModule createShaderModule(VkDevice device, const std::vector<uint8_t>& c
   return shaderModule;
 }
 
-void executeOneShotCommandBufferOnQueue(VkDevice device, std::function<void(VkCommandBuffer)> func, int queueIndex)
-{
-  // Create the temporary pool + command buffer
-  VkCommandPoolCreateInfo poolInfo{};
-  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  poolInfo.queueFamilyIndex = queueIndex;
-  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-  VkCommandPool commandPool;
-  if(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
-    throw std::runtime_error("failed to create command pool");
-
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = 1;
-
-  VkCommandBuffer commandBuffer;
-  if(vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
-    throw std::runtime_error("failed to allocate command buffers");
-
-  VkFence fence{};
-
-  {
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-
-    if(vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
-      throw std::runtime_error("failed to create synchronization objects for a frame");
-  }
-
-  // Begin command buffer
-  {
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-    if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
-      throw std::runtime_error("failed to begin recording command buffer");
-  }
-
-  // Execute the user function
-  func(commandBuffer);
-
-  // End command buffer
-  {
-    if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-      throw std::runtime_error("failed to record command buffer");
-  }
-
-  // Submit the work queued by the user function
-  {
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    VkQueue queue{};
-    vkGetDeviceQueue(device, queueIndex, 0, &queue);
-    vkQueueSubmit(queue, 1, &submitInfo, fence);
-    vkWaitForFences(device, 1, &fence, VK_TRUE, -1);
-  }
-
-  // Cleanup
-  vkDestroyFence(device, fence, nullptr);
-  vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-  vkDestroyCommandPool(device, commandPool, nullptr);
-}
-
 void writeToGpuMemory(VkDevice device, VkDeviceMemory memory, const void* src, size_t size)
 {
   void* dst;
@@ -1,4 +1,5 @@
 #include "common/app.h"
+#include "common/descriptorallocator.h"
 #include "common/util.h"
 #include "common/vkutil.h"
 
@@ -14,6 +15,11 @@ namespace
 struct MyUniformBlock
 {
   float cr, cg, cb, ca;
+};
+
+// Per draw: small and changing every frame, no need for a buffer
+struct MyPushConstantBlock
+{
   float x, y;
 };
 
@@ -106,32 +112,19 @@ VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device)
   return descriptorSetLayout;
 }
 
-VkDescriptorPool createDescriptorPool(VkDevice device)
-{
-  VkDescriptorPoolSize sizes[1];
-
-  // Uniform buffers : 1 total
-  sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  sizes[0].descriptorCount = 1;
-
-  // Create the global descriptor pool
-  VkDescriptorPoolCreateInfo info = {};
-  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  info.poolSizeCount = lengthof(sizes);
-  info.pPoolSizes = sizes;
-  info.maxSets = 1; // number of desc sets that can be allocated from this pool
-
-  VkDescriptorPool descriptorPool;
-  vkCreateDescriptorPool(device, &info, nullptr, &descriptorPool);
-  return descriptorPool;
-}
-
 VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout)
 {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(MyPushConstantBlock);
+
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = 1;
   pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
   VkPipelineLayout pipelineLayout;
 
@@ -265,27 +258,15 @@ VkBuffer createVertexBuffer(VkDevice device, size_t size)
   return vertexBuffer;
 }
 
-VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout)
-{
-  VkDescriptorSetAllocateInfo allocateInfo{};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocateInfo.descriptorPool = pool;
-  allocateInfo.descriptorSetCount = 1;
-  allocateInfo.pSetLayouts = &layout;
-  VkDescriptorSet descriptorSet;
-  vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
-  return descriptorSet;
-}
-
 class DescriptorSets : public IApp
 {
 public:
   DescriptorSets(const AppCreationContext& ctx_)
-      : ctx(ctx_)
+      : descriptorAllocator(ctx_.device)
+      , ctx(ctx_)
   {
-    descriptorPool = createDescriptorPool(ctx.device);
     descriptorSetLayout = createDescriptorSetLayout(ctx.device);
-    descriptorSet = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
+    descriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
 
     pipelineLayout = createPipelineLayout(ctx.device, descriptorSetLayout);
     graphicsPipeline = createGraphicsPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, ctx.renderPass);
@@ -335,9 +316,7 @@ public:
     vkDestroyPipeline(ctx.device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
 
-    // vkFreeDescriptorSets(ctx.device, descriptorPool, 1, &descriptorSet);
     vkDestroyDescriptorSetLayout(ctx.device, descriptorSetLayout, nullptr);
-    vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
   }
 
   void drawFrame(double time, VkFramebuffer framebuffer, VkCommandBuffer commandBuffer) override
@@ -366,14 +345,17 @@ public:
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
     MyUniformBlock constants{};
-    constants.x = sin(time * 0.2) * 0.5;
-    constants.y = 0.1;
     constants.cr = sin(time * 2.0) * 0.5;
 
     writeToGpuMemory(ctx.device, uniformBufferMemory, &constants, sizeof constants);
 
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 
+    MyPushConstantBlock pushConstants{};
+    pushConstants.x = sin(time * 0.2) * 0.5;
+    pushConstants.y = 0.1;
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pushConstants, &pushConstants);
+
     vkCmdDraw(commandBuffer, 9, 1, 0, 0);
 
     vkCmdEndRenderPass(commandBuffer);
@@ -385,7 +367,7 @@ private:
   VkBuffer vertexBuffer{};
   VkDeviceMemory vertexBufferMemory{};
   VkDescriptorSetLayout descriptorSetLayout{};
-  VkDescriptorPool descriptorPool{};
+  DescriptorAllocator descriptorAllocator;
   VkDescriptorSet descriptorSet{};
   VkBuffer uniformBuffer{};
   VkDeviceMemory uniformBufferMemory{};
@@ -7,7 +7,6 @@ layout(location = 0) out vec4 outColor;
 layout(binding=0, std140) uniform MyDescriptorSet
 {
   vec4 color;
-  vec2 tx;
 } UniformBlock;
 
 void main()
@@ -8,12 +8,16 @@ layout(location = 0) out vec3 fragColor;
 layout(binding=0, std140) uniform MyDescriptorSet
 {
   vec4 color;
-  vec2 tx;
 } UniformBlock;
 
+layout(push_constant) uniform MyPushConstantBlock
+{
+  vec2 tx;
+} PushConstant;
+
 void main()
 {
-    gl_Position = vec4(inPosition + UniformBlock.tx, 0.0, 1.0);
+    gl_Position = vec4(inPosition + PushConstant.tx, 0.0, 1.0);
     fragColor = inColor;
 }
 
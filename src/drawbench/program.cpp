@@ -0,0 +1,531 @@
+// Per-draw data microbenchmark: many small draws, each with its own model transform,
+// given either through push constants, or through a uniform buffer written per draw
+// (one dynamic offset per draw). Reports the CPU recording time and the GPU time.
+//
+// ./vulkanisch.exe DrawBench draws=10000 pushconstants=1
+
+#include "common/app.h"
+#include "common/descriptorallocator.h"
+#include "common/matrix4.h"
+#include "common/specialization.h"
+#include "common/util.h"
+#include "common/vkutil.h"
+
+#include <algorithm> // max
+#include <chrono>
+#include <cmath> // sqrt
+#include <cstdio>
+#include <cstring> // memcpy
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+// Per-frame regions of the uniform buffer, and timestamp queries, are used in a ring
+const int FrameRingSize = 4; // must be greater than the number of frames in flight
+
+const int StatsReportPeriod = 300; // in frames
+
+///////////////////////////////////////////////////////////////////////////////
+// Shader params
+
+struct MyFrameBlock
+{
+  Matrix4f viewProj;
+};
+
+// Same layout in the push constants and in the per-draw uniform buffer slots
+struct MyDrawBlock
+{
+  PackedAffine model;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Vertex
+
+struct Vertex
+{
+  float x, y;
+  float r, g, b;
+};
+
+constexpr VkVertexInputBindingDescription bindingDesc[] = {
+      // stride
+      {
+            .binding = 0,
+            .stride = sizeof(Vertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+      }};
+
+constexpr VkVertexInputAttributeDescription attributeDesc[] = {
+      // position
+      {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32_SFLOAT,
+            .offset = offsetof(Vertex, x),
+      },
+      // color
+      {
+            .location = 1,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = offsetof(Vertex, r),
+      }};
+
+const Vertex vertices[] = {
+      {-0.5f, -0.5f, /**/ 1, 0.5, 0}, //
+      {+0.5f, -0.5f, /**/ 0, 1, 0.5}, //
+      {+0.0f, +0.5f, /**/ 0.5, 0, 1}, //
+};
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+VkDeviceMemory createBufferMemory(VkPhysicalDevice physicalDevice, VkDevice device, VkBuffer buffer)
+{
+  VkDeviceMemory memory{};
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+        findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  if(vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate buffer memory");
+
+  vkBindBufferMemory(device, buffer, memory, 0);
+
+  return memory;
+}
+
+VkBuffer createBuffer(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+  VkBufferCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  info.size = size;
+  info.usage = usage;
+  info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer buffer;
+
+  if(vkCreateBuffer(device, &info, nullptr, &buffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to create buffer");
+
+  return buffer;
+}
+
+VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device)
+{
+  VkDescriptorSetLayoutBinding setLayoutBindings[2]{};
+
+  // Binding 0: per frame
+  setLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  setLayoutBindings[0].binding = 0;
+  setLayoutBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  setLayoutBindings[0].descriptorCount = 1;
+
+  // Binding 1: per draw
+  setLayoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  setLayoutBindings[1].binding = 1;
+  setLayoutBindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  setLayoutBindings[1].descriptorCount = 1;
+
+  VkDescriptorSetLayoutCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  info.bindingCount = lengthof(setLayoutBindings);
+  info.pBindings = setLayoutBindings;
+
+  VkDescriptorSetLayout descriptorSetLayout;
+
+  if(vkCreateDescriptorSetLayout(device, &info, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor set layout");
+
+  return descriptorSetLayout;
+}
+
+VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout)
+{
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(MyDrawBlock);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  VkPipelineLayout pipelineLayout;
+
+  if(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create pipeline layout");
+
+  return pipelineLayout;
+}
+
+VkPipeline createGraphicsPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, bool usePushConstants)
+{
+  auto vertShaderCode = loadFile("bin/src/drawbench/shader.vert.spv");
+  auto fragShaderCode = loadFile("bin/src/drawbench/shader.frag.spv");
+
+  VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode);
+  VkShaderModule fragShaderModule = createShaderModule(device, fragShaderCode);
+
+  Specialization specialization;
+  specialization.set(0, usePushConstants);
+
+  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+  vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vertShaderStageInfo.module = vertShaderModule;
+  vertShaderStageInfo.pName = "main";
+  vertShaderStageInfo.pSpecializationInfo = specialization.getInfo();
+
+  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+  fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  fragShaderStageInfo.module = fragShaderModule;
+  fragShaderStageInfo.pName = "main";
+
+  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = lengthof(bindingDesc);
+  vertexInputInfo.pVertexBindingDescriptions = bindingDesc;
+  vertexInputInfo.vertexAttributeDescriptionCount = lengthof(attributeDesc);
+  vertexInputInfo.pVertexAttributeDescriptions = attributeDesc;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)swapchainExtent.width;
+  viewport.height = (float)swapchainExtent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = swapchainExtent;
+
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.pViewports = &viewport;
+  viewportState.scissorCount = 1;
+  viewportState.pScissors = &scissor;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = VK_CULL_MODE_NONE; // the triangles spin
+  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  rasterizer.depthBiasEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = VK_FALSE;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  VkPipeline pipeline{};
+
+  if(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    throw std::runtime_error("failed to create graphics pipeline");
+
+  vkDestroyShaderModule(device, fragShaderModule, nullptr);
+  vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+  return pipeline;
+}
+
+VkQueryPool createTimestampQueryPool(VkDevice device, int queryCount)
+{
+  VkQueryPoolCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  info.queryCount = queryCount;
+
+  VkQueryPool queryPool{};
+
+  if(vkCreateQueryPool(device, &info, nullptr, &queryPool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create query pool");
+
+  return queryPool;
+}
+
+class DrawBench : public IApp
+{
+public:
+  DrawBench(const AppCreationContext& ctx_)
+      : ctx(ctx_)
+      , descriptorAllocator(ctx_.device)
+  {
+    drawCount = std::max(getOption("draws", 10000), 1);
+    usePushConstants = getOption("pushconstants", 1);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &properties);
+
+    // Uniform buffer, per frame of the ring: the frame block, then one slot per draw
+    const VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+    frameBlockStride = alignUp(sizeof(MyFrameBlock), alignment);
+    drawBlockStride = alignUp(sizeof(MyDrawBlock), alignment);
+    frameRegionSize = frameBlockStride + drawBlockStride * drawCount;
+
+    uniformBuffer = createBuffer(ctx.device, frameRegionSize * FrameRingSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    uniformBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, uniformBuffer);
+
+    // Mapped once (host coherent): the per-draw cost is the write, not a map/unmap round-trip
+    {
+      void* data;
+      vkMapMemory(ctx.device, uniformBufferMemory, 0, VK_WHOLE_SIZE, 0, &data);
+      uniformData = static_cast<uint8_t*>(data);
+    }
+
+    vertexBuffer = createBuffer(ctx.device, sizeof vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    vertexBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, vertexBuffer);
+    writeToGpuMemory(ctx.device, vertexBufferMemory, vertices, sizeof vertices);
+
+    descriptorSetLayout = createDescriptorSetLayout(ctx.device);
+    descriptorSet = descriptorAllocator.getSet(descriptorSetLayout,
+          {
+                bufferDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniformBuffer, sizeof(MyFrameBlock)),
+                bufferDescriptor(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniformBuffer, sizeof(MyDrawBlock)),
+          });
+
+    pipelineLayout = createPipelineLayout(ctx.device, descriptorSetLayout);
+    graphicsPipeline = createGraphicsPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, ctx.renderPass, usePushConstants);
+
+    if(properties.limits.timestampComputeAndGraphics)
+    {
+      timestampQueryPool = createTimestampQueryPool(ctx.device, FrameRingSize * 2);
+      timestampPeriod = properties.limits.timestampPeriod;
+    }
+
+    fprintf(stderr, "DrawBench: %d draws/frame, per-draw transform through %s\n", drawCount, describePath());
+  }
+
+  ~DrawBench()
+  {
+    vkDestroyQueryPool(ctx.device, timestampQueryPool, nullptr);
+    vkDestroyPipeline(ctx.device, graphicsPipeline, nullptr);
+    vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, descriptorSetLayout, nullptr);
+    vkDestroyBuffer(ctx.device, vertexBuffer, nullptr);
+    vkFreeMemory(ctx.device, vertexBufferMemory, nullptr);
+    vkUnmapMemory(ctx.device, uniformBufferMemory);
+    vkDestroyBuffer(ctx.device, uniformBuffer, nullptr);
+    vkFreeMemory(ctx.device, uniformBufferMemory, nullptr);
+  }
+
+  void drawFrame(double time, VkFramebuffer framebuffer, VkCommandBuffer commandBuffer) override
+  {
+    const int slot = frameCount % FrameRingSize;
+    collectStatistics(slot);
+
+    if(frameCount > 0 && frameCount % StatsReportPeriod == 0)
+      reportStatistics();
+
+    ++frameCount;
+
+    if(timestampQueryPool)
+    {
+      vkCmdResetQueryPool(commandBuffer, timestampQueryPool, slot * 2, 2);
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, slot * 2 + 0);
+    }
+
+    const VkDeviceSize frameRegion = frameRegionSize * slot;
+
+    {
+      MyFrameBlock constants{};
+      constants.viewProj = transpose(scale({float(ctx.swapchainExtent.height) / ctx.swapchainExtent.width, 1, 1})); // square grid
+      memcpy(uniformData + frameRegion, &constants, sizeof constants);
+    }
+
+    VkClearValue clearColor{};
+    clearColor.color.float32[0] = 0.1f;
+    clearColor.color.float32[1] = 0.1f;
+    clearColor.color.float32[2] = 0.1f;
+    clearColor.color.float32[3] = 1.0f;
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = ctx.renderPass;
+    renderPassInfo.framebuffer = framebuffer;
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = ctx.swapchainExtent;
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+    VkBuffer vertexBuffers[] = {vertexBuffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+    // Draws on a grid covering the view
+    const int columns = (int)std::ceil(std::sqrt(drawCount));
+    const float cellSize = 2.0f / columns;
+
+    const auto t0 = std::chrono::steady_clock::now();
+
+    if(usePushConstants)
+    {
+      const uint32_t dynamicOffsets[] = {uint32_t(frameRegion), uint32_t(frameRegion + frameBlockStride)};
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 2, dynamicOffsets);
+    }
+
+    for(int i = 0; i < drawCount; ++i)
+    {
+      const Vec3f position = {-1 + cellSize * (i % columns + 0.5f), -1 + cellSize * (i / columns + 0.5f), 0};
+
+      MyDrawBlock constants{};
+      constants.model = packAffine(translate(position) * scale({cellSize, cellSize, 1}) * rotateZ(time + i * 0.1));
+
+      if(usePushConstants)
+      {
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof constants, &constants);
+      }
+      else
+      {
+        const VkDeviceSize drawOffset = frameRegion + frameBlockStride + drawBlockStride * i;
+        memcpy(uniformData + drawOffset, &constants, sizeof constants);
+
+        const uint32_t dynamicOffsets[] = {uint32_t(frameRegion), uint32_t(drawOffset)};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 2, dynamicOffsets);
+      }
+
+      vkCmdDraw(commandBuffer, lengthof(vertices), 1, 0, 0);
+    }
+
+    const auto t1 = std::chrono::steady_clock::now();
+    stats.recordSeconds += std::chrono::duration<double>(t1 - t0).count();
+    stats.recordedFrameCount++;
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    if(timestampQueryPool)
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, slot * 2 + 1);
+  }
+
+private:
+  const char* describePath() const { return usePushConstants ? "push constants" : "uniform buffer writes + dynamic offsets"; }
+
+  // Reads back the timestamps of the frame which last used 'slot', if they're ready.
+  // Called before the slot gets reset for the current frame.
+  void collectStatistics(int slot)
+  {
+    if(!timestampQueryPool || frameCount < FrameRingSize)
+      return;
+
+    uint64_t result[2][2]{}; // (timestamp, availability) at the frame start and end
+
+    const auto flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+    const VkResult status = vkGetQueryPoolResults(ctx.device, timestampQueryPool, slot * 2, 2, sizeof result, result, sizeof result[0], flags);
+
+    if(status == VK_SUCCESS && result[0][1] && result[1][1])
+    {
+      stats.gpuTicks += result[1][0] - result[0][0];
+      stats.timedFrameCount++;
+    }
+  }
+
+  void reportStatistics()
+  {
+    if(stats.recordedFrameCount > 0)
+    {
+      const double milliseconds = stats.recordSeconds * 1000.0 / stats.recordedFrameCount;
+      fprintf(stderr, "DrawBench: CPU %.3f ms/frame to record %d draws (%s), %.1f ns/draw\n", milliseconds, drawCount, describePath(),
+            milliseconds * 1e6 / drawCount);
+    }
+
+    if(stats.timedFrameCount > 0)
+    {
+      const double milliseconds = stats.gpuTicks * timestampPeriod / 1e6 / stats.timedFrameCount;
+      fprintf(stderr, "DrawBench: GPU %.3f ms/frame\n", milliseconds);
+    }
+
+    stats = {};
+  }
+
+  const AppCreationContext ctx;
+  DescriptorAllocator descriptorAllocator;
+
+  int drawCount = 0;
+  bool usePushConstants = true;
+
+  VkDeviceSize frameBlockStride = 0;
+  VkDeviceSize drawBlockStride = 0;
+  VkDeviceSize frameRegionSize = 0;
+
+  VkBuffer uniformBuffer{};
+  VkDeviceMemory uniformBufferMemory{};
+  uint8_t* uniformData = nullptr; // persistently mapped
+  VkBuffer vertexBuffer{};
+  VkDeviceMemory vertexBufferMemory{};
+
+  VkDescriptorSetLayout descriptorSetLayout{};
+  VkDescriptorSet descriptorSet{};
+  VkPipelineLayout pipelineLayout{};
+  VkPipeline graphicsPipeline{};
+
+  VkQueryPool timestampQueryPool{};
+  float timestampPeriod = 1; // in nanoseconds per tick
+
+  int frameCount = 0;
+
+  struct Stats
+  {
+    int recordedFrameCount = 0;
+    double recordSeconds = 0;
+
+    int timedFrameCount = 0;
+    uint64_t gpuTicks = 0;
+  };
+
+  Stats stats;
+};
+} // namespace
+
+REGISTER_APP(DrawBench);
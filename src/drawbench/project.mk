@@ -0,0 +1,3 @@
+SRCS+=$(GetMyDir)/program.cpp
+SHADERS+=$(GetMyDir)/shader.vert.glsl
+SHADERS+=$(GetMyDir)/shader.frag.glsl
@@ -0,0 +1,41 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+// Where the model transform comes from, see 'DrawBench'
+layout(constant_id = 0) const bool UsePushConstants = true;
+
+// Per frame
+layout(set=0, binding=0, std140) uniform MyFrameBlock
+{
+  mat4x4 viewProj;
+} Frame;
+
+// Per draw, at a dynamic offset: only read if !UsePushConstants
+layout(set=0, binding=1, std140) uniform MyDrawBlock
+{
+  vec4 modelRows[3];
+} Draw;
+
+// Per draw: only read if UsePushConstants
+layout(push_constant) uniform MyPushConstantBlock
+{
+  vec4 modelRows[3];
+} PushConstant;
+
+void main()
+{
+  vec4 rows[3];
+
+  for(int i = 0; i < 3; ++i)
+    rows[i] = UsePushConstants ? PushConstant.modelRows[i] : Draw.modelRows[i];
+
+  mat4x4 model = transpose(mat4x4(rows[0], rows[1], rows[2], vec4(0, 0, 0, 1)));
+  gl_Position = Frame.viewProj * model * vec4(inPosition, 0, 1);
+  fragColor = inColor;
+}
+
+// vim: syntax=glsl
@@ -0,0 +1,67 @@
+#version 450
+
+// Full resolution bloom, compute path: one direction of the separable Gaussian blur per dispatch.
+// Each workgroup blurs a segment of a row (or of a column): the segment and its apron
+// are loaded once into shared memory, then each invocation sums its kernel from there.
+layout(local_size_x = 128) in;
+
+const int TileSize = 128; // must match 'local_size_x' and 'ComputeBlurTileSize'
+const int MaxRadius = 22; // must match 'MaxBlurRadius'
+
+layout(constant_id = 0) const bool Vertical = false;
+layout(constant_id = 1) const bool Threshold = false; // bright-pass the input while loading it (first pass)
+layout(constant_id = 2) const float ThresholdValue = 0.95; // see 'BloomThreshold'
+
+layout(push_constant) uniform BlurParams
+{
+  int radius;
+  float weights[MaxRadius + 1]; // weights[0] is the center texel
+} Params;
+
+layout(set=0, binding=0) uniform sampler2D inputPicture;
+layout(set=0, binding=1, rgba32f) uniform writeonly image2D outputPicture;
+
+shared vec3 tile[TileSize + 2 * MaxRadius];
+
+ivec2 toPixel(int along, int across)
+{
+  return Vertical ? ivec2(across, along) : ivec2(along, across);
+}
+
+vec3 load(int along, int across, ivec2 size)
+{
+  ivec2 pos = clamp(toPixel(along, across), ivec2(0), size - 1);
+  vec3 color = texelFetch(inputPicture, pos, 0).rgb;
+
+  // same as threshold.frag.glsl
+  if(Threshold && length(color) < ThresholdValue)
+    color = vec3(0);
+
+  return color;
+}
+
+void main()
+{
+  ivec2 size = textureSize(inputPicture, 0);
+  int radius = Params.radius;
+  int across = int(gl_WorkGroupID.y);
+  int tileStart = int(gl_WorkGroupID.x) * TileSize;
+
+  for(int i = int(gl_LocalInvocationID.x); i < TileSize + 2 * radius; i += TileSize)
+    tile[i] = load(tileStart - radius + i, across, size);
+
+  barrier();
+
+  ivec2 pos = toPixel(tileStart + int(gl_LocalInvocationID.x), across);
+
+  if(any(greaterThanEqual(pos, size)))
+    return;
+
+  int center = int(gl_LocalInvocationID.x) + radius;
+  vec3 result = tile[center] * Params.weights[0];
+
+  for(int i = 1; i <= radius; ++i)
+    result += Params.weights[i] * (tile[center - i] + tile[center + i]);
+
+  imageStore(outputPicture, pos, vec4(result, 1.0));
+}
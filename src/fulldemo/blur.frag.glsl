@@ -0,0 +1,67 @@
+#version 450
+
+// One direction of a separable Gaussian blur.
+// The kernel comes from 'computeBlurKernel' (gaussianblur.cpp), through specialization constants:
+// each side tap lands between two texels, and the bilinear sampler blends them.
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+// horizontal: read from picture0, vertical: read from picture1
+layout(set=0, binding=0) uniform sampler2D picture0;
+layout(set=0, binding=1) uniform sampler2D picture1;
+
+const int MaxTaps = 12; // must match 'MaxBlurTaps'
+
+layout(constant_id = 0) const bool Vertical = false;
+layout(constant_id = 1) const int TapCount = 1;
+
+layout(constant_id = 2) const float Offset0 = 0;
+layout(constant_id = 3) const float Offset1 = 0;
+layout(constant_id = 4) const float Offset2 = 0;
+layout(constant_id = 5) const float Offset3 = 0;
+layout(constant_id = 6) const float Offset4 = 0;
+layout(constant_id = 7) const float Offset5 = 0;
+layout(constant_id = 8) const float Offset6 = 0;
+layout(constant_id = 9) const float Offset7 = 0;
+layout(constant_id = 10) const float Offset8 = 0;
+layout(constant_id = 11) const float Offset9 = 0;
+layout(constant_id = 12) const float Offset10 = 0;
+layout(constant_id = 13) const float Offset11 = 0;
+
+layout(constant_id = 14) const float Weight0 = 1;
+layout(constant_id = 15) const float Weight1 = 0;
+layout(constant_id = 16) const float Weight2 = 0;
+layout(constant_id = 17) const float Weight3 = 0;
+layout(constant_id = 18) const float Weight4 = 0;
+layout(constant_id = 19) const float Weight5 = 0;
+layout(constant_id = 20) const float Weight6 = 0;
+layout(constant_id = 21) const float Weight7 = 0;
+layout(constant_id = 22) const float Weight8 = 0;
+layout(constant_id = 23) const float Weight9 = 0;
+layout(constant_id = 24) const float Weight10 = 0;
+layout(constant_id = 25) const float Weight11 = 0;
+
+const float Offsets[MaxTaps] = float[](Offset0, Offset1, Offset2, Offset3, Offset4, Offset5, Offset6, Offset7, Offset8, Offset9, Offset10, Offset11);
+const float Weights[MaxTaps] = float[](Weight0, Weight1, Weight2, Weight3, Weight4, Weight5, Weight6, Weight7, Weight8, Weight9, Weight10, Weight11);
+
+vec3 fetch(vec2 pos)
+{
+  return Vertical ? texture(picture1, pos).rgb : texture(picture0, pos).rgb;
+}
+
+void main()
+{
+  vec2 size = Vertical ? textureSize(picture1, 0) : textureSize(picture0, 0);
+  vec2 direction = Vertical ? vec2(0, 1.0 / size.y) : vec2(1.0 / size.x, 0);
+
+  vec3 result = fetch(uv) * Weights[0];
+
+  for(int i = 1; i < TapCount; ++i)
+  {
+    result += Weights[i] * fetch(uv + direction * Offsets[i]);
+    result += Weights[i] * fetch(uv - direction * Offsets[i]);
+  }
+
+  outColor = vec4(result, 1.0);
+}
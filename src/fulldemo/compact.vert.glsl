@@ -0,0 +1,57 @@
+#version 450
+
+// Same as shader.vert.glsl, for the 'CompactVertex' layout
+layout(location = 0) in vec4 inPosition; // UNORM, relative to the mesh bounding box
+layout(location = 1) in vec2 inNormal; // SNORM, octahedral-encoded
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec3 outWorldPosition;
+layout(location = 2) out float outViewDistance;
+
+// must match depth.vert.glsl bit-for-bit (EQUAL depth test after the prepass)
+invariant gl_Position;
+
+// Scene DescriptorSet (set=0), Camera (binding=0)
+layout(set=0, binding=0, std140) uniform MyDescriptorSet
+{
+  mat4x4 view;
+  mat4x4 proj;
+
+  // color pass only, see shader.frag.glsl
+  mat4x4 cascadeViewProj[4];
+  vec4 cascadeSplits;
+} UniformBlock;
+
+// Per draw: model transform (see 'PackedAffine'), and quantization box (identity for float positions)
+layout(push_constant) uniform MeshPushConstantBlock
+{
+  vec4 modelRows[3]; // affine: the last row is (0, 0, 0, 1)
+  vec4 boxMin;
+  vec4 boxSize;
+} Mesh;
+
+vec3 decodeOctahedral(vec2 e)
+{
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+void main()
+{
+  mat4x4 model = transpose(mat4x4(Mesh.modelRows[0], Mesh.modelRows[1], Mesh.modelRows[2], vec4(0, 0, 0, 1)));
+  vec3 position = Mesh.boxMin.xyz + inPosition.xyz * Mesh.boxSize.xyz;
+  vec3 normal = decodeOctahedral(inNormal);
+
+  mat4x4 tx = UniformBlock.proj * UniformBlock.view * model;
+  gl_Position = tx * vec4(position, 1);
+
+  // the cascade is selected per fragment
+  vec4 worldPosition = model * vec4(position, 1);
+  outWorldPosition = worldPosition.xyz;
+  outViewDistance = -(UniformBlock.view * worldPosition).z;
+
+  outNormal = (model * vec4(normal, 0)).xyz;
+}
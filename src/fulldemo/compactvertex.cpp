@@ -0,0 +1,167 @@
+#include "compactvertex.h"
+
+#include "common/vec3.h" // PI
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+uint16_t quantizeUnorm16(float value, float boxMin, float boxSize)
+{
+  if(boxSize <= 0)
+    return 0;
+
+  const float t = std::min(std::max((value - boxMin) / boxSize, 0.0f), 1.0f);
+  return (uint16_t)std::lround(t * 65535.0f);
+}
+
+int16_t quantizeSnorm16(float value)
+{
+  const float t = std::min(std::max(value, -1.0f), 1.0f);
+  return (int16_t)std::lround(t * 32767.0f);
+}
+
+float signNotZero(float value) { return value >= 0 ? 1.0f : -1.0f; }
+
+// Octahedral mapping: project the unit sphere on the octahedron |x|+|y|+|z|=1,
+// then unfold the lower hemisphere onto the corners of the [-1;1] square.
+void encodeOctahedral(float x, float y, float z, float& u, float& v)
+{
+  const float sum = std::abs(x) + std::abs(y) + std::abs(z);
+
+  if(sum <= 0)
+  {
+    u = v = 0;
+    return;
+  }
+
+  u = x / sum;
+  v = y / sum;
+
+  if(z < 0)
+  {
+    const float foldedU = (1 - std::abs(v)) * signNotZero(u);
+    const float foldedV = (1 - std::abs(u)) * signNotZero(v);
+    u = foldedU;
+    v = foldedV;
+  }
+}
+
+void decodeOctahedral(float u, float v, float& x, float& y, float& z)
+{
+  x = u;
+  y = v;
+  z = 1 - std::abs(u) - std::abs(v);
+
+  const float t = std::max(-z, 0.0f);
+  x += x >= 0 ? -t : t;
+  y += y >= 0 ? -t : t;
+
+  const float len = std::sqrt(x * x + y * y + z * z);
+  x /= len;
+  y /= len;
+  z /= len;
+}
+}
+
+QuantizationBox computeQuantizationBox(const std::vector<Vertex>& vertices)
+{
+  QuantizationBox box{};
+
+  if(vertices.empty())
+    return box;
+
+  float boxMax[3] = {vertices[0].x, vertices[0].y, vertices[0].z};
+  box.boxMin[0] = vertices[0].x;
+  box.boxMin[1] = vertices[0].y;
+  box.boxMin[2] = vertices[0].z;
+
+  for(auto& v : vertices)
+  {
+    const float pos[3] = {v.x, v.y, v.z};
+
+    for(int i = 0; i < 3; ++i)
+    {
+      box.boxMin[i] = std::min(box.boxMin[i], pos[i]);
+      boxMax[i] = std::max(boxMax[i], pos[i]);
+    }
+  }
+
+  for(int i = 0; i < 3; ++i)
+    box.boxSize[i] = boxMax[i] - box.boxMin[i];
+
+  return box;
+}
+
+std::vector<CompactVertex> compressVertices(const std::vector<Vertex>& vertices, const QuantizationBox& box)
+{
+  std::vector<CompactVertex> result;
+  result.reserve(vertices.size());
+
+  for(auto& v : vertices)
+  {
+    CompactVertex r{};
+    r.x = quantizeUnorm16(v.x, box.boxMin[0], box.boxSize[0]);
+    r.y = quantizeUnorm16(v.y, box.boxMin[1], box.boxSize[1]);
+    r.z = quantizeUnorm16(v.z, box.boxMin[2], box.boxSize[2]);
+
+    float u, w;
+    encodeOctahedral(v.nx, v.ny, v.nz, u, w);
+    r.nx = quantizeSnorm16(u);
+    r.ny = quantizeSnorm16(w);
+
+    result.push_back(r);
+  }
+
+  return result;
+}
+
+Vertex decompressVertex(const CompactVertex& vertex, const QuantizationBox& box)
+{
+  Vertex r{};
+  r.x = box.boxMin[0] + vertex.x / 65535.0f * box.boxSize[0];
+  r.y = box.boxMin[1] + vertex.y / 65535.0f * box.boxSize[1];
+  r.z = box.boxMin[2] + vertex.z / 65535.0f * box.boxSize[2];
+
+  // same as the SNORM fetch: -32768 and -32767 both map to -1
+  const float u = std::max(vertex.nx / 32767.0f, -1.0f);
+  const float v = std::max(vertex.ny / 32767.0f, -1.0f);
+  decodeOctahedral(u, v, r.nx, r.ny, r.nz);
+
+  return r;
+}
+
+QuantizationError measureQuantizationError(const std::vector<Vertex>& vertices, const std::vector<CompactVertex>& compressed, const QuantizationBox& box)
+{
+  QuantizationError r{};
+
+  float stepSquared = 0;
+
+  for(auto size : box.boxSize)
+    stepSquared += (size / 65535.0f) * (size / 65535.0f);
+
+  r.positionBound = 0.5f * std::sqrt(stepSquared);
+
+  for(size_t i = 0; i < vertices.size(); ++i)
+  {
+    const auto& original = vertices[i];
+    const auto decoded = decompressVertex(compressed[i], box);
+
+    const float dx = decoded.x - original.x;
+    const float dy = decoded.y - original.y;
+    const float dz = decoded.z - original.z;
+    r.position = std::max(r.position, std::sqrt(dx * dx + dy * dy + dz * dz));
+
+    const float len = std::sqrt(original.nx * original.nx + original.ny * original.ny + original.nz * original.nz);
+
+    if(len <= 0)
+      continue;
+
+    const float cosAngle = (decoded.nx * original.nx + decoded.ny * original.ny + decoded.nz * original.nz) / len;
+    const float angle = std::acos(std::min(std::max(cosAngle, -1.0f), 1.0f));
+    r.normalDegrees = std::max(r.normalDegrees, angle * 180.0f / (float)PI);
+  }
+
+  return r;
+}
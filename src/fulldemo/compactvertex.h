@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "objloader.h"
+
+// Compressed version of 'Vertex': 12 bytes instead of 24.
+struct CompactVertex
+{
+  uint16_t x, y, z, w; // position, UNORM, relative to the bounding box of the mesh ('w' is padding)
+  int16_t nx, ny; // normal, octahedral-encoded, SNORM
+};
+
+static_assert(sizeof(CompactVertex) == 12, "CompactVertex must stay tightly packed");
+
+// Quantization box, the vertex shader maps [0;1] back to [boxMin;boxMin+boxSize]
+struct QuantizationBox
+{
+  float boxMin[3];
+  float boxSize[3];
+};
+
+QuantizationBox computeQuantizationBox(const std::vector<Vertex>& vertices);
+std::vector<CompactVertex> compressVertices(const std::vector<Vertex>& vertices, const QuantizationBox& box);
+
+// CPU reference of the decoding done in the vertex shader
+Vertex decompressVertex(const CompactVertex& vertex, const QuantizationBox& box);
+
+struct QuantizationError
+{
+  float position; // max distance to the original position, in object units
+  float positionBound; // theoretical max: half the diagonal of one quantization step
+  float normalDegrees; // max angle to the original normal
+};
+
+QuantizationError measureQuantizationError(const std::vector<Vertex>& vertices, const std::vector<CompactVertex>& compressed, const QuantizationBox& box);
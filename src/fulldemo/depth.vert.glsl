@@ -0,0 +1,35 @@
+#version 450
+
+// Depth-only passes: reads the position-only vertex stream
+layout(location = 0) in vec4 inPosition; // float, or UNORM relative to the mesh bounding box
+
+// must match the color pass bit-for-bit (EQUAL depth test after the prepass)
+invariant gl_Position;
+
+// Scene DescriptorSet (set=0), Camera (binding=0)
+layout(set=0, binding=0, std140) uniform MyDescriptorSet
+{
+  mat4x4 view;
+  mat4x4 proj;
+
+  // color pass only, see shader.frag.glsl
+  mat4x4 cascadeViewProj[4];
+  vec4 cascadeSplits;
+} UniformBlock;
+
+// Per draw: model transform (see 'PackedAffine'), and quantization box (identity for float positions)
+layout(push_constant) uniform MeshPushConstantBlock
+{
+  vec4 modelRows[3]; // affine: the last row is (0, 0, 0, 1)
+  vec4 boxMin;
+  vec4 boxSize;
+} Mesh;
+
+void main()
+{
+  mat4x4 model = transpose(mat4x4(Mesh.modelRows[0], Mesh.modelRows[1], Mesh.modelRows[2], vec4(0, 0, 0, 1)));
+  vec3 position = Mesh.boxMin.xyz + inPosition.xyz * Mesh.boxSize.xyz;
+
+  mat4x4 tx = UniformBlock.proj * UniformBlock.view * model;
+  gl_Position = tx * vec4(position, 1);
+}
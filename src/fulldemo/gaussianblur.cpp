@@ -0,0 +1,52 @@
+#include "gaussianblur.h"
+
+#include <algorithm>
+#include <cmath>
+
+std::vector<float> computeGaussianWeights(float sigma)
+{
+  const int radius = sigma > 0 ? std::min((int)std::ceil(3 * sigma), MaxBlurRadius) : 0;
+
+  if(radius <= 0)
+    return {1.0f};
+
+  std::vector<double> weights(radius + 1);
+  double sum = 0;
+
+  for(int i = 0; i <= radius; ++i)
+  {
+    weights[i] = std::exp(-(i * i) / (2.0 * sigma * sigma));
+    sum += i == 0 ? weights[i] : 2 * weights[i];
+  }
+
+  std::vector<float> r;
+
+  for(auto w : weights)
+    r.push_back((float)(w / sum));
+
+  return r;
+}
+
+BlurKernel computeBlurKernel(float sigma)
+{
+  const std::vector<float> texelWeights = computeGaussianWeights(sigma);
+
+  BlurKernel r{};
+  r.radius = (int)texelWeights.size() - 1;
+  r.offsets[0] = 0;
+  r.weights[0] = texelWeights[0];
+  r.tapCount = 1;
+
+  // merge texels (1, 2), (3, 4), etc.
+  for(int i = 1; i <= r.radius; i += 2)
+  {
+    const double w0 = texelWeights[i];
+    const double w1 = i + 1 <= r.radius ? texelWeights[i + 1] : 0.0;
+
+    r.weights[r.tapCount] = (float)(w0 + w1);
+    r.offsets[r.tapCount] = (float)((i * w0 + (i + 1) * w1) / (w0 + w1));
+    ++r.tapCount;
+  }
+
+  return r;
+}
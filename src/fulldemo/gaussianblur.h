@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+// Must match 'MaxTaps' in blur.frag.glsl
+const int MaxBlurTaps = 12;
+
+// Widest kernel, in texels on each side of the center.
+// Must match 'MaxRadius' in bloomblur.comp.glsl
+const int MaxBlurRadius = 2 * (MaxBlurTaps - 1);
+
+// One side of a discrete Gaussian kernel: weights[0] is the center texel.
+// The kernel covers 3 sigmas, or 'MaxBlurRadius' for wide blurs (it's then renormalized).
+// The weights sum to 1, counting the side texels twice.
+std::vector<float> computeGaussianWeights(float sigma);
+
+// One direction of a separable Gaussian blur, for a bilinear sampler.
+// Except for the center one, each tap merges two adjacent texels: the fetch is
+// placed between both texels, so the hardware interpolation gives each one its
+// own Gaussian weight. This halves the fetch count.
+struct BlurKernel
+{
+  int tapCount = 0; // on each side, including the center tap
+  int radius = 0; // in texels
+  float offsets[MaxBlurTaps]{}; // in texels, offsets[0] is the center
+  float weights[MaxBlurTaps]{}; // sums to 1, counting the side taps twice
+};
+
+// Same coverage as 'computeGaussianWeights'.
+BlurKernel computeBlurKernel(float sigma);
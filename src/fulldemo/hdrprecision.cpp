@@ -0,0 +1,58 @@
+#include "hdrprecision.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// 5-bit exponent, bias 15
+const int MinExponent = -14;
+const int MaxExponent = 15;
+
+// Sweep of the tone-mapping error measurement, per channel: log-spaced from 2^SweepMinLog2 to 2^SweepMaxLog2
+const int SweepStepCount = 4096;
+const float SweepMinLog2 = -10;
+const float SweepMaxLog2 = 8;
+
+float tonemap(float value) { return value / (value + 1.0f); }
+}
+
+float roundToSmallFloat(float value, int mantissaBits)
+{
+  if(mantissaBits >= 23 || value <= 0)
+    return std::max(value, 0.0f);
+
+  int exponent;
+  std::frexp(value, &exponent); // value = [0.5;1[ * 2^exponent
+  exponent = std::max(exponent - 1, MinExponent); // below: denormals, same step as the smallest normals
+
+  const float step = std::ldexp(1.0f, exponent - mantissaBits);
+  const float maxValue = std::ldexp(2.0f - std::ldexp(1.0f, -mantissaBits), MaxExponent);
+
+  return std::min(std::floor(value / step) * step, maxValue);
+}
+
+TonemapError measureTonemapError(const int (&mantissaBits)[3])
+{
+  TonemapError r{};
+  double sumSquared = 0;
+  int count = 0;
+
+  // the channels are independent: sweeping each one separately covers all the colors of the sweep
+  for(int channel = 0; channel < 3; ++channel)
+  {
+    for(int i = 0; i < SweepStepCount; ++i)
+    {
+      const float value = std::exp2(SweepMinLog2 + (SweepMaxLog2 - SweepMinLog2) * i / (SweepStepCount - 1));
+      const float diff = (tonemap(roundToSmallFloat(value, mantissaBits[channel])) - tonemap(value)) * 255.0f;
+
+      r.max = std::max(r.max, std::abs(diff));
+      sumSquared += diff * diff;
+      ++count;
+    }
+  }
+
+  r.rms = std::sqrt(sumSquared / count);
+
+  return r;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// CPU emulation of the small float HDR formats (R16G16B16A16_SFLOAT, B10G11R11_UFLOAT_PACK32),
+// to bound the error they add to the tone-mapped picture: the tolerance of FullDemo's 'hdrdiff'.
+
+// Rounds toward zero to a value representable with a 5-bit exponent and 'mantissaBits' bits of mantissa
+// (10: half float, 6: 11-bit float, 5: 10-bit float). 23 or more: 32-bit float, unchanged.
+// Vulkan lets implementations round to nearest or toward zero when storing to these formats:
+// toward zero is the worst case, twice the error.
+// Only for non-negative values (the unsigned formats can't store anything else).
+float roundToSmallFloat(float value, int mantissaBits);
+
+struct TonemapError
+{
+  float max; // in steps of an 8-bit output
+  float rms;
+};
+
+// Error of the tone-mapped output (Reinhard, see tonemapping.frag.glsl) when the HDR color goes through
+// a format with 'mantissaBits[i]' bits of mantissa for channel i, over a sweep of HDR colors.
+// One store per color: the bloom chain, which stores its images several times, isn't modeled.
+// In linear steps: the sRGB encoding of the output only lowers the error (it's steeper for the dark
+// colors, where the tone-mapped error is smaller).
+TonemapError measureTonemapError(const int (&mantissaBits)[3]);
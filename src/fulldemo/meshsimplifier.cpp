@@ -0,0 +1,440 @@
+#include "meshsimplifier.h"
+
+#include "common/vec3.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <utility>
+
+namespace
+{
+
+// Weight of the constraint planes keeping open borders in place.
+// The meshes are split by material, so there are lots of them.
+const double BorderWeight = 10.0;
+
+// Symmetric 4x4 matrix: sum of squared distances to a set of planes
+struct Quadric
+{
+  // xx xy xz xw yy yz yw zz zw ww
+  double m[10]{};
+
+  void operator+=(const Quadric& other)
+  {
+    for(int i = 0; i < 10; ++i)
+      m[i] += other.m[i];
+  }
+};
+
+Quadric planeQuadric(Vec3f n, Vec3f p, double weight)
+{
+  const double a = n.x;
+  const double b = n.y;
+  const double c = n.z;
+  const double d = -dotProduct(n, p);
+
+  Quadric q;
+  q.m[0] = a * a * weight;
+  q.m[1] = a * b * weight;
+  q.m[2] = a * c * weight;
+  q.m[3] = a * d * weight;
+  q.m[4] = b * b * weight;
+  q.m[5] = b * c * weight;
+  q.m[6] = b * d * weight;
+  q.m[7] = c * c * weight;
+  q.m[8] = c * d * weight;
+  q.m[9] = d * d * weight;
+  return q;
+}
+
+double evaluate(const Quadric& q, Vec3f p)
+{
+  const double x = p.x;
+  const double y = p.y;
+  const double z = p.z;
+  const auto& m = q.m;
+
+  const double r = m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x + m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y + m[7] * z * z +
+                   2 * m[8] * z + m[9];
+
+  return std::max(r, 0.0);
+}
+
+// Finds the position minimizing the quadric, if the system isn't singular
+bool findOptimalPosition(const Quadric& q, Vec3f& result)
+{
+  const auto& m = q.m;
+
+  const double a[3][3] = {
+        {m[0], m[1], m[2]},
+        {m[1], m[4], m[5]},
+        {m[2], m[5], m[7]},
+  };
+
+  const double b[3] = {-m[3], -m[6], -m[8]};
+
+  auto det3 = [](const double(&c0)[3], const double(&c1)[3], const double(&c2)[3]) {
+    return c0[0] * (c1[1] * c2[2] - c2[1] * c1[2]) - c1[0] * (c0[1] * c2[2] - c2[1] * c0[2]) + c2[0] * (c0[1] * c1[2] - c1[1] * c0[2]);
+  };
+
+  const double col0[3] = {a[0][0], a[1][0], a[2][0]};
+  const double col1[3] = {a[0][1], a[1][1], a[2][1]};
+  const double col2[3] = {a[0][2], a[1][2], a[2][2]};
+
+  const double det = det3(col0, col1, col2);
+
+  if(std::abs(det) < 1e-9)
+    return false;
+
+  // Cramer's rule
+  result.x = det3(b, col1, col2) / det;
+  result.y = det3(col0, b, col2) / det;
+  result.z = det3(col0, col1, b) / det;
+
+  return true;
+}
+
+struct Triangle
+{
+  int v[3];
+  Vec3f normal[3]; // per-corner, carried along from the original mesh
+  bool dead = false;
+
+  bool contains(int vertex) const { return v[0] == vertex || v[1] == vertex || v[2] == vertex; }
+};
+
+struct Collapse
+{
+  double cost;
+  int keep, drop;
+  int keepVersion, dropVersion;
+  Vec3f target;
+
+  bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+class Simplifier
+{
+public:
+  Simplifier(const PlainMesh& mesh)
+  {
+    std::map<std::tuple<float, float, float>, int> weld;
+
+    auto findOrAddVertex = [&](const Vertex& vertex) {
+      auto key = std::make_tuple(vertex.x, vertex.y, vertex.z);
+      auto i = weld.find(key);
+      if(i != weld.end())
+        return i->second;
+
+      const int index = (int)positions.size();
+      positions.push_back({vertex.x, vertex.y, vertex.z});
+      weld[key] = index;
+      return index;
+    };
+
+    for(int i = 0; i + 2 < (int)mesh.vertices.size(); i += 3)
+    {
+      Triangle t{};
+
+      for(int k = 0; k < 3; ++k)
+      {
+        auto& vertex = mesh.vertices[i + k];
+        t.v[k] = findOrAddVertex(vertex);
+        t.normal[k] = {vertex.nx, vertex.ny, vertex.nz};
+      }
+
+      if(t.v[0] == t.v[1] || t.v[1] == t.v[2] || t.v[2] == t.v[0])
+        continue;
+
+      triangles.push_back(t);
+    }
+
+    liveTriangleCount = (int)triangles.size();
+
+    quadrics.resize(positions.size());
+    version.resize(positions.size());
+    removed.resize(positions.size());
+    vertexTriangles.resize(positions.size());
+
+    std::map<std::pair<int, int>, int> edgeUseCount;
+
+    for(int i = 0; i < (int)triangles.size(); ++i)
+    {
+      auto& t = triangles[i];
+
+      const Vec3f n = faceNormal(t);
+      const double len = magnitude(n);
+
+      if(len > 0)
+      {
+        // Unweighted planes: the accumulated cost stays a sum of squared distances,
+        // which gives us an error metric in object units.
+        const auto q = planeQuadric(n * (1.0 / len), positions[t.v[0]], 1.0);
+
+        for(int k = 0; k < 3; ++k)
+          quadrics[t.v[k]] += q;
+      }
+
+      for(int k = 0; k < 3; ++k)
+      {
+        vertexTriangles[t.v[k]].push_back(i);
+        edgeUseCount[makeEdge(t.v[k], t.v[(k + 1) % 3])]++;
+      }
+    }
+
+    // Constrain open borders with planes orthogonal to the adjacent face
+    for(auto& t : triangles)
+    {
+      const Vec3f n = faceNormal(t);
+
+      for(int k = 0; k < 3; ++k)
+      {
+        const int a = t.v[k];
+        const int b = t.v[(k + 1) % 3];
+
+        if(edgeUseCount[makeEdge(a, b)] != 1)
+          continue;
+
+        const Vec3f borderNormal = crossProduct(positions[b] - positions[a], n);
+        const double len = magnitude(borderNormal);
+
+        if(len <= 0)
+          continue;
+
+        const auto q = planeQuadric(borderNormal * (1.0 / len), positions[a], BorderWeight);
+        quadrics[a] += q;
+        quadrics[b] += q;
+      }
+    }
+
+    for(auto& edge : edgeUseCount)
+      pushCollapse(edge.first.first, edge.first.second);
+  }
+
+  int triangleCount() const { return liveTriangleCount; }
+
+  // Collapses edges until at most 'targetTriangleCount' triangles remain
+  void simplify(int targetTriangleCount)
+  {
+    while(liveTriangleCount > targetTriangleCount && !queue.empty())
+    {
+      const Collapse c = queue.top();
+      queue.pop();
+
+      if(removed[c.keep] || removed[c.drop])
+        continue;
+
+      if(version[c.keep] != c.keepVersion || version[c.drop] != c.dropVersion)
+        continue; // stale
+
+      if(wouldFlip(c))
+        continue;
+
+      applyCollapse(c);
+    }
+  }
+
+  MeshLod snapshot() const
+  {
+    MeshLod lod;
+    lod.error = std::sqrt(maxCost);
+
+    for(auto& t : triangles)
+    {
+      if(t.dead)
+        continue;
+
+      for(int k = 0; k < 3; ++k)
+      {
+        const Vec3f p = positions[t.v[k]];
+        const Vec3f n = t.normal[k];
+        lod.vertices.push_back({p.x, p.y, p.z, n.x, n.y, n.z});
+      }
+    }
+
+    return lod;
+  }
+
+private:
+  std::vector<Vec3f> positions;
+  std::vector<Quadric> quadrics;
+  std::vector<int> version;
+  std::vector<bool> removed;
+  std::vector<std::vector<int>> vertexTriangles;
+  std::vector<Triangle> triangles;
+  int liveTriangleCount = 0;
+  double maxCost = 0;
+
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+  static std::pair<int, int> makeEdge(int a, int b) { return a < b ? std::make_pair(a, b) : std::make_pair(b, a); }
+
+  Vec3f faceNormal(const Triangle& t) const
+  {
+    const Vec3f p0 = positions[t.v[0]];
+    const Vec3f p1 = positions[t.v[1]];
+    const Vec3f p2 = positions[t.v[2]];
+    return crossProduct(p1 - p0, p2 - p0);
+  }
+
+  void pushCollapse(int a, int b)
+  {
+    Quadric q = quadrics[a];
+    q += quadrics[b];
+
+    Collapse c{};
+    c.keep = a;
+    c.drop = b;
+    c.keepVersion = version[a];
+    c.dropVersion = version[b];
+
+    if(findOptimalPosition(q, c.target))
+    {
+      c.cost = evaluate(q, c.target);
+    }
+    else
+    {
+      // singular system: pick the best of both endpoints and the midpoint
+      const Vec3f candidates[] = {positions[a], positions[b], (positions[a] + positions[b]) * 0.5f};
+
+      c.cost = HUGE_VAL;
+
+      for(auto& candidate : candidates)
+      {
+        const double cost = evaluate(q, candidate);
+
+        if(cost < c.cost)
+        {
+          c.cost = cost;
+          c.target = candidate;
+        }
+      }
+    }
+
+    queue.push(c);
+  }
+
+  // Rejects collapses turning any surviving triangle upside-down
+  bool wouldFlip(const Collapse& c) const
+  {
+    for(int vertex : {c.keep, c.drop})
+    {
+      for(int i : vertexTriangles[vertex])
+      {
+        const auto& t = triangles[i];
+
+        if(t.dead || (t.contains(c.keep) && t.contains(c.drop)))
+          continue;
+
+        Triangle moved = t;
+
+        for(auto& v : moved.v)
+        {
+          if(v == c.keep || v == c.drop)
+            v = -1;
+        }
+
+        Vec3f p[3];
+
+        for(int k = 0; k < 3; ++k)
+          p[k] = moved.v[k] == -1 ? c.target : positions[moved.v[k]];
+
+        const Vec3f before = faceNormal(t);
+        const Vec3f after = crossProduct(p[1] - p[0], p[2] - p[0]);
+
+        if(dotProduct(before, after) <= 0)
+          return true;
+      }
+    }
+
+    return false;
+  }
+
+  void applyCollapse(const Collapse& c)
+  {
+    positions[c.keep] = c.target;
+    quadrics[c.keep] += quadrics[c.drop];
+    removed[c.drop] = true;
+    version[c.keep]++;
+    version[c.drop]++;
+
+    maxCost = std::max(maxCost, c.cost);
+
+    for(int i : vertexTriangles[c.drop])
+    {
+      auto& t = triangles[i];
+
+      if(t.dead)
+        continue;
+
+      if(t.contains(c.keep))
+      {
+        t.dead = true;
+        --liveTriangleCount;
+        continue;
+      }
+
+      for(auto& v : t.v)
+      {
+        if(v == c.drop)
+          v = c.keep;
+      }
+
+      vertexTriangles[c.keep].push_back(i);
+    }
+
+    vertexTriangles[c.drop].clear();
+
+    // re-evaluate all the edges around the moved vertex
+    std::vector<int> neighbours;
+
+    for(int i : vertexTriangles[c.keep])
+    {
+      const auto& t = triangles[i];
+
+      if(t.dead)
+        continue;
+
+      for(int v : t.v)
+      {
+        if(v != c.keep)
+          neighbours.push_back(v);
+      }
+    }
+
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+    for(int n : neighbours)
+      pushCollapse(c.keep, n);
+  }
+};
+
+} // namespace
+
+std::vector<MeshLod> buildLods(const PlainMesh& mesh, int lodCount)
+{
+  std::vector<MeshLod> result;
+
+  {
+    MeshLod lod0;
+    lod0.vertices = mesh.vertices;
+    result.push_back(std::move(lod0));
+  }
+
+  Simplifier simplifier(mesh);
+  const int initialTriangleCount = simplifier.triangleCount();
+
+  for(int level = 1; level < lodCount; ++level)
+  {
+    simplifier.simplify(initialTriangleCount >> level);
+    result.push_back(simplifier.snapshot());
+  }
+
+  return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include "objloader.h"
+
+// One level of detail of a PlainMesh
+struct MeshLod
+{
+  std::vector<Vertex> vertices;
+
+  // Upper bound of the distance between this LOD and the original surface,
+  // in object units.
+  float error = 0;
+};
+
+// Builds 'lodCount' levels of detail using quadric error metric edge collapse.
+// Level 0 is the original mesh, each following level keeps about half of the
+// triangles of the previous one.
+std::vector<MeshLod> buildLods(const PlainMesh& mesh, int lodCount);
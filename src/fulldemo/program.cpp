@@ -1,20 +1,112 @@
 #include "common/app.h"
+#include "common/descriptorallocator.h"
+#include "common/framegraph.h"
+#include "common/immediatesubmit.h"
 #include "common/matrix4.h"
+#include "common/shaderwatcher.h"
+#include "common/specialization.h"
 #include "common/util.h"
 #include "common/vkutil.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "compactvertex.h"
+#include "gaussianblur.h"
+#include "hdrprecision.h"
+#include "meshsimplifier.h"
 #include "objloader.h"
+#include "renderqueue.h"
 
 namespace
 {
 const VkFormat DepthFormat = VK_FORMAT_D16_UNORM;
-const VkFormat HdrFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
 
-const int ShadowMapSize = 4096;
+// Cascaded shadow map of the directional light: one layer per cascade, see 'computeShadowCascades'
+const int MaxShadowCascadeCount = 4; // see shader.frag.glsl
+const int ShadowCascadeSize = 1024;
+const float ShadowDistance = 40.0f; // view distance covered by the cascades
+const float ShadowSplitLambda = 0.75f; // 0: uniform splits, 1: logarithmic splits
+const float ShadowDepthBiasConstant = 2.0f; // in steps of DepthFormat, see 'createShadowMapPipeline'
+const float ShadowDepthBiasSlope = 2.0f; // times the depth slope of the polygon, per texel
+const Vec3f LightDirection = normalize(Vec3f(-6, -2, -7)); // towards the origin, from (6, 2, 7)
+
+// Filtering of the shadow lookups, see 'computeShadow' in shader.frag.glsl.
+// Every tap is a hardware compare, which blends the results of 2x2 texels.
+enum ShadowFilter
+{
+  ShadowFilterHardware, // one tap
+  ShadowFilterRotatedGrid, // kernel x kernel taps, on a grid rotated to break the horizontal and vertical edges
+  ShadowFilterPoisson, // kernel x kernel taps, on a Poisson disk rotated per pixel
+  ShadowFilterCount,
+};
+
+const int MaxShadowKernelSize = 4; // the Poisson disk has 16 points
+
+// Projection of the camera, see 'drawMainScene'
+const float CameraFovy = 1.5f;
+const float CameraAspect = 4.0f / 3.0f;
+const float CameraNear = 0.1f;
+const float CameraFar = 100.0f;
+
+// Levels of detail generated per mesh
+const int LodCount = 4;
+
+// Max geometric error allowed for a LOD, once projected on the target
+const float LodMaxPixelError = 1.0f; // in pixels, for the color pass
+const float ShadowLodMaxPixelError = 4.0f; // in shadow map texels: shadows are blurry anyway
+
+// Avoids selecting LOD0 forever when the camera is inside a mesh bounding sphere
+const float LodMinDistance = 0.5f;
+
+// Bloom mip chain: level 0 is half the swapchain resolution, each level halves it again
+const int BloomMipCount = 3;
+
+// Weight of the upsampled (wider) level, blended over the current one: higher spreads the bloom further.
+// With 3 levels, 0.5 matches the spread of the full resolution blur (sigma ~5 pixels).
+const float BloomScatter = 0.5f;
+
+// Spread of the tent of bloomupsample.frag.glsl, in texels of the level below
+const float BloomUpsampleRadius = 1.0f;
+
+// Length of the HDR color below which nothing blooms: threshold.frag.glsl, bloomprefilter.frag.glsl,
+// bloomblur.comp.glsl and the bright-pass of shader.frag.glsl
+const float BloomThreshold = 0.95f;
+
+// Output gamma of the tone-mapping, see tonemapping.frag.glsl
+const float TonemapGamma = 1.0f;
+
+// Compute bloom: texels blurred by each workgroup, must match bloomblur.comp.glsl
+const int ComputeBlurTileSize = 128;
+
+// Depth range covered by the draw sort keys (the far plane of the camera)
+const float SortMaxDistance = 100.0f;
+
+// GPU statistics are read back from a ring of queries, a few frames late, without stalling
+const int QueryRingSize = 4; // must be greater than the number of frames in flight
+
+// Slots of the transient descriptor sets, reset each frame by 'drawFrame'
+const int DescriptorFrameSlots = 3; // must be greater than the number of frames in flight
+
+// Timestamps written per frame, in 'timestampQueryPool'
+enum Timestamp
+{
+  TimestampFrameStart,
+  TimestampShadowEnd, // the color pass begins
+  TimestampColorEnd, // the post-processing begins
+  TimestampFrameEnd,
+  TimestampCount,
+};
+const int StatsReportPeriod = 300; // in frames
 
 ///////////////////////////////////////////////////////////////////////////////
 // Vertex
@@ -43,6 +135,123 @@ constexpr VkVertexInputAttributeDescription attributeDesc[] = {
             .offset = offsetof(Vertex, nx),
       }};
 
+// Same, for the 'CompactVertex' layout (option 'compact=1')
+constexpr VkVertexInputBindingDescription compactBindingDesc[] = {
+      // stride
+      {
+            .binding = 0,
+            .stride = sizeof(CompactVertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+      }};
+
+constexpr VkVertexInputAttributeDescription compactAttributeDesc[] = {
+      // position
+      {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16B16A16_UNORM,
+            .offset = offsetof(CompactVertex, x),
+      },
+      // normal
+      {
+            .location = 1,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16_SNORM,
+            .offset = offsetof(CompactVertex, nx),
+      }};
+
+// Position-only stream, for the depth-only passes (shadow map).
+// Positions are de-interleaved from the normals, so the vertex fetch
+// only pulls what the depth shader actually reads.
+struct PositionVertex
+{
+  float x, y, z;
+};
+
+struct CompactPositionVertex
+{
+  uint16_t x, y, z, w; // same quantization as 'CompactVertex'
+};
+
+static_assert(sizeof(CompactPositionVertex) == 8, "CompactPositionVertex must be tightly packed");
+
+constexpr VkVertexInputBindingDescription positionBindingDesc[] = {
+      // stride
+      {
+            .binding = 0,
+            .stride = sizeof(PositionVertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+      }};
+
+constexpr VkVertexInputAttributeDescription positionAttributeDesc[] = {
+      // position
+      {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R32G32B32_SFLOAT,
+            .offset = offsetof(PositionVertex, x),
+      }};
+
+constexpr VkVertexInputBindingDescription compactPositionBindingDesc[] = {
+      // stride
+      {
+            .binding = 0,
+            .stride = sizeof(CompactPositionVertex),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+      }};
+
+constexpr VkVertexInputAttributeDescription compactPositionAttributeDesc[] = {
+      // position
+      {
+            .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16B16A16_UNORM,
+            .offset = offsetof(CompactPositionVertex, x),
+      }};
+
+// Max acceptable angle between an original normal and its decoded counterpart
+const float MaxNormalQuantizationErrorDegrees = 0.05f;
+
+void setupVertexInput(VkPipelineVertexInputStateCreateInfo& vertexInputInfo, bool compactVertices)
+{
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+  if(compactVertices)
+  {
+    vertexInputInfo.vertexBindingDescriptionCount = lengthof(compactBindingDesc);
+    vertexInputInfo.pVertexBindingDescriptions = compactBindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = lengthof(compactAttributeDesc);
+    vertexInputInfo.pVertexAttributeDescriptions = compactAttributeDesc;
+  }
+  else
+  {
+    vertexInputInfo.vertexBindingDescriptionCount = lengthof(bindingDesc);
+    vertexInputInfo.pVertexBindingDescriptions = bindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = lengthof(attributeDesc);
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDesc;
+  }
+}
+
+void setupPositionVertexInput(VkPipelineVertexInputStateCreateInfo& vertexInputInfo, bool compactVertices)
+{
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+  if(compactVertices)
+  {
+    vertexInputInfo.vertexBindingDescriptionCount = lengthof(compactPositionBindingDesc);
+    vertexInputInfo.pVertexBindingDescriptions = compactPositionBindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = lengthof(compactPositionAttributeDesc);
+    vertexInputInfo.pVertexAttributeDescriptions = compactPositionAttributeDesc;
+  }
+  else
+  {
+    vertexInputInfo.vertexBindingDescriptionCount = lengthof(positionBindingDesc);
+    vertexInputInfo.pVertexBindingDescriptions = positionBindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = lengthof(positionAttributeDesc);
+    vertexInputInfo.pVertexAttributeDescriptions = positionAttributeDesc;
+  }
+}
+
 VkDeviceMemory createBufferMemory(VkPhysicalDevice physicalDevice, VkDevice device, VkBuffer buffer)
 {
   VkDeviceMemory memory{};
@@ -63,36 +272,94 @@ VkDeviceMemory createBufferMemory(VkPhysicalDevice physicalDevice, VkDevice devi
   return memory;
 }
 
-VkDescriptorPool createDescriptorPool(VkDevice device)
+// HDR color formats, from the smallest. The last one is always used as-is.
+// 'bits': per channel, as given to the 'hdrformat' option.
+struct HdrFormatInfo
+{
+  int bits;
+  VkFormat format;
+  int pixelSize; // in bytes
+  int mantissaBits[3]; // red, green, blue
+};
+
+const HdrFormatInfo HdrFormats[] = {
+      {11, VK_FORMAT_B10G11R11_UFLOAT_PACK32, 4, {6, 6, 5}},
+      {16, VK_FORMAT_R16G16B16A16_SFLOAT, 8, {10, 10, 10}},
+      {32, VK_FORMAT_R32G32B32A32_SFLOAT, 16, {23, 23, 23}},
+};
+
+// The smallest HDR format we can render to with blending, and sample with linear filtering.
+// 'forcedBits': if non-zero, only considers this format.
+const HdrFormatInfo& selectHdrFormat(VkPhysicalDevice physicalDevice, int forcedBits)
+{
+  const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+                                                VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+  const int last = lengthof(HdrFormats) - 1;
+
+  for(int i = 0; i <= last; ++i)
+  {
+    auto& candidate = HdrFormats[i];
+
+    if(forcedBits && candidate.bits != forcedBits)
+      continue;
+
+    if(i == last)
+      return candidate;
+
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, candidate.format, &properties);
+
+    if((properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures)
+      return candidate;
+
+    if(forcedBits)
+      throw std::runtime_error("the HDR format given by 'hdrformat' isn't supported");
+  }
+
+  throw std::runtime_error("unknown 'hdrformat', must be 0 (auto), 11, 16 or 32");
+}
+
+VkQueryPool createStatisticsQueryPool(VkDevice device, int queryCount)
+{
+  VkQueryPoolCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  info.queryCount = queryCount;
+  info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+  VkQueryPool queryPool{};
+
+  if(vkCreateQueryPool(device, &info, nullptr, &queryPool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create query pool");
+
+  return queryPool;
+}
+
+// Two timestamps per query: see 'drawFrame'
+VkQueryPool createTimestampQueryPool(VkDevice device, int queryCount)
 {
-  VkDescriptorPoolSize sizes[2];
-
-  // Uniform buffers
-  sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  sizes[0].descriptorCount = 16;
-
-  // Samplers
-  sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  sizes[1].descriptorCount = 16;
-
-  // Create the global descriptor pool
-  VkDescriptorPoolCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  info.poolSizeCount = lengthof(sizes);
-  info.pPoolSizes = sizes;
-  info.maxSets = 16; // number of desc sets that can be allocated from this pool
-
-  VkDescriptorPool descriptorPool;
-  vkCreateDescriptorPool(device, &info, nullptr, &descriptorPool);
-  return descriptorPool;
+  VkQueryPoolCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  info.queryCount = queryCount;
+
+  VkQueryPool queryPool{};
+
+  if(vkCreateQueryPool(device, &info, nullptr, &queryPool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create query pool");
+
+  return queryPool;
 }
 
-VkPipelineLayout createPipelineLayout(VkDevice device, std::vector<VkDescriptorSetLayout> setLayouts)
+VkPipelineLayout createPipelineLayout(VkDevice device, std::vector<VkDescriptorSetLayout> setLayouts, std::vector<VkPushConstantRange> pushConstantRanges = {})
 {
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = setLayouts.size();
   pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = pushConstantRanges.size();
+  pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
   VkPipelineLayout pipelineLayout;
 
@@ -102,9 +369,9 @@ VkPipelineLayout createPipelineLayout(VkDevice device, std::vector<VkDescriptorS
   return pipelineLayout;
 }
 
-VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass)
+VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, bool compactVertices)
 {
-  auto vertShaderCode = loadFile("bin/src/fulldemo/shader.vert.spv");
+  auto vertShaderCode = loadFile("bin/src/fulldemo/depth.vert.spv");
 
   VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode);
 
@@ -117,11 +384,102 @@ VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLay
   VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo};
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = lengthof(bindingDesc);
-  vertexInputInfo.pVertexBindingDescriptions = bindingDesc;
-  vertexInputInfo.vertexAttributeDescriptionCount = lengthof(attributeDesc);
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDesc;
+  setupPositionVertexInput(vertexInputInfo, compactVertices);
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  VkViewport viewport{};
+  viewport.x = 0.0f;
+  viewport.y = (float)ShadowCascadeSize;
+  viewport.width = (float)ShadowCascadeSize;
+  viewport.height = -(float)ShadowCascadeSize;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  VkRect2D scissor{};
+  scissor.offset = {0, 0};
+  scissor.extent = {ShadowCascadeSize, ShadowCascadeSize};
+
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.pViewports = &viewport;
+  viewportState.scissorCount = 1;
+  viewportState.pScissors = &scissor;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+  // pushes the casters away from the light: the receivers don't shadow themselves,
+  // including between the texels blended by the filtered lookups
+  rasterizer.depthBiasEnable = VK_TRUE;
+  rasterizer.depthBiasConstantFactor = ShadowDepthBiasConstant;
+  rasterizer.depthBiasSlopeFactor = ShadowDepthBiasSlope;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencilStateInfo{};
+  depthStencilStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencilStateInfo.depthTestEnable = VK_TRUE;
+  depthStencilStateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencilStateInfo.depthWriteEnable = VK_TRUE;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = lengthof(shaderStages);
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencilStateInfo;
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  VkPipeline pipeline{};
+
+  if(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    throw std::runtime_error("failed to create graphics pipeline");
+
+  vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+  return pipeline;
+}
+
+// Depth-only pipeline for the color render pass: fills the depth buffer
+// from the position-only stream, without writing any color.
+VkPipeline createDepthPrepassPipeline(
+      VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, bool compactVertices, bool brightPassTarget)
+{
+  auto vertShaderCode = loadFile("bin/src/fulldemo/depth.vert.spv");
+
+  VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode);
+
+  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+  vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vertShaderStageInfo.module = vertShaderModule;
+  vertShaderStageInfo.pName = "main";
+
+  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo};
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  setupPositionVertexInput(vertexInputInfo, compactVertices);
 
   VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
   inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -130,15 +488,15 @@ VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLay
 
   VkViewport viewport{};
   viewport.x = 0.0f;
-  viewport.y = (float)ShadowMapSize;
-  viewport.width = (float)ShadowMapSize;
-  viewport.height = -(float)ShadowMapSize;
+  viewport.y = (float)swapchainExtent.height;
+  viewport.width = (float)swapchainExtent.width;
+  viewport.height = -((float)swapchainExtent.height);
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
 
   VkRect2D scissor{};
   scissor.offset = {0, 0};
-  scissor.extent = {ShadowMapSize, ShadowMapSize};
+  scissor.extent = swapchainExtent;
 
   VkPipelineViewportStateCreateInfo viewportState{};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -162,6 +520,22 @@ VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLay
   multisampling.sampleShadingEnable = VK_FALSE;
   multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+  // the render pass has color attachments: keep them untouched
+  VkPipelineColorBlendAttachmentState colorBlendAttachments[2]{};
+
+  for(auto& colorBlendAttachment : colorBlendAttachments)
+  {
+    colorBlendAttachment.colorWriteMask = 0;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+  }
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount = brightPassTarget ? 2 : 1;
+  colorBlending.pAttachments = colorBlendAttachments;
+
   VkPipelineDepthStencilStateCreateInfo depthStencilStateInfo{};
   depthStencilStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
   depthStencilStateInfo.depthTestEnable = VK_TRUE;
@@ -178,6 +552,7 @@ VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLay
   pipelineInfo.pRasterizationState = &rasterizer;
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pDepthStencilState = &depthStencilStateInfo;
+  pipelineInfo.pColorBlendState = &colorBlending;
   pipelineInfo.layout = pipelineLayout;
   pipelineInfo.renderPass = renderPass;
   pipelineInfo.subpass = 0;
@@ -193,9 +568,15 @@ VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLay
   return pipeline;
 }
 
-VkPipeline createColorPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass)
+// With 'depthPrepass', the depth buffer already holds the final depth:
+// only the visible fragments pass the EQUAL test, and get shaded.
+// With 'brightPassTarget', the fragment shader also writes the bright-pass (bloom threshold)
+// to a second color attachment: see the color pass of 'FullDemo::addFrameGraphPasses'.
+// 'shadowFilter': see 'ShadowFilter'
+VkPipeline createColorPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, bool compactVertices,
+      bool depthPrepass, bool brightPassTarget, int shadowFilter, int shadowKernelSize)
 {
-  auto vertShaderCode = loadFile("bin/src/fulldemo/shader.vert.spv");
+  auto vertShaderCode = loadFile(compactVertices ? "bin/src/fulldemo/compact.vert.spv" : "bin/src/fulldemo/shader.vert.spv");
   auto fragShaderCode = loadFile("bin/src/fulldemo/shader.frag.spv");
 
   VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode);
@@ -213,14 +594,14 @@ VkPipeline createColorPipeline(VkDevice device, VkPipelineLayout pipelineLayout,
   fragShaderStageInfo.module = fragShaderModule;
   fragShaderStageInfo.pName = "main";
 
+  Specialization specialization;
+  specialization.set(0, brightPassTarget).set(1, shadowFilter).set(2, shadowKernelSize).set(3, BloomThreshold);
+  fragShaderStageInfo.pSpecializationInfo = specialization.getInfo();
+
   VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInputInfo.vertexBindingDescriptionCount = lengthof(bindingDesc);
-  vertexInputInfo.pVertexBindingDescriptions = bindingDesc;
-  vertexInputInfo.vertexAttributeDescriptionCount = lengthof(attributeDesc);
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDesc;
+  setupVertexInput(vertexInputInfo, compactVertices);
 
   VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
   inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -261,16 +642,20 @@ VkPipeline createColorPipeline(VkDevice device, VkPipelineLayout pipelineLayout,
   multisampling.sampleShadingEnable = VK_FALSE;
   multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
+  VkPipelineColorBlendAttachmentState colorBlendAttachments[2]{};
+
+  for(auto& colorBlendAttachment : colorBlendAttachments)
+  {
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+  }
 
   VkPipelineColorBlendStateCreateInfo colorBlending{};
   colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
   colorBlending.logicOpEnable = VK_FALSE;
   colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
+  colorBlending.attachmentCount = brightPassTarget ? 2 : 1;
+  colorBlending.pAttachments = colorBlendAttachments;
   colorBlending.blendConstants[0] = 0.0f;
   colorBlending.blendConstants[1] = 0.0f;
   colorBlending.blendConstants[2] = 0.0f;
@@ -279,8 +664,8 @@ VkPipeline createColorPipeline(VkDevice device, VkPipelineLayout pipelineLayout,
   VkPipelineDepthStencilStateCreateInfo depthStencilStateInfo{};
   depthStencilStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
   depthStencilStateInfo.depthTestEnable = VK_TRUE;
-  depthStencilStateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-  depthStencilStateInfo.depthWriteEnable = VK_TRUE;
+  depthStencilStateInfo.depthCompareOp = depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencilStateInfo.depthWriteEnable = depthPrepass ? VK_FALSE : VK_TRUE;
 
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -309,7 +694,14 @@ VkPipeline createColorPipeline(VkDevice device, VkPipelineLayout pipelineLayout,
   return pipeline;
 }
 
-VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, const char* shaderPath)
+// With 'dynamicViewport', the viewport and scissor are set at draw time (e.g: mip chains).
+// 'fragSpecialization', if any, provides the fragment shader specialization constants.
+// With 'blendWithTarget', the output is blended over the target using the blend constant:
+// target = output * blendConstant + target * (1 - blendConstant)
+// 'subpass': index of the subpass of 'renderPass' the pipeline is used in.
+VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, const char* shaderPath,
+      bool dynamicViewport = false, bool blendWithTarget = false, float blendConstant = 0, const VkSpecializationInfo* fragSpecialization = nullptr,
+      uint32_t subpass = 0)
 {
   auto vertShaderCode = loadFile("bin/src/fulldemo/quad.vert.spv");
   auto fragShaderCode = loadFile(shaderPath);
@@ -328,6 +720,7 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   fragShaderStageInfo.module = fragShaderModule;
   fragShaderStageInfo.pName = "main";
+  fragShaderStageInfo.pSpecializationInfo = fragSpecialization;
 
   VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
@@ -380,6 +773,17 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   VkPipelineColorBlendAttachmentState colorBlendAttachment{};
   colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
 
+  if(blendWithTarget)
+  {
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_CONSTANT_COLOR;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+  }
+
   VkPipelineColorBlendStateCreateInfo colorBlending{};
   colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
   colorBlending.logicOpEnable = VK_FALSE;
@@ -387,6 +791,16 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   colorBlending.attachmentCount = 1;
   colorBlending.pAttachments = &colorBlendAttachment;
 
+  for(auto& c : colorBlending.blendConstants)
+    c = blendConstant;
+
+  const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = lengthof(dynamicStates);
+  dynamicState.pDynamicStates = dynamicStates;
+
   VkGraphicsPipelineCreateInfo pipelineInfo{};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
   pipelineInfo.stageCount = lengthof(shaderStages);
@@ -397,8 +811,10 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   pipelineInfo.pRasterizationState = &rasterizer;
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = dynamicViewport ? &dynamicState : nullptr;
   pipelineInfo.layout = pipelineLayout;
   pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = subpass;
 
   VkPipeline pipeline{};
 
@@ -411,42 +827,232 @@ VkPipeline createPostprocPipeline(VkDevice device, VkPipelineLayout pipelineLayo
   return pipeline;
 }
 
-VkBuffer createVertexBuffer(VkDevice device, size_t size)
+// One direction of the separable Gaussian blur: see blur.frag.glsl
+VkPipeline createBlurPipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkExtent2D swapchainExtent, VkRenderPass renderPass, const BlurKernel& kernel,
+      bool vertical)
 {
-  VkBuffer vertexBuffer;
-  VkBufferCreateInfo bufferInfo{};
-  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = size;
-  bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  Specialization specialization;
+  specialization.set(0, vertical).set(1, kernel.tapCount);
 
-  if(vkCreateBuffer(device, &bufferInfo, nullptr, &vertexBuffer) != VK_SUCCESS)
-    throw std::runtime_error("failed to create vertex buffer");
+  // the unused taps keep their defaults
+  for(int i = 0; i < kernel.tapCount; ++i)
+  {
+    specialization.set(2 + i, kernel.offsets[i]);
+    specialization.set(2 + MaxBlurTaps + i, kernel.weights[i]);
+  }
 
-  return vertexBuffer;
+  return createPostprocPipeline(
+        device, pipelineLayout, swapchainExtent, renderPass, "bin/src/fulldemo/blur.frag.spv", false, false, 0, specialization.getInfo());
 }
 
-VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout)
+VkPipeline createComputePipeline(VkDevice device, VkPipelineLayout pipelineLayout, const char* shaderPath, const VkSpecializationInfo* specialization = nullptr)
 {
-  VkDescriptorSetAllocateInfo allocateInfo{};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocateInfo.descriptorPool = pool;
-  allocateInfo.descriptorSetCount = 1;
-  allocateInfo.pSetLayouts = &layout;
-  VkDescriptorSet descriptorSet;
-  vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
-  assert(descriptorSet);
-  return descriptorSet;
+  auto shaderCode = loadFile(shaderPath);
+
+  VkShaderModule shaderModule = createShaderModule(device, shaderCode);
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = shaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.pSpecializationInfo = specialization;
+  pipelineInfo.layout = pipelineLayout;
+
+  VkPipeline pipeline{};
+
+  if(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+    throw std::runtime_error("failed to create compute pipeline");
+
+  vkDestroyShaderModule(device, shaderModule, nullptr);
+
+  return pipeline;
 }
 
-struct VulkanMesh
+// One direction of the compute bloom blur: see bloomblur.comp.glsl
+VkPipeline createComputeBlurPipeline(VkDevice device, VkPipelineLayout pipelineLayout, bool vertical, bool threshold)
 {
+  Specialization specialization;
+  specialization.set(0, vertical).set(1, threshold).set(2, BloomThreshold);
+
+  return createComputePipeline(device, pipelineLayout, "bin/src/fulldemo/bloomblur.comp.spv", specialization.getInfo());
+}
+
+VkBuffer createVertexBuffer(VkDevice device, size_t size)
+{
+  VkBuffer vertexBuffer;
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if(vkCreateBuffer(device, &bufferInfo, nullptr, &vertexBuffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to create vertex buffer");
+
+  return vertexBuffer;
+}
+
+
+struct VulkanMesh
+{
+  struct Lod
+  {
+    int firstVertex = 0;
+    int vertexCount = 0;
+    float error = 0;
+  };
+
   int material;
-  int vertexCount = 0;
+  std::vector<Lod> lods; // all stored in 'vertexBuffer', from finest to coarsest
+  QuantizationBox box{}; // only used with compact vertices
+  Vec3f center; // bounding sphere, object space
+  float radius = 0;
   VkBuffer vertexBuffer{};
   VkDeviceMemory vertexMemory{};
+  VkBuffer positionBuffer{}; // position-only copy of 'vertexBuffer', same vertex order
+  VkDeviceMemory positionMemory{};
+};
+
+void computeBoundingSphere(const std::vector<Vertex>& vertices, Vec3f& center, float& radius)
+{
+  Vec3f boxMin = {vertices[0].x, vertices[0].y, vertices[0].z};
+  Vec3f boxMax = boxMin;
+
+  for(auto& v : vertices)
+  {
+    boxMin = {std::min(boxMin.x, v.x), std::min(boxMin.y, v.y), std::min(boxMin.z, v.z)};
+    boxMax = {std::max(boxMax.x, v.x), std::max(boxMax.y, v.y), std::max(boxMax.z, v.z)};
+  }
+
+  center = (boxMin + boxMax) * 0.5f;
+  radius = 0;
+
+  for(auto& v : vertices)
+    radius = std::max(radius, (float)magnitude(Vec3f(v.x, v.y, v.z) - center));
+}
+
+// Normalized view distance of the nearest point of the mesh bounding sphere, for sorting
+float computeSortDepth(const VulkanMesh& mesh, const Matrix4f& modelView)
+{
+  const Vec4f center = modelView * Vec4f{mesh.center.x, mesh.center.y, mesh.center.z, 1};
+  const float distance = (float)magnitude({center.x, center.y, center.z}) - mesh.radius;
+  return distance / SortMaxDistance;
+}
+
+// Picks the coarsest LOD whose error stays below 'maxPixelError', where one object unit covers 'pixelsPerUnit' pixels
+int selectLodAtScale(const VulkanMesh& mesh, float pixelsPerUnit, float maxPixelError)
+{
+  int result = 0;
+
+  for(int i = 1; i < (int)mesh.lods.size(); ++i)
+  {
+    if(mesh.lods[i].error * pixelsPerUnit <= maxPixelError)
+      result = i;
+  }
+
+  return result;
+}
+
+// Same, once projected on the target by a perspective projection
+int selectLod(const VulkanMesh& mesh, const Matrix4f& modelView, const Matrix4f& proj, float targetHeight, float maxPixelError)
+{
+  const Vec4f center = modelView * Vec4f{mesh.center.x, mesh.center.y, mesh.center.z, 1};
+  const float distance = std::max((float)magnitude({center.x, center.y, center.z}) - mesh.radius, LodMinDistance);
+
+  // size, in pixels, of one object unit at this distance
+  const float pixelsPerUnit = proj[1][1] * targetHeight * 0.5f / distance;
+
+  return selectLodAtScale(mesh, pixelsPerUnit, maxPixelError);
+}
+
+// One cascade of the shadow map: an orthographic projection fitted around a slice of the camera frustum
+struct ShadowCascade
+{
+  Matrix4f view; // world to light space
+  Matrix4f proj;
+  float splitDistance = 0; // far view distance of the slice
+
+  // light space: the fitted sphere (receivers), and the depth range (casters and receivers)
+  Vec3f center;
+  float radius = 0;
+  float nearDepth = 0;
+  float farDepth = 0;
 };
 
+// Practical split scheme: a blend of the logarithmic split (same texel/pixel ratio in every cascade) and of the uniform split
+float computeCascadeSplit(int index, int count)
+{
+  const float t = float(index) / count;
+  const float logSplit = CameraNear * std::pow(ShadowDistance / CameraNear, t);
+  const float uniformSplit = CameraNear + (ShadowDistance - CameraNear) * t;
+  return ShadowSplitLambda * logSplit + (1 - ShadowSplitLambda) * uniformSplit;
+}
+
+// Whether the bounding sphere of the mesh overlaps the cascade rectangle, in front of its farthest receivers.
+// 'modelLightView': model to light space, rotations and translations only.
+bool isShadowCaster(const ShadowCascade& cascade, const VulkanMesh& mesh, const Matrix4f& modelLightView)
+{
+  const Vec4f center = modelLightView * Vec4f{mesh.center.x, mesh.center.y, mesh.center.z, 1};
+  const float reach = cascade.radius + mesh.radius;
+
+  return std::abs(center.x - cascade.center.x) <= reach && std::abs(center.y - cascade.center.y) <= reach && -center.z - mesh.radius <= cascade.farDepth;
+}
+
+// Fits each cascade around its slice of the camera frustum, up to 'ShadowDistance'.
+// Stable fitting: the size of the bounding sphere of a slice doesn't depend on the camera orientation,
+// and its center moves by whole texels in light space: the shadow edges don't shimmer when the camera moves.
+// The depth range starts at the nearest caster: occluders between the light and the slice still cast shadows.
+void computeShadowCascades(ShadowCascade* cascades, int count, const Matrix4f& cameraView, const Matrix4f& model, const std::vector<VulkanMesh>& meshes)
+{
+  const Matrix4f lightView = lookAt({0, 0, 0}, LightDirection, {0, 0, 1});
+  const Matrix4f cameraToLight = lightView * invertStandardMatrix(cameraView);
+  const Matrix4f modelLightView = lightView * model;
+
+  // squared distance from the view axis to the corners of the frustum, at a view distance of 1
+  const float tanHalfFovy = std::tan(CameraFovy / 2);
+  const float k2 = tanHalfFovy * tanHalfFovy * (1 + CameraAspect * CameraAspect);
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto& cascade = cascades[i];
+    const float nearDistance = computeCascadeSplit(i, count);
+    const float farDistance = computeCascadeSplit(i + 1, count);
+
+    // bounding sphere of the slice: on the view axis, equidistant from the near and far corners (when that's inside the slice)
+    const float centerDistance = std::min((nearDistance + farDistance) * (1 + k2) / 2, farDistance);
+    const float nearReach = std::sqrt((centerDistance - nearDistance) * (centerDistance - nearDistance) + nearDistance * nearDistance * k2);
+    const float farReach = std::sqrt((farDistance - centerDistance) * (farDistance - centerDistance) + farDistance * farDistance * k2);
+
+    // rounded up: float noise would change the texel size from one frame to the next
+    const float radius = std::ceil(std::max(nearReach, farReach) * 16) / 16;
+    const float texelSize = 2 * radius / ShadowCascadeSize;
+
+    Vec4f center = cameraToLight * Vec4f{0, 0, -centerDistance, 1};
+    center.x = std::floor(center.x / texelSize) * texelSize;
+    center.y = std::floor(center.y / texelSize) * texelSize;
+
+    cascade.center = {center.x, center.y, center.z};
+    cascade.radius = radius;
+    cascade.farDepth = -center.z + radius;
+    cascade.nearDepth = -center.z - radius;
+
+    for(auto& mesh : meshes)
+    {
+      if(!isShadowCaster(cascade, mesh, modelLightView))
+        continue;
+
+      const Vec4f meshCenter = modelLightView * Vec4f{mesh.center.x, mesh.center.y, mesh.center.z, 1};
+      cascade.nearDepth = std::min(cascade.nearDepth, -meshCenter.z - mesh.radius);
+    }
+
+    cascade.view = lightView;
+    cascade.proj = orthographic(center.x - radius, center.x + radius, center.y - radius, center.y + radius, cascade.nearDepth, cascade.farDepth);
+    cascade.splitDistance = farDistance;
+  }
+}
+
 struct VulkanFramebuffer
 {
   VkImage image;
@@ -463,21 +1069,56 @@ struct VulkanFramebufferWithDepth : VulkanFramebuffer
   VkDeviceMemory depthMemory;
 };
 
-struct VulkanMaterial
+// Level 0 is half resolution
+VkExtent2D computeBloomMipExtent(VkExtent2D extent, int level)
 {
-  VkDescriptorSet descriptorSet;
-  VkBuffer uniformBuffer;
-  VkDeviceMemory memory;
+  const uint32_t width = std::max(extent.width >> (level + 1), 1u);
+  const uint32_t height = std::max(extent.height >> (level + 1), 1u);
+  return {width, height};
+}
+
+// Images of FullDemo's frame graph, -1 for the ones it doesn't have
+struct FrameImages
+{
+  FrameGraphImage shadowMap = -1; // one layer per cascade
+  FrameGraphImage hdr = -1; // the bright-pass with 'subpasstonemap'
+  FrameGraphImage depth = -1;
+  FrameGraphImage bloom[2]{-1, -1};
+  FrameGraphImage bloomMips[BloomMipCount]{};
 };
 
+// Per frame (per cascade for the shadow passes): the per-draw data is in 'MeshPushConstant'
 struct MyUniformBlock
 {
-  Matrix4f model;
   Matrix4f view;
   Matrix4f proj;
-  Matrix4f LightMVP;
+
+  // color pass only, see 'ShadowCascade'
+  Matrix4f cascadeViewProj[MaxShadowCascadeCount]; // world to cascade clip space
+  float cascadeSplits[MaxShadowCascadeCount]; // far view distance of each cascade
 };
 
+// Push constants of the scene vertex shaders, per draw
+struct MeshPushConstant
+{
+  PackedAffine model;
+  Vec4f boxMin; // quantization box of 'compact.vert.glsl', identity for float positions
+  Vec4f boxSize;
+  int32_t materialIndex; // in the material table, read by shader.frag.glsl
+};
+
+static_assert(sizeof(MeshPushConstant) <= 128, "exceeds the minimum guaranteed push constant size");
+
+// Compute bloom blur kernel, see bloomblur.comp.glsl
+struct ComputeBlurPushConstant
+{
+  int32_t radius;
+  float weights[MaxBlurRadius + 1];
+};
+
+static_assert(sizeof(ComputeBlurPushConstant) <= 128, "exceeds the minimum guaranteed push constant size");
+
+// One entry of the material table (std430), indexed by 'MeshPushConstant::materialIndex'
 struct MaterialParams
 {
   Vec4f diffuse;
@@ -491,7 +1132,7 @@ VkDescriptorSetLayout createSceneDescriptorSetLayout(VkDevice device)
   VkDescriptorSetLayoutBinding cameraBinding{};
   cameraBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
   cameraBinding.binding = 0;
-  cameraBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  cameraBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // the fragment shader reads the cascades
   cameraBinding.descriptorCount = 1;
 
   // Shadow Map (binding=1)
@@ -516,58 +1157,18 @@ VkDescriptorSetLayout createSceneDescriptorSetLayout(VkDevice device)
 }
 
 // Perspective: Scene (set=0)
-void setupDescriptorSet_MainScene(VkDevice device, VkDescriptorSet ds, VkBuffer uniformBuffer, const VulkanFramebuffer& shadowMap)
+std::vector<DescriptorWrite> describeDescriptorSet_MainScene(VkBuffer uniformBuffer, const VulkanFramebuffer& shadowMap)
 {
-  assert(ds);
-
-  VkWriteDescriptorSet writeInfo[2]{};
-
-  VkDescriptorBufferInfo infoBinding1{};
-  infoBinding1.buffer = uniformBuffer;
-  infoBinding1.range = sizeof(MyUniformBlock);
-
-  // Binding 0: Camera
-  writeInfo[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeInfo[0].dstSet = ds;
-  writeInfo[0].dstBinding = 0;
-  writeInfo[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  writeInfo[0].pBufferInfo = &infoBinding1;
-  writeInfo[0].descriptorCount = 1;
-
-  VkDescriptorImageInfo infoBinding0{};
-  infoBinding0.sampler = shadowMap.sampler;
-  infoBinding0.imageView = shadowMap.view;
-  infoBinding0.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
-  // Binding 1: ShadowMap
-  writeInfo[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeInfo[1].dstSet = ds;
-  writeInfo[1].dstBinding = 1;
-  writeInfo[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  writeInfo[1].pImageInfo = &infoBinding0;
-  writeInfo[1].descriptorCount = 1;
-
-  vkUpdateDescriptorSets(device, lengthof(writeInfo), writeInfo, 0, nullptr);
+  return {
+        bufferDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer, sizeof(MyUniformBlock)), // Camera
+        imageDescriptor(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, shadowMap.view, shadowMap.sampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL),
+  };
 }
 
 // Perspective: Scene (set=0)
-void setupDescriptorSet_ShadowMapScene(VkDevice device, VkDescriptorSet ds, VkBuffer shadowMapUniformBuffer)
+std::vector<DescriptorWrite> describeDescriptorSet_ShadowMapScene(VkBuffer shadowMapUniformBuffer)
 {
-  VkWriteDescriptorSet writeInfo[1]{};
-
-  VkDescriptorBufferInfo infoBinding1{};
-  infoBinding1.buffer = shadowMapUniformBuffer;
-  infoBinding1.range = sizeof(MyUniformBlock);
-
-  // Binding 0: uniform buffer
-  writeInfo[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeInfo[0].dstSet = ds;
-  writeInfo[0].dstBinding = 0;
-  writeInfo[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  writeInfo[0].pBufferInfo = &infoBinding1;
-  writeInfo[0].descriptorCount = 1;
-
-  vkUpdateDescriptorSets(device, lengthof(writeInfo), writeInfo, 0, nullptr);
+  return {bufferDescriptor(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, shadowMapUniformBuffer, sizeof(MyUniformBlock))};
 }
 
 // Postproc (set=0)
@@ -602,47 +1203,100 @@ VkDescriptorSetLayout createPostprocDescriptorSetLayout(VkDevice device)
 }
 
 // PostProc (set=0)
-void setupDescriptorSet_InputPicture(VkDevice device, VkDescriptorSet ds, VulkanFramebuffer& inputPicture0, VulkanFramebuffer& inputPicture1)
+std::vector<DescriptorWrite> describeDescriptorSet_InputPicture(const VulkanFramebuffer& inputPicture0, const VulkanFramebuffer& inputPicture1)
+{
+  return {
+        imageDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, inputPicture0.view, inputPicture0.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        imageDescriptor(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, inputPicture1.view, inputPicture1.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+  };
+}
+
+// Compute postproc (set=0)
+VkDescriptorSetLayout createComputeDescriptorSetLayout(VkDevice device)
+{
+  // InputPicture (binding=0)
+  VkDescriptorSetLayoutBinding input{};
+  input.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  input.binding = 0;
+  input.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  input.descriptorCount = 1;
+
+  // OutputPicture (binding=1)
+  VkDescriptorSetLayoutBinding output{};
+  output.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  output.binding = 1;
+  output.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  output.descriptorCount = 1;
+
+  VkDescriptorSetLayoutBinding setLayoutBindings[] = {input, output};
+
+  // Create the descriptor set layout
+  VkDescriptorSetLayoutCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  info.bindingCount = lengthof(setLayoutBindings);
+  info.pBindings = setLayoutBindings;
+
+  VkDescriptorSetLayout result;
+  vkCreateDescriptorSetLayout(device, &info, nullptr, &result);
+
+  return result;
+}
+
+// Compute postproc (set=0)
+std::vector<DescriptorWrite> describeDescriptorSet_Compute(const VulkanFramebuffer& inputPicture, const VulkanFramebuffer& outputPicture)
+{
+  return {
+        imageDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, inputPicture.view, inputPicture.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        imageDescriptor(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, outputPicture.view, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL),
+  };
+}
+
+// Subpass tone-mapping (set=0)
+VkDescriptorSetLayout createSubpassTonemapDescriptorSetLayout(VkDevice device)
+{
+  // HDR color (binding=0)
+  VkDescriptorSetLayoutBinding hdr{};
+  hdr.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+  hdr.binding = 0;
+  hdr.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  hdr.descriptorCount = 1;
+
+  // Bloom (binding=1)
+  VkDescriptorSetLayoutBinding bloom{};
+  bloom.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bloom.binding = 1;
+  bloom.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  bloom.descriptorCount = 1;
+
+  VkDescriptorSetLayoutBinding setLayoutBindings[] = {hdr, bloom};
+
+  // Create the descriptor set layout
+  VkDescriptorSetLayoutCreateInfo info{};
+  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  info.bindingCount = lengthof(setLayoutBindings);
+  info.pBindings = setLayoutBindings;
+
+  VkDescriptorSetLayout result;
+  vkCreateDescriptorSetLayout(device, &info, nullptr, &result);
+
+  return result;
+}
+
+// Subpass tone-mapping (set=0)
+std::vector<DescriptorWrite> describeDescriptorSet_SubpassTonemap(VkImageView hdrView, const VulkanFramebuffer& bloom)
 {
-  assert(ds);
-
-  VkWriteDescriptorSet writeInfo[2]{};
-
-  VkDescriptorImageInfo infoBinding0{};
-  infoBinding0.sampler = inputPicture0.sampler;
-  infoBinding0.imageView = inputPicture0.view;
-  infoBinding0.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-  // Binding 0: Input Picture 0
-  writeInfo[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeInfo[0].dstSet = ds;
-  writeInfo[0].dstBinding = 0;
-  writeInfo[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  writeInfo[0].pImageInfo = &infoBinding0;
-  writeInfo[0].descriptorCount = 1;
-
-  VkDescriptorImageInfo infoBinding1{};
-  infoBinding1.sampler = inputPicture1.sampler;
-  infoBinding1.imageView = inputPicture1.view;
-  infoBinding1.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-  // Binding 1: Input Picture 1
-  writeInfo[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeInfo[1].dstSet = ds;
-  writeInfo[1].dstBinding = 1;
-  writeInfo[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  writeInfo[1].pImageInfo = &infoBinding1;
-  writeInfo[1].descriptorCount = 1;
-
-  vkUpdateDescriptorSets(device, lengthof(writeInfo), writeInfo, 0, nullptr);
+  return {
+        imageDescriptor(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, hdrView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        imageDescriptor(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, bloom.view, bloom.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+  };
 }
 
 // Material (set=1)
 VkDescriptorSetLayout createMaterialDescriptorSetLayout(VkDevice device)
 {
-  // MaterialParams (binding=0)
+  // Material table (binding=0): the MaterialParams of all the materials
   VkDescriptorSetLayoutBinding materialParamsBinding{};
-  materialParamsBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  materialParamsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
   materialParamsBinding.binding = 0;
   materialParamsBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
   materialParamsBinding.descriptorCount = 1;
@@ -662,111 +1316,114 @@ VkDescriptorSetLayout createMaterialDescriptorSetLayout(VkDevice device)
 }
 
 // Material (set=1)
-void setupDescriptorSet_Material(VkDevice device, VkDescriptorSet ds, VkBuffer uniformBuffer)
+std::vector<DescriptorWrite> describeDescriptorSet_Material(VkBuffer materialBuffer)
 {
-  VkWriteDescriptorSet writeInfo[1]{};
+  return {bufferDescriptor(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, materialBuffer, VK_WHOLE_SIZE)};
+}
 
-  VkDescriptorBufferInfo bufferInfo{};
-  bufferInfo.buffer = uniformBuffer;
-  bufferInfo.range = sizeof(MaterialParams);
+// Prefers lazily allocated memory: on tile-based GPUs, transient attachments may then never get backing memory.
+uint32_t findTransientMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, bool& lazilyAllocated)
+{
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
 
-  // Binding 0: uniform buffer for MaterialParams
-  writeInfo[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeInfo[0].dstSet = ds;
-  writeInfo[0].dstBinding = 0;
-  writeInfo[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  writeInfo[0].pBufferInfo = &bufferInfo;
-  writeInfo[0].descriptorCount = 1;
+  for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+  {
+    if((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+    {
+      lazilyAllocated = true;
+      return i;
+    }
+  }
 
-  vkUpdateDescriptorSets(device, lengthof(writeInfo), writeInfo, 0, nullptr);
+  lazilyAllocated = false;
+  return findMemoryType(physicalDevice, typeFilter, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 }
 
-VulkanFramebuffer createShadowFramebuffer(VkDevice device, VkPhysicalDevice physicalDevice, int width, int height, VkRenderPass renderPass)
+// HDR color + depth, only living during the scene render pass (see 'createSubpassTonemapRenderPass').
+// The color is read as an input attachment: no sampler. The framebuffers are per swapchain image.
+VulkanFramebufferWithDepth createTransientColorTarget(
+      VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat format, bool& lazilyAllocated)
 {
-  VulkanFramebuffer result{};
+  VulkanFramebufferWithDepth result{};
 
-  // Create image for the depth buffer
+  struct Attachment
   {
-    VkImageCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    info.imageType = VK_IMAGE_TYPE_2D;
-    info.extent = {(uint32_t)width, (uint32_t)height, 1};
-    info.format = DepthFormat;
-    info.mipLevels = 1;
-    info.arrayLayers = 1;
-    info.samples = VK_SAMPLE_COUNT_1_BIT;
-    info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    vkCreateImage(device, &info, nullptr, &result.image);
-  }
-
-  // Allocate memory for the texture image
+    VkFormat format;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect;
+    VkImage& image;
+    VkDeviceMemory& memory;
+    VkImageView& view;
+  };
+
+  const Attachment attachments[] = {
+        {format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, result.image, result.memory,
+              result.view},
+        {DepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, result.depthImage, result.depthMemory, result.depthView},
+  };
+
+  lazilyAllocated = true;
+
+  for(auto& attachment : attachments)
   {
+    // Create image
+    {
+      VkImageCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      info.imageType = VK_IMAGE_TYPE_2D;
+      info.extent = {extent.width, extent.height, 1};
+      info.format = attachment.format;
+      info.mipLevels = 1;
+      info.arrayLayers = 1;
+      info.samples = VK_SAMPLE_COUNT_1_BIT;
+      info.tiling = VK_IMAGE_TILING_OPTIMAL;
+      info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      info.usage = attachment.usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+      if(vkCreateImage(device, &info, nullptr, &attachment.image) != VK_SUCCESS)
+        throw std::runtime_error("failed to create transient attachment");
+    }
+
+    // Allocate memory
     {
       VkMemoryRequirements memReqs;
-      vkGetImageMemoryRequirements(device, result.image, &memReqs);
+      vkGetImageMemoryRequirements(device, attachment.image, &memReqs);
+
+      bool lazy = false;
 
       VkMemoryAllocateInfo info{};
       info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
       info.allocationSize = memReqs.size;
-      info.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-      vkAllocateMemory(device, &info, nullptr, &result.memory);
-    }
-
-    vkBindImageMemory(device, result.image, result.memory, 0);
-  }
-
-  // Create image view
-  {
-    VkImageViewCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    info.format = DepthFormat;
-    info.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
-    info.subresourceRange.levelCount = 1;
-    info.image = result.image;
-    vkCreateImageView(device, &info, nullptr, &result.view);
-  }
+      info.memoryTypeIndex = findTransientMemoryType(physicalDevice, memReqs.memoryTypeBits, lazy);
+      vkAllocateMemory(device, &info, nullptr, &attachment.memory);
 
-  // Create sampler
-  {
-    VkSamplerCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    info.magFilter = VK_FILTER_NEAREST;
-    info.minFilter = VK_FILTER_NEAREST;
-    info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-    info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    info.mipLodBias = 0.0f;
-    info.maxAnisotropy = 1.0f;
-    info.minLod = 0.0f;
-    info.maxLod = 1.0f;
-    info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    vkCreateSampler(device, &info, nullptr, &result.sampler);
-  }
+      lazilyAllocated = lazilyAllocated && lazy;
+    }
 
-  // Create framebuffer
-  {
-    VkFramebufferCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    info.renderPass = renderPass;
-    info.attachmentCount = 1;
-    info.pAttachments = &result.view;
-    info.width = width;
-    info.height = height;
-    info.layers = 1;
+    vkBindImageMemory(device, attachment.image, attachment.memory, 0);
 
-    vkCreateFramebuffer(device, &info, nullptr, &result.framebuffer);
+    // Create image view
+    {
+      VkImageViewCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      info.format = attachment.format;
+      info.subresourceRange = {attachment.aspect, 0, 1, 0, 1};
+      info.image = attachment.image;
+      vkCreateImageView(device, &info, nullptr, &attachment.view);
+    }
   }
 
   return result;
 }
 
-VulkanFramebufferWithDepth createColorFramebuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkRenderPass renderPass)
+// 'extraUsage' e.g: VK_IMAGE_USAGE_STORAGE_BIT, only where needed, as it may disable framebuffer compression.
+// No framebuffer without 'renderPass' (e.g: the image is an attachment of a bigger framebuffer).
+VulkanFramebuffer createHdrFramebuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat format, VkRenderPass renderPass,
+      VkFilter filter = VK_FILTER_NEAREST, VkImageUsageFlags extraUsage = 0)
 {
-  VulkanFramebufferWithDepth result{};
+  VulkanFramebuffer result{};
 
   // Create image for the HDR buffer
   {
@@ -774,13 +1431,14 @@ VulkanFramebufferWithDepth createColorFramebuffer(VkDevice device, VkPhysicalDev
     info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     info.imageType = VK_IMAGE_TYPE_2D;
     info.extent = {extent.width, extent.height, 1};
-    info.format = HdrFormat;
+    info.format = format;
     info.mipLevels = 1;
     info.arrayLayers = 1;
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
     info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // transfer: image diff
+    info.usage |= extraUsage;
     vkCreateImage(device, &info, nullptr, &result.image);
   }
 
@@ -805,63 +1463,19 @@ VulkanFramebufferWithDepth createColorFramebuffer(VkDevice device, VkPhysicalDev
     VkImageViewCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    info.format = HdrFormat;
+    info.format = format;
     info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
     info.subresourceRange.levelCount = 1;
     info.image = result.image;
     vkCreateImageView(device, &info, nullptr, &result.view);
   }
 
-  // Create image for the depth buffer
-  {
-    VkImageCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    info.imageType = VK_IMAGE_TYPE_2D;
-    info.extent = {extent.width, extent.height, 1};
-    info.format = DepthFormat;
-    info.mipLevels = 1;
-    info.arrayLayers = 1;
-    info.samples = VK_SAMPLE_COUNT_1_BIT;
-    info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    vkCreateImage(device, &info, nullptr, &result.depthImage);
-  }
-
-  // Allocate memory for the texture image
-  {
-    {
-      VkMemoryRequirements memReqs;
-      vkGetImageMemoryRequirements(device, result.depthImage, &memReqs);
-
-      VkMemoryAllocateInfo info{};
-      info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      info.allocationSize = memReqs.size;
-      info.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-      vkAllocateMemory(device, &info, nullptr, &result.depthMemory);
-    }
-
-    vkBindImageMemory(device, result.depthImage, result.depthMemory, 0);
-  }
-
-  // Create image view
-  {
-    VkImageViewCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    info.format = DepthFormat;
-    info.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
-    info.subresourceRange.levelCount = 1;
-    info.image = result.depthImage;
-    vkCreateImageView(device, &info, nullptr, &result.depthView);
-  }
-
   // Create sampler
   {
     VkSamplerCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    info.magFilter = VK_FILTER_NEAREST;
-    info.minFilter = VK_FILTER_NEAREST;
+    info.magFilter = filter;
+    info.minFilter = filter;
     info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
@@ -875,13 +1489,13 @@ VulkanFramebufferWithDepth createColorFramebuffer(VkDevice device, VkPhysicalDev
   }
 
   // Create framebuffer
+  if(renderPass)
   {
-    VkImageView views[] = {result.view, result.depthView};
     VkFramebufferCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     info.renderPass = renderPass;
-    info.attachmentCount = lengthof(views);
-    info.pAttachments = views;
+    info.attachmentCount = 1;
+    info.pAttachments = &result.view;
     info.width = extent.width;
     info.height = extent.height;
     info.layers = 1;
@@ -893,281 +1507,554 @@ VulkanFramebufferWithDepth createColorFramebuffer(VkDevice device, VkPhysicalDev
   return result;
 }
 
-VulkanFramebuffer createHdrFramebuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkRenderPass renderPass)
+void destroyTexture(VkDevice device, const VulkanFramebuffer& texture)
 {
-  VulkanFramebuffer result{};
+  vkDestroyFramebuffer(device, texture.framebuffer, nullptr);
+  vkDestroyImageView(device, texture.view, nullptr);
+  vkDestroySampler(device, texture.sampler, nullptr);
+  vkDestroyImage(device, texture.image, nullptr);
+  vkFreeMemory(device, texture.memory, nullptr);
+}
 
-  // Create image for the HDR buffer
-  {
-    VkImageCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    info.imageType = VK_IMAGE_TYPE_2D;
-    info.extent = {extent.width, extent.height, 1};
-    info.format = HdrFormat;
-    info.mipLevels = 1;
-    info.arrayLayers = 1;
-    info.samples = VK_SAMPLE_COUNT_1_BIT;
-    info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    vkCreateImage(device, &info, nullptr, &result.image);
-  }
-
-  // Allocate memory for the texture image
-  {
-    {
-      VkMemoryRequirements memReqs;
-      vkGetImageMemoryRequirements(device, result.image, &memReqs);
-
-      VkMemoryAllocateInfo info{};
-      info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      info.allocationSize = memReqs.size;
-      info.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-      vkAllocateMemory(device, &info, nullptr, &result.memory);
-    }
-
-    vkBindImageMemory(device, result.image, result.memory, 0);
-  }
-
-  // Create image view
-  {
-    VkImageViewCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    info.format = HdrFormat;
-    info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-    info.subresourceRange.levelCount = 1;
-    info.image = result.image;
-    vkCreateImageView(device, &info, nullptr, &result.view);
-  }
-
-  // Create sampler
-  {
-    VkSamplerCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    info.magFilter = VK_FILTER_NEAREST;
-    info.minFilter = VK_FILTER_NEAREST;
-    info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-    info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    info.mipLodBias = 0.0f;
-    info.maxAnisotropy = 1.0f;
-    info.minLod = 0.0f;
-    info.maxLod = 1.0f;
-    info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-    vkCreateSampler(device, &info, nullptr, &result.sampler);
-  }
-
-  // Create framebuffer
-  {
-    VkFramebufferCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    info.renderPass = renderPass;
-    info.attachmentCount = 1;
-    info.pAttachments = &result.view;
-    info.width = extent.width;
-    info.height = extent.height;
-    info.layers = 1;
-
-    vkCreateFramebuffer(device, &info, nullptr, &result.framebuffer);
-    assert(result.framebuffer);
-  }
-
-  return result;
-}
-
-void destroyTexture(VkDevice device, const VulkanFramebuffer& texture)
-{
-  vkDestroyFramebuffer(device, texture.framebuffer, nullptr);
-  vkDestroyImageView(device, texture.view, nullptr);
-  vkDestroySampler(device, texture.sampler, nullptr);
-  vkDestroyImage(device, texture.image, nullptr);
-  vkFreeMemory(device, texture.memory, nullptr);
-}
-
-void destroyTexture(VkDevice device, const VulkanFramebufferWithDepth& texture)
-{
-  const VulkanFramebuffer& buf = texture;
-  destroyTexture(device, buf);
+void destroyTexture(VkDevice device, const VulkanFramebufferWithDepth& texture)
+{
+  const VulkanFramebuffer& buf = texture;
+  destroyTexture(device, buf);
 
   vkDestroyImageView(device, texture.depthView, nullptr);
   vkDestroyImage(device, texture.depthImage, nullptr);
   vkFreeMemory(device, texture.depthMemory, nullptr);
 }
 
-VkRenderPass createShadowMapRenderPass(VkDevice device)
-{
-  VkAttachmentDescription attachmentDescription{};
-  attachmentDescription.format = DepthFormat;
-  attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-  attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL; // shader read
-
-  // will be used as depth/stencil during render pass
-  VkAttachmentReference depthReference = {};
-  depthReference.attachment = 0;
-  depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass = {};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 0;
-  subpass.pDepthStencilAttachment = &depthReference;
-
-  VkRenderPassCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  info.attachmentCount = 1;
-  info.pAttachments = &attachmentDescription;
-  info.subpassCount = 1;
-  info.pSubpasses = &subpass;
-
-  VkRenderPass renderPass{};
-  vkCreateRenderPass(device, &info, nullptr, &renderPass);
-  return renderPass;
-}
-
-VkRenderPass createColorRenderPass(VkDevice device)
+// Scene and tone-mapping in a single render pass, for tile-based GPUs.
+// Subpass 0 matches the color pass of the frame graph with a bright-pass target, and uses the same pipelines.
+// Subpass 1 tone-maps the HDR color, read as an input attachment, to the swapchain image.
+// The HDR color and the depth are never stored: they can be transient, lazily allocated attachments.
+// Attachments: HDR color, depth, bright-pass, swapchain image.
+VkRenderPass createSubpassTonemapRenderPass(VkDevice device, VkFormat hdrFormat, VkFormat swapchainFormat)
 {
-  VkAttachmentDescription colorAttachment{};
-  colorAttachment.format = HdrFormat;
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-  VkAttachmentDescription depthAttachment{};
-  depthAttachment.format = DepthFormat;
-  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
-  // will be used as color during render pass
-  VkAttachmentReference colorReference = {};
-  colorReference.attachment = 0;
-  colorReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  // will be used as depth/stencil during render pass
-  VkAttachmentReference depthReference = {};
-  depthReference.attachment = 1;
-  depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass = {};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorReference;
-  subpass.pDepthStencilAttachment = &depthReference;
-
-  VkAttachmentDescription attachments[2] = {colorAttachment, depthAttachment};
+  VkAttachmentDescription attachments[4]{};
+
+  // HDR color
+  attachments[0].format = hdrFormat;
+  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  // depth
+  attachments[1].format = DepthFormat;
+  attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  // bright-pass: the bloom source, sampled after the render pass
+  attachments[2] = attachments[0];
+  attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  // swapchain image: fully overwritten by the tone-mapping
+  attachments[3].format = swapchainFormat;
+  attachments[3].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[3].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[3].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[3].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[3].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[3].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[3].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  const VkAttachmentReference sceneColorReferences[] = {
+        {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+        {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+  };
+  const VkAttachmentReference depthReference = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  const VkAttachmentReference hdrInputReference = {0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  const VkAttachmentReference swapchainReference = {3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpasses[2]{};
+
+  // scene
+  subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[0].colorAttachmentCount = lengthof(sceneColorReferences);
+  subpasses[0].pColorAttachments = sceneColorReferences;
+  subpasses[0].pDepthStencilAttachment = &depthReference;
+
+  // tone-mapping
+  subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[1].inputAttachmentCount = 1;
+  subpasses[1].pInputAttachments = &hdrInputReference;
+  subpasses[1].colorAttachmentCount = 1;
+  subpasses[1].pColorAttachments = &swapchainReference;
+
+  VkSubpassDependency dependencies[4]{};
+
+  // the bright-pass of the previous frame was sampled by the bloom prefilter
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // swapchain image acquisition (waited for at this stage), bloom written at the end of the previous frame
+  dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].dstSubpass = 1;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+  // the tone-mapping only reads the HDR color of its own pixel: by region, it stays on tile
+  dependencies[2].srcSubpass = 0;
+  dependencies[2].dstSubpass = 1;
+  dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+  dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  // the bright-pass gets sampled by the bloom prefilter
+  dependencies[3].srcSubpass = 0;
+  dependencies[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[3].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[3].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[3].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
   VkRenderPassCreateInfo info{};
   info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
   info.attachmentCount = lengthof(attachments);
   info.pAttachments = attachments;
-  info.subpassCount = 1;
-  info.pSubpasses = &subpass;
+  info.subpassCount = lengthof(subpasses);
+  info.pSubpasses = subpasses;
+  info.dependencyCount = lengthof(dependencies);
+  info.pDependencies = dependencies;
 
   VkRenderPass renderPass{};
-  vkCreateRenderPass(device, &info, nullptr, &renderPass);
+
+  if(vkCreateRenderPass(device, &info, nullptr, &renderPass) != VK_SUCCESS)
+    throw std::runtime_error("failed to create render pass");
+
   return renderPass;
 }
 
-VkRenderPass createPostprocRenderPass(VkDevice device)
+// Draws one frame of 'app' at time 0, from the initial camera of main.cpp, into an offscreen copy
+// of the swapchain image, and reads it back. The swapchain format has 4 bytes per pixel.
+std::vector<uint8_t> renderTonemappedFrame(const AppCreationContext& ctx, IApp& app)
 {
-  VkAttachmentDescription attachmentDescription{};
-  attachmentDescription.format = HdrFormat;
-  attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-  attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-  VkAttachmentReference colorReference = {};
-  colorReference.attachment = 0;
-  colorReference.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-  VkSubpassDescription subpass = {};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorReference;
+  const VkExtent2D extent = ctx.swapchainExtent;
+  const VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * 4;
 
-  VkRenderPassCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  info.attachmentCount = 1;
-  info.pAttachments = &attachmentDescription;
-  info.subpassCount = 1;
-  info.pSubpasses = &subpass;
+  const VulkanFramebuffer target = createHdrFramebuffer(ctx.device, ctx.physicalDevice, extent, ctx.swapchainFormat, ctx.renderPass);
 
-  VkRenderPass renderPass{};
-  vkCreateRenderPass(device, &info, nullptr, &renderPass);
-  return renderPass;
+  VkBuffer readbackBuffer;
+
+  {
+    VkBufferCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.size = size;
+    info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if(vkCreateBuffer(ctx.device, &info, nullptr, &readbackBuffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to create readback buffer");
+  }
+
+  const VkDeviceMemory readbackMemory = createBufferMemory(ctx.physicalDevice, ctx.device, readbackBuffer);
+
+  Camera camera;
+  camera.mat = lookAt({3, 3, 3}, {}, {0, 0, 1});
+  app.setCamera(camera);
+
+  ctx.immediate->execute([&](VkCommandBuffer commandBuffer) {
+    app.drawFrame(0.0, target.framebuffer, commandBuffer);
+
+    // the render pass of main.cpp leaves its target ready to present
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = target.image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(
+          commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+  });
+
+  std::vector<uint8_t> pixels(size);
+
+  void* data;
+  vkMapMemory(ctx.device, readbackMemory, 0, size, 0, &data);
+  memcpy(pixels.data(), data, size);
+  vkUnmapMemory(ctx.device, readbackMemory);
+
+  vkDestroyBuffer(ctx.device, readbackBuffer, nullptr);
+  vkFreeMemory(ctx.device, readbackMemory, nullptr);
+  destroyTexture(ctx.device, target);
+
+  return pixels;
 }
 
 class FullDemo : public IApp
 {
 public:
-  FullDemo(const AppCreationContext& ctx_)
-      : ctx(ctx_)
+  // 'forcedHdrFormatBits': overrides the 'hdrformat' option, for the reference of 'hdrdiff'
+  FullDemo(const AppCreationContext& ctx_, int forcedHdrFormatBits_ = 0)
+      : forcedHdrFormatBits(forcedHdrFormatBits_)
+      , descriptorAllocator(ctx_.device, DescriptorFrameSlots)
+      , frameGraph(ctx_.device, ctx_.physicalDevice)
+      , ctx(ctx_)
   {
-    shadowRenderPass = createShadowMapRenderPass(ctx.device);
-    colorRenderPass = createColorRenderPass(ctx.device);
-    postprocRenderPass = createPostprocRenderPass(ctx.device);
+    compactVertices = getOption("compact", 0);
+    depthPrepass = getOption("prepass", 0);
+    subpassTonemap = getOption("subpasstonemap", 0);
+    computeBloom = getOption("computebloom", 0);
+    bloomMipChain = getOption("bloomchain", computeBloom ? 0 : 1);
+    bloomDiff = getOption("bloomdiff", 0);
+    shadowCascadeCount = getOption("cascades", MaxShadowCascadeCount);
+    rotateScene = getOption("rotate", 1);
+    // with moving casters, the cache never hits: it would only cost a load and a clear per cascade
+    shadowCache = getOption("shadowcache", rotateScene ? 0 : 1);
+    shadowFilter = getOption("shadowfilter", ShadowFilterHardware);
+    shadowKernelSize = getOption("shadowkernel", 3);
+
+    if(shadowCascadeCount < 1 || shadowCascadeCount > MaxShadowCascadeCount)
+      throw std::runtime_error("'cascades' must be between 1 and 4");
+
+    if(shadowFilter < 0 || shadowFilter >= ShadowFilterCount)
+      throw std::runtime_error("'shadowfilter' must be 0 (hardware), 1 (rotated grid) or 2 (Poisson)");
+
+    if(shadowKernelSize < 1 || shadowKernelSize > MaxShadowKernelSize)
+      throw std::runtime_error("'shadowkernel' must be between 1 and 4");
+
+    // otherwise, each tap is a single compare
+    {
+      VkFormatProperties properties;
+      vkGetPhysicalDeviceFormatProperties(ctx.physicalDevice, DepthFormat, &properties);
+      shadowMapLinear = properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+      if(!shadowMapLinear)
+        fprintf(stderr, "Shadow map: no linear filtering for the depth format, the shadow lookups don't blend 2x2 texels\n");
+    }
+
+    {
+      const double cascadeMegabytes = double(ShadowCascadeSize) * ShadowCascadeSize * 2 / (1024.0 * 1024.0); // DepthFormat
+
+      fprintf(stderr, "Shadow map: %d cascades of %dx%d up to a view distance of %g, %.1f MB (one 4096x4096 map: 32.0 MB)\n", shadowCascadeCount,
+            ShadowCascadeSize, ShadowCascadeSize, ShadowDistance, shadowCascadeCount * cascadeMegabytes);
+    }
+
+    // only the fragment full resolution bloom has a threshold pass to remove
+    brightPassTarget = getOption("brightpass", 0) && !computeBloom && (!bloomMipChain || bloomDiff);
+
+    if(getOption("brightpass", 0) && !brightPassTarget && !subpassTonemap)
+      fprintf(stderr, "brightpass=1 is only used by the fragment full resolution bloom (bloomchain=0 or bloomdiff=1)\n");
+
+    // the HDR color never leaves the tile memory: the bloom is built from the bright-pass, with the mip chain
+    if(subpassTonemap)
+    {
+      if(computeBloom || !bloomMipChain || bloomDiff)
+        fprintf(stderr, "subpasstonemap=1 only supports the mip chain bloom: ignoring computebloom, bloomchain and bloomdiff\n");
+
+      computeBloom = false;
+      bloomMipChain = true;
+      bloomDiff = false;
+      brightPassTarget = true;
+    }
+
+    const int blurSigma = getOption("blursigma", 5); // in pixels, for 'bloomchain=0'
+
+    // The compute blur writes 'rgba32f' images, and the bloom image diff reads back floats
+    {
+      int hdrFormatBits = forcedHdrFormatBits ? forcedHdrFormatBits : getOption("hdrformat", 0);
+
+      if(computeBloom || bloomDiff)
+      {
+        if(hdrFormatBits != 0 && hdrFormatBits != 32)
+          fprintf(stderr, "hdrformat=%d isn't supported with computebloom=1 or bloomdiff=1: using hdrformat=32\n", hdrFormatBits);
+
+        hdrFormatBits = 32;
+      }
+
+      hdrFormatInfo = &selectHdrFormat(ctx.physicalDevice, hdrFormatBits);
+      hdrFormat = hdrFormatInfo->format;
+      hdrPixelSize = hdrFormatInfo->pixelSize;
+
+      fprintf(stderr, "HDR format: %d bits per channel, %d bytes/pixel\n", hdrFormatInfo->bits, hdrFormatInfo->pixelSize);
+    }
+
+    // Otherwise, the color pass gets its render pass from the frame graph, see 'addFrameGraphPasses'
+    if(subpassTonemap)
+      colorRenderPass = createSubpassTonemapRenderPass(ctx.device, hdrFormat, ctx.swapchainFormat);
 
     sceneDescriptorSetLayout = createSceneDescriptorSetLayout(ctx.device);
     materialDescriptorSetLayout = createMaterialDescriptorSetLayout(ctx.device);
     postprocDescriptorSetLayout = createPostprocDescriptorSetLayout(ctx.device);
 
-    perspectivePipelineLayout = createPipelineLayout(ctx.device, {sceneDescriptorSetLayout, materialDescriptorSetLayout});
+    // the fragment shader reads 'materialIndex'
+    const VkShaderStageFlags meshPushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    perspectivePipelineLayout = createPipelineLayout(
+          ctx.device, {sceneDescriptorSetLayout, materialDescriptorSetLayout}, {{meshPushConstantStages, 0, sizeof(MeshPushConstant)}});
 
     postprocPipelineLayout = createPipelineLayout(ctx.device, {postprocDescriptorSetLayout});
 
-    shadowMapPipeline = createShadowMapPipeline(ctx.device, perspectivePipelineLayout, shadowRenderPass);
-    colorPipeline = createColorPipeline(ctx.device, perspectivePipelineLayout, ctx.swapchainExtent, colorRenderPass);
+    if(subpassTonemap)
+    {
+      subpassTonemapDescriptorSetLayout = createSubpassTonemapDescriptorSetLayout(ctx.device);
+      subpassTonemapPipelineLayout = createPipelineLayout(ctx.device, {subpassTonemapDescriptorSetLayout});
+    }
+
+    if(computeBloom)
+    {
+      computeDescriptorSetLayout = createComputeDescriptorSetLayout(ctx.device);
+      computePipelineLayout =
+            createPipelineLayout(ctx.device, {computeDescriptorSetLayout}, {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputeBlurPushConstant)}});
+    }
+
+    {
+      VkPhysicalDeviceFeatures features{};
+      vkGetPhysicalDeviceFeatures(ctx.physicalDevice, &features);
+
+      if(features.pipelineStatisticsQuery)
+        statisticsQueryPool = createStatisticsQueryPool(ctx.device, QueryRingSize);
+      else
+        fprintf(stderr, "Pipeline statistics queries aren't supported: no overdraw stats\n");
+
+      VkPhysicalDeviceProperties properties{};
+      vkGetPhysicalDeviceProperties(ctx.physicalDevice, &properties);
+
+      if(properties.limits.timestampComputeAndGraphics)
+      {
+        timestampQueryPool = createTimestampQueryPool(ctx.device, QueryRingSize * TimestampCount);
+        timestampPeriod = properties.limits.timestampPeriod;
+      }
+      else
+      {
+        fprintf(stderr, "Timestamp queries aren't supported: no post-processing timings\n");
+      }
+    }
+
+    if(computeBloom)
+    {
+      const std::vector<float> weights = computeGaussianWeights((float)blurSigma);
+
+      computeBlurConstants.radius = (int)weights.size() - 1;
+
+      for(size_t i = 0; i < weights.size(); ++i)
+        computeBlurConstants.weights[i] = weights[i];
+
+      const std::vector<std::string> blurShaders = {"bin/src/fulldemo/bloomblur.comp.spv"};
+      createReloadablePipeline(computeHorzBlurPipeline, blurShaders,
+            [this]() { return createComputeBlurPipeline(ctx.device, computePipelineLayout, false, true); });
+      createReloadablePipeline(computeVertBlurPipeline, blurShaders,
+            [this]() { return createComputeBlurPipeline(ctx.device, computePipelineLayout, true, false); });
+
+      if(!bloomMipChain || bloomDiff)
+        fprintf(stderr, "Blur (compute, threshold fused): sigma %d px, radius %d px, %d shared memory reads per pass\n", blurSigma,
+              computeBlurConstants.radius, 2 * computeBlurConstants.radius + 1);
+    }
+
+    Specialization tonemapSpecialization;
+    tonemapSpecialization.set(0, TonemapGamma);
+
+    if(subpassTonemap)
+      createReloadablePostprocPipeline(tonemapPipeline, "bin/src/fulldemo/tonemapping_subpass.frag.spv", [=]() {
+        return createPostprocPipeline(ctx.device, subpassTonemapPipelineLayout, ctx.swapchainExtent, colorRenderPass,
+              "bin/src/fulldemo/tonemapping_subpass.frag.spv", false, false, 0, tonemapSpecialization.getInfo(), 1);
+      });
+    else
+      createReloadablePostprocPipeline(tonemapPipeline, "bin/src/fulldemo/tonemapping.frag.spv", [=]() {
+        return createPostprocPipeline(ctx.device, postprocPipelineLayout, ctx.swapchainExtent, ctx.renderPass, "bin/src/fulldemo/tonemapping.frag.spv",
+              false, false, 0, tonemapSpecialization.getInfo());
+      });
+
+    // The compute blur writes the full resolution bloom outside of the frame graph.
+    // Bilinear sampling: the blur kernel taps land between texels.
+    if(computeBloom && (!bloomMipChain || bloomDiff))
+    {
+      for(auto& buffer : externalBloomBuffer)
+        buffer = createHdrFramebuffer(
+              ctx.device, ctx.physicalDevice, ctx.swapchainExtent, hdrFormat, VK_NULL_HANDLE, VK_FILTER_LINEAR, VK_IMAGE_USAGE_STORAGE_BIT);
+
+      bloomBuffer[0] = externalBloomBuffer[0];
+      bloomBuffer[1] = externalBloomBuffer[1];
+    }
+
+    if(subpassTonemap)
+    {
+      bool lazilyAllocated = false;
+      hdrBuffer = createTransientColorTarget(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, hdrFormat, lazilyAllocated);
+      brightPassBuffer = createHdrFramebuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, hdrFormat, VK_NULL_HANDLE);
+
+      for(auto swapchainView : ctx.swapchainImageViews)
+      {
+        VkImageView views[] = {hdrBuffer.view, hdrBuffer.depthView, brightPassBuffer.view, swapchainView};
+        VkFramebufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        info.renderPass = colorRenderPass;
+        info.attachmentCount = lengthof(views);
+        info.pAttachments = views;
+        info.width = ctx.swapchainExtent.width;
+        info.height = ctx.swapchainExtent.height;
+        info.layers = 1;
+
+        VkFramebuffer framebuffer{};
+
+        if(vkCreateFramebuffer(ctx.device, &info, nullptr, &framebuffer) != VK_SUCCESS)
+          throw std::runtime_error("failed to create framebuffer");
+
+        subpassFramebuffers.push_back(framebuffer);
+      }
+
+      // full resolution attachment traffic, per pixel: everything that goes through the external memory
+      const int hdrPixelBytes = hdrPixelSize;
+      const int depthPixelBytes = 2; // DepthFormat
+      const int swapchainPixelBytes = 4;
+      const int separateBytes = hdrPixelBytes + depthPixelBytes + 2 * hdrPixelBytes + swapchainPixelBytes; // write, tone-mapping + prefilter reads
+      const int subpassBytes = hdrPixelBytes + hdrPixelBytes + swapchainPixelBytes; // bright-pass write + prefilter read
+
+      fprintf(stderr, "Subpass tone-mapping: %d bytes/pixel of attachment traffic (separate pass: %d), HDR color and depth: %s\n", subpassBytes,
+            separateBytes, lazilyAllocated ? "lazily allocated" : "transient, without lazily allocated memory");
+    }
+
+    buildFrameGraph(blurSigma);
 
-    thresholdPipeline =
-          createPostprocPipeline(ctx.device, postprocPipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/fulldemo/threshold.frag.spv");
-    horzBlurPipeline =
-          createPostprocPipeline(ctx.device, postprocPipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/fulldemo/horzblur.frag.spv");
-    vertBlurPipeline =
-          createPostprocPipeline(ctx.device, postprocPipelineLayout, ctx.swapchainExtent, postprocRenderPass, "bin/src/fulldemo/vertblur.frag.spv");
-    tonemapPipeline = createPostprocPipeline(ctx.device, postprocPipelineLayout, ctx.swapchainExtent, ctx.renderPass, "bin/src/fulldemo/tonemapping.frag.spv");
+    // after all the pipelines are created: 'reloadablePipelines' is then read by the watcher thread
+    if(getOption("hotreload", 0))
+      shaderWatcher.reset(new ShaderWatcher("src/fulldemo", [this](const std::string& spvPath) { rebuildPipelines(spvPath); }));
 
-    hdrBuffer = createColorFramebuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, colorRenderPass);
-    bloomBuffer[0] = createHdrFramebuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, postprocRenderPass);
-    bloomBuffer[1] = createHdrFramebuffer(ctx.device, ctx.physicalDevice, ctx.swapchainExtent, postprocRenderPass);
+    {
+      // pixels written by each path, per frame: the reads scale the same way
+      const double fullResPixels = double(ctx.swapchainExtent.width) * ctx.swapchainExtent.height;
+      double mipChainPixels = 0;
+
+      for(int i = 0; i < BloomMipCount; ++i)
+      {
+        const VkExtent2D extent = getBloomMipExtent(i);
+        const double pixels = double(extent.width) * extent.height;
+        mipChainPixels += i == BloomMipCount - 1 ? pixels : 2 * pixels; // down + up, except the last level
+      }
 
-    shadowMap = createShadowFramebuffer(ctx.device, ctx.physicalDevice, ShadowMapSize, ShadowMapSize, shadowRenderPass);
+      const char* path = bloomMipChain ? "mip chain" : computeBloom ? "full resolution blur, compute" : "full resolution blur";
+
+      fprintf(stderr, "Bloom: %s, %.1f MB written per frame (full resolution blur: %.1f MB)\n", path,
+            mipChainPixels * hdrPixelSize / 1e6, 3 * fullResPixels * hdrPixelSize / 1e6);
+    }
 
     auto scene = loadObj("data/scifi-01.obj");
 
-    descriptorPool = createDescriptorPool(ctx.device);
+    size_t totalVertexBytes = 0;
+    size_t totalPositionBytes = 0;
+    std::vector<int> lodTriangles(LodCount); // all the meshes, by level
+    float maxLodError = 0;
 
     for(auto& plainMesh : scene.plainMeshes)
     {
-      auto& vertices = plainMesh.vertices;
+      if(plainMesh.vertices.empty())
+        continue;
 
-      // Create the vertex buffer and send it to the GPU
       vulkanMeshes.push_back({});
       VulkanMesh& vulkanMesh = vulkanMeshes.back();
       vulkanMesh.material = plainMesh.material;
-      vulkanMesh.vertexCount = vertices.size();
-      vulkanMesh.vertexBuffer = createVertexBuffer(ctx.device, vertices.size() * sizeof(vertices[0]));
-      vulkanMesh.vertexMemory = createBufferMemory(ctx.physicalDevice, ctx.device, vulkanMesh.vertexBuffer);
-      writeToGpuMemory(ctx.device, vulkanMesh.vertexMemory, vertices.data(), vertices.size() * sizeof(vertices[0]));
+      computeBoundingSphere(plainMesh.vertices, vulkanMesh.center, vulkanMesh.radius);
+
+      // Concatenate all the LODs into one vertex buffer
+      std::vector<Vertex> vertices;
+
+      for(auto& lod : buildLods(plainMesh, LodCount))
+      {
+        VulkanMesh::Lod vulkanLod;
+        vulkanLod.firstVertex = vertices.size();
+        vulkanLod.vertexCount = lod.vertices.size();
+        vulkanLod.error = lod.error;
+        vulkanMesh.lods.push_back(vulkanLod);
+
+        vertices.insert(vertices.end(), lod.vertices.begin(), lod.vertices.end());
+
+        lodTriangles[vulkanMesh.lods.size() - 1] += vulkanLod.vertexCount / 3;
+        maxLodError = std::max(maxLodError, vulkanLod.error);
+      }
+
+      if(compactVertices)
+      {
+        vulkanMesh.box = computeQuantizationBox(vertices);
+        const auto compressed = compressVertices(vertices, vulkanMesh.box);
+
+        const auto error = measureQuantizationError(vertices, compressed, vulkanMesh.box);
+        fprintf(stderr, "Mesh %d, quantization error: position=%g (bound=%g), normal=%.4f deg\n", (int)vulkanMeshes.size() - 1, error.position,
+              error.positionBound, error.normalDegrees);
+
+        // allow for float rounding on top of the half quantization step
+        if(error.position > error.positionBound * 1.01f || error.normalDegrees > MaxNormalQuantizationErrorDegrees)
+          throw std::runtime_error("vertex quantization error is out of bounds");
+
+        uploadMeshBuffer(compressed.data(), compressed.size() * sizeof(compressed[0]), vulkanMesh.vertexBuffer, vulkanMesh.vertexMemory);
+        totalVertexBytes += compressed.size() * sizeof(compressed[0]);
+
+        std::vector<CompactPositionVertex> positions;
+        positions.reserve(compressed.size());
+
+        for(auto& v : compressed)
+          positions.push_back({v.x, v.y, v.z, 0});
+
+        uploadMeshBuffer(positions.data(), positions.size() * sizeof(positions[0]), vulkanMesh.positionBuffer, vulkanMesh.positionMemory);
+        totalPositionBytes += positions.size() * sizeof(positions[0]);
+      }
+      else
+      {
+        uploadMeshBuffer(vertices.data(), vertices.size() * sizeof(vertices[0]), vulkanMesh.vertexBuffer, vulkanMesh.vertexMemory);
+        totalVertexBytes += vertices.size() * sizeof(vertices[0]);
+
+        std::vector<PositionVertex> positions;
+        positions.reserve(vertices.size());
+
+        for(auto& v : vertices)
+          positions.push_back({v.x, v.y, v.z});
+
+        uploadMeshBuffer(positions.data(), positions.size() * sizeof(positions[0]), vulkanMesh.positionBuffer, vulkanMesh.positionMemory);
+        totalPositionBytes += positions.size() * sizeof(positions[0]);
+
+        // identity box: the depth shader reads the float positions as-is
+        for(int i = 0; i < 3; ++i)
+        {
+          vulkanMesh.box.boxMin[i] = 0;
+          vulkanMesh.box.boxSize[i] = 1;
+        }
+      }
     }
 
+    std::string trianglesPerLod;
+
+    for(int i = 0; i < LodCount; ++i)
+      trianglesPerLod += (i ? ", LOD" : "LOD") + std::to_string(i) + "=" + std::to_string(lodTriangles[i]);
+
+    fprintf(stderr, "Mesh LODs: %d meshes, %d LODs each, triangles %s, max error=%.3f\n", (int)vulkanMeshes.size(), LodCount, trianglesPerLod.c_str(),
+          maxLodError);
+
+    fprintf(stderr, "Vertex data: %d KB (%s vertices), position-only stream: %d KB\n", int(totalVertexBytes / 1024), compactVertices ? "compact" : "float",
+          int(totalPositionBytes / 1024));
+
     {
       VkBufferCreateInfo info{};
       info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1181,6 +2068,8 @@ public:
       uniformBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, uniformBuffer);
     }
 
+    // one per cascade: their passes are recorded in the same command buffer
+    for(int i = 0; i < shadowCascadeCount; ++i)
     {
       VkBufferCreateInfo info{};
       info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1188,275 +2077,590 @@ public:
       info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
       info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-      if(vkCreateBuffer(ctx.device, &info, nullptr, &shadowMapUniformBuffer) != VK_SUCCESS)
+      if(vkCreateBuffer(ctx.device, &info, nullptr, &shadowMapUniformBuffer[i]) != VK_SUCCESS)
         throw std::runtime_error("failed to create uniform buffer");
 
-      shadowMapUniformBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, shadowMapUniformBuffer);
+      shadowMapUniformBufferMemory[i] = createBufferMemory(ctx.physicalDevice, ctx.device, shadowMapUniformBuffer[i]);
     }
 
     // fill descriptor set for main scene
-    mainSceneDescriptorSet = createDescriptorSet(ctx.device, descriptorPool, sceneDescriptorSetLayout);
-    setupDescriptorSet_MainScene(ctx.device, mainSceneDescriptorSet, uniformBuffer, shadowMap);
+    mainSceneDescriptorSet = descriptorAllocator.getSet(sceneDescriptorSetLayout, describeDescriptorSet_MainScene(uniformBuffer, shadowMap));
+
+    // fill descriptor sets for the shadow cascades
+    for(int i = 0; i < shadowCascadeCount; ++i)
+      shadowMapDescriptorSet[i] = descriptorAllocator.getSet(sceneDescriptorSetLayout, describeDescriptorSet_ShadowMapScene(shadowMapUniformBuffer[i]));
 
-    // fill descriptor set for shadowmap scene
-    shadowMapDescriptorSet = createDescriptorSet(ctx.device, descriptorPool, sceneDescriptorSetLayout);
-    setupDescriptorSet_ShadowMapScene(ctx.device, shadowMapDescriptorSet, shadowMapUniformBuffer);
+    // fill descriptor sets for postproc pipelines, the same pictures give the same set
+    // (the prefilter of the mip chain also reads hdrBuffer from there, or the bright-pass with 'subpasstonemap')
+    const VulkanFramebuffer& prefilterInput = subpassTonemap ? brightPassBuffer : hdrBuffer;
+    const VulkanFramebuffer& prefilterBloom = !subpassTonemap && bloomBuffer[0].image ? bloomBuffer[0] : bloomMips[0];
+    postprocDescriptorSet_Hdr_And_Bloom0 =
+          descriptorAllocator.getSet(postprocDescriptorSetLayout, describeDescriptorSet_InputPicture(prefilterInput, prefilterBloom));
 
-    // fill descriptor sets for postproc pipelines
-    postprocDescriptorSet_Hdr_And_Bloom0 = createDescriptorSet(ctx.device, descriptorPool, postprocDescriptorSetLayout);
-    setupDescriptorSet_InputPicture(ctx.device, postprocDescriptorSet_Hdr_And_Bloom0, hdrBuffer, bloomBuffer[0]);
+    if(bloomBuffer[0].image)
+      postprocDescriptorSet_Bloom0_And_Bloom1 =
+            descriptorAllocator.getSet(postprocDescriptorSetLayout, describeDescriptorSet_InputPicture(bloomBuffer[0], bloomBuffer[1]));
 
-    postprocDescriptorSet_Bloom0_And_Bloom1 = createDescriptorSet(ctx.device, descriptorPool, postprocDescriptorSetLayout);
-    setupDescriptorSet_InputPicture(ctx.device, postprocDescriptorSet_Bloom0_And_Bloom1, bloomBuffer[0], bloomBuffer[1]);
+    for(int i = 0; i < BloomMipCount; ++i)
+      bloomMipDescriptorSet[i] = descriptorAllocator.getSet(postprocDescriptorSetLayout, describeDescriptorSet_InputPicture(bloomMips[i], bloomMips[i]));
 
-    for(auto& material : scene.materials)
+    if(computeBloom && bloomBuffer[0].image)
     {
-      vulkanMaterials.push_back({});
-      auto& vulkanMaterial = vulkanMaterials.back();
+      // horizontal: hdrBuffer -> bloomBuffer[1], vertical: bloomBuffer[1] -> bloomBuffer[0]
+      computeDescriptorSet[0] = descriptorAllocator.getSet(computeDescriptorSetLayout, describeDescriptorSet_Compute(hdrBuffer, bloomBuffer[1]));
 
+      computeDescriptorSet[1] = descriptorAllocator.getSet(computeDescriptorSetLayout, describeDescriptorSet_Compute(bloomBuffer[1], bloomBuffer[0]));
+    }
+
+    if(bloomDiff)
+    {
+      const VkExtent2D half = getBloomMipExtent(0);
+      const size_t sizes[] = {
+            ctx.swapchainExtent.width * ctx.swapchainExtent.height * 4 * sizeof(float),
+            half.width * half.height * 4 * sizeof(float),
+      };
+
+      for(int i = 0; i < 2; ++i)
       {
         VkBufferCreateInfo info{};
         info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        info.size = sizeof(MaterialParams);
-        info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        info.size = sizes[i];
+        info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
         info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-        if(vkCreateBuffer(ctx.device, &info, nullptr, &vulkanMaterial.uniformBuffer) != VK_SUCCESS)
-          throw std::runtime_error("failed to create uniform buffer");
+        if(vkCreateBuffer(ctx.device, &info, nullptr, &bloomReadback[i].buffer) != VK_SUCCESS)
+          throw std::runtime_error("failed to create readback buffer");
 
-        vulkanMaterial.memory = createBufferMemory(ctx.physicalDevice, ctx.device, vulkanMaterial.uniformBuffer);
+        bloomReadback[i].memory = createBufferMemory(ctx.physicalDevice, ctx.device, bloomReadback[i].buffer);
       }
+    }
+
+    // Material table: one storage buffer for all the materials, bound once.
+    // The draws select their entry with 'MeshPushConstant::materialIndex'.
+    {
+      std::vector<MaterialParams> table(std::max<size_t>(scene.materials.size(), 1));
 
+      for(size_t i = 0; i < scene.materials.size(); ++i)
       {
-        MaterialParams params{};
+        auto& material = scene.materials[i];
+        auto& params = table[i];
         params.diffuse.x = material.diffuse.r;
         params.diffuse.y = material.diffuse.g;
         params.diffuse.z = material.diffuse.b;
         params.emissive.x = material.emissive.r;
         params.emissive.y = material.emissive.g;
         params.emissive.z = material.emissive.b;
-
-        writeToGpuMemory(ctx.device, vulkanMaterial.memory, &params, sizeof params);
       }
 
-      vulkanMaterial.descriptorSet = createDescriptorSet(ctx.device, descriptorPool, materialDescriptorSetLayout);
-      setupDescriptorSet_Material(ctx.device, vulkanMaterial.descriptorSet, vulkanMaterial.uniformBuffer);
+      VkBufferCreateInfo info{};
+      info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      info.size = table.size() * sizeof(MaterialParams);
+      info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+      info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+      if(vkCreateBuffer(ctx.device, &info, nullptr, &materialBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to create material buffer");
+
+      materialMemory = createBufferMemory(ctx.physicalDevice, ctx.device, materialBuffer);
+      writeToGpuMemory(ctx.device, materialMemory, table.data(), info.size);
+
+      materialDescriptorSet = descriptorAllocator.getSet(materialDescriptorSetLayout, describeDescriptorSet_Material(materialBuffer));
     }
+
+    // the reference doesn't compare itself
+    if(getOption("hdrdiff", 0) && !forcedHdrFormatBits)
+      compareHdrFormatWithReference();
   }
 
   ~FullDemo()
   {
-    destroyTexture(ctx.device, shadowMap);
-    destroyTexture(ctx.device, hdrBuffer);
-    destroyTexture(ctx.device, bloomBuffer[0]);
-    destroyTexture(ctx.device, bloomBuffer[1]);
+    // at exit: includes the transient sets of all the frames
+    descriptorAllocator.printSummary();
+
+    // stops the watcher thread first: it may be creating pipelines
+    shaderWatcher.reset();
+
+    for(auto& reloaded : reloadedPipelines)
+      vkDestroyPipeline(ctx.device, reloaded.pipeline, nullptr);
+
+    // otherwise, images of 'frameGraph'
+    if(subpassTonemap)
+    {
+      destroyTexture(ctx.device, hdrBuffer);
+      destroyTexture(ctx.device, brightPassBuffer);
+    }
+
+    destroyTexture(ctx.device, externalBloomBuffer[0]);
+    destroyTexture(ctx.device, externalBloomBuffer[1]);
+
+    for(auto framebuffer : subpassFramebuffers)
+      vkDestroyFramebuffer(ctx.device, framebuffer, nullptr);
+
+    for(auto& readback : bloomReadback)
+    {
+      vkDestroyBuffer(ctx.device, readback.buffer, nullptr);
+      vkFreeMemory(ctx.device, readback.memory, nullptr);
+    }
+
+    for(int i = 0; i < MaxShadowCascadeCount; ++i)
+    {
+      vkDestroyBuffer(ctx.device, shadowMapUniformBuffer[i], nullptr);
+      vkFreeMemory(ctx.device, shadowMapUniformBufferMemory[i], nullptr);
+    }
 
-    vkDestroyBuffer(ctx.device, shadowMapUniformBuffer, nullptr);
     vkDestroyBuffer(ctx.device, uniformBuffer, nullptr);
-    vkFreeMemory(ctx.device, shadowMapUniformBufferMemory, nullptr);
     vkFreeMemory(ctx.device, uniformBufferMemory, nullptr);
 
     for(auto& mesh : vulkanMeshes)
     {
       vkDestroyBuffer(ctx.device, mesh.vertexBuffer, nullptr);
       vkFreeMemory(ctx.device, mesh.vertexMemory, nullptr);
+      vkDestroyBuffer(ctx.device, mesh.positionBuffer, nullptr);
+      vkFreeMemory(ctx.device, mesh.positionMemory, nullptr);
     }
 
-    for(auto& vulkanMaterial : vulkanMaterials)
-    {
-      vkDestroyBuffer(ctx.device, vulkanMaterial.uniformBuffer, nullptr);
-      vkFreeMemory(ctx.device, vulkanMaterial.memory, nullptr);
-    }
+    vkDestroyBuffer(ctx.device, materialBuffer, nullptr);
+    vkFreeMemory(ctx.device, materialMemory, nullptr);
 
     vkDestroyPipeline(ctx.device, shadowMapPipeline, nullptr);
     vkDestroyPipeline(ctx.device, colorPipeline, nullptr);
+    vkDestroyPipeline(ctx.device, depthPrepassPipeline, nullptr);
     vkDestroyPipeline(ctx.device, thresholdPipeline, nullptr);
     vkDestroyPipeline(ctx.device, horzBlurPipeline, nullptr);
     vkDestroyPipeline(ctx.device, vertBlurPipeline, nullptr);
+    vkDestroyPipeline(ctx.device, bloomPrefilterPipeline, nullptr);
+    vkDestroyPipeline(ctx.device, bloomDownsamplePipeline, nullptr);
+    vkDestroyPipeline(ctx.device, bloomUpsamplePipeline, nullptr);
     vkDestroyPipeline(ctx.device, tonemapPipeline, nullptr);
+    vkDestroyPipeline(ctx.device, computeHorzBlurPipeline, nullptr);
+    vkDestroyPipeline(ctx.device, computeVertBlurPipeline, nullptr);
 
     vkDestroyPipelineLayout(ctx.device, perspectivePipelineLayout, nullptr);
     vkDestroyPipelineLayout(ctx.device, postprocPipelineLayout, nullptr);
+    vkDestroyPipelineLayout(ctx.device, computePipelineLayout, nullptr);
+    vkDestroyPipelineLayout(ctx.device, subpassTonemapPipelineLayout, nullptr);
 
-    vkDestroyRenderPass(ctx.device, shadowRenderPass, nullptr);
     vkDestroyRenderPass(ctx.device, colorRenderPass, nullptr);
-    vkDestroyRenderPass(ctx.device, postprocRenderPass, nullptr);
 
     vkDestroyDescriptorSetLayout(ctx.device, sceneDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(ctx.device, materialDescriptorSetLayout, nullptr);
     vkDestroyDescriptorSetLayout(ctx.device, postprocDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, computeDescriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, subpassTonemapDescriptorSetLayout, nullptr);
 
-    vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
+    vkDestroyQueryPool(ctx.device, statisticsQueryPool, nullptr);
+    vkDestroyQueryPool(ctx.device, timestampQueryPool, nullptr);
   }
 
   Camera m_camera;
 
   void setCamera(const Camera& camera) override { m_camera = camera; }
 
-  void drawShadowMap(VkCommandBuffer commandBuffer, VkFramebuffer target, const Matrix4f& model, const Matrix4f& lightView, const Matrix4f& lightProj)
+  // Creates a host-visible vertex buffer and sends 'data' to the GPU
+  void uploadMeshBuffer(const void* data, size_t size, VkBuffer& buffer, VkDeviceMemory& memory)
   {
-    VkClearValue clearDepth{};
-    clearDepth.depthStencil = {1.0, 0};
-
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = shadowRenderPass;
-    renderPassInfo.framebuffer = target;
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = {ShadowMapSize, ShadowMapSize};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearDepth;
-
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    buffer = createVertexBuffer(ctx.device, size);
+    memory = createBufferMemory(ctx.physicalDevice, ctx.device, buffer);
+    writeToGpuMemory(ctx.device, memory, data, size);
+  }
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowMapPipeline);
+  void pushMeshConstants(VkCommandBuffer commandBuffer, const VulkanMesh& mesh, const Matrix4f& model)
+  {
+    MeshPushConstant constants{};
+    constants.model = packAffine(model);
+    constants.boxMin = {mesh.box.boxMin[0], mesh.box.boxMin[1], mesh.box.boxMin[2], 0};
+    constants.boxSize = {mesh.box.boxSize[0], mesh.box.boxSize[1], mesh.box.boxSize[2], 0};
+    constants.materialIndex = mesh.material;
 
-    for(auto& mesh : vulkanMeshes)
-    {
-      VkBuffer vertexBuffers[] = {mesh.vertexBuffer};
-      VkDeviceSize offsets[] = {0};
-      vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdPushConstants(commandBuffer, perspectivePipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+  }
 
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perspectivePipelineLayout, 0, 1, &shadowMapDescriptorSet, 0, nullptr);
+  // What's currently bound on the command buffer, to skip redundant binds.
+  // All the scene pipelines share 'perspectivePipelineLayout', so descriptor sets
+  // stay bound across pipeline changes.
+  struct BindState
+  {
+    VkPipeline pipeline{};
+    VkBuffer vertexBuffer{};
+    VkDescriptorSet descriptorSets[2]{};
+  };
 
-      MyUniformBlock constants{};
-      constants.model = model;
-      constants.view = lightView;
-      constants.proj = lightProj;
+  void bindPipeline(VkCommandBuffer commandBuffer, BindState& state, VkPipeline pipeline)
+  {
+    if(state.pipeline == pipeline)
+      return;
 
-      // convert row-major (app) to column-major (GLSL)
-      constants.model = transpose(constants.model);
-      constants.view = transpose(constants.view);
-      constants.proj = transpose(constants.proj);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    state.pipeline = pipeline;
+    stats.pipelineBinds++;
+  }
 
-      writeToGpuMemory(ctx.device, shadowMapUniformBufferMemory, &constants, sizeof constants);
+  void bindVertexBuffer(VkCommandBuffer commandBuffer, BindState& state, VkBuffer buffer)
+  {
+    if(state.vertexBuffer == buffer)
+      return;
+
+    VkBuffer vertexBuffers[] = {buffer};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    state.vertexBuffer = buffer;
+    stats.vertexBufferBinds++;
+  }
 
-      vkCmdDraw(commandBuffer, mesh.vertexCount, 1, 0, 0);
-    }
+  void bindDescriptorSet(VkCommandBuffer commandBuffer, BindState& state, int index, VkDescriptorSet descriptorSet)
+  {
+    if(state.descriptorSets[index] == descriptorSet)
+      return;
 
-    vkCmdEndRenderPass(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perspectivePipelineLayout, index, 1, &descriptorSet, 0, nullptr);
+    state.descriptorSets[index] = descriptorSet;
+    stats.descriptorSetBinds++;
   }
 
-  void drawMainScene(VkCommandBuffer commandBuffer, VkFramebuffer target, const Matrix4f& model, const Matrix4f& mvpLight)
+  // In the render pass of a shadow cascade: only the meshes which can cast a shadow in it.
+  // With 'shadowcache', the render pass keeps the previous content: nothing to draw if the cascade,
+  // and the transform of the casters, didn't change since then.
+  // All the meshes share the scene transform: they're either all static, or all moving.
+  void drawShadowCascade(VkCommandBuffer commandBuffer, int index)
   {
-    VkClearValue clearValues[2]{};
-    clearValues[0].color.float32[0] = 0.1f;
-    clearValues[0].color.float32[1] = 0.1f;
-    clearValues[0].color.float32[2] = 0.1f;
-    clearValues[0].color.float32[3] = 1.0f;
-    clearValues[1].depthStencil.depth = 1;
-    clearValues[1].depthStencil.stencil = 0;
-
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = colorRenderPass;
-    renderPassInfo.framebuffer = target;
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = ctx.swapchainExtent;
-    renderPassInfo.clearValueCount = lengthof(clearValues);
-    renderPassInfo.pClearValues = clearValues;
-
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+    const ShadowCascade& cascade = shadowCascades[index];
+    const Matrix4f modelLightView = cascade.view * frameModel;
 
-    for(auto& mesh : vulkanMeshes)
+    if(shadowCache)
     {
-      VkBuffer vertexBuffers[] = {mesh.vertexBuffer};
-      VkDeviceSize offsets[] = {0};
-      vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+      auto& entry = shadowCacheEntries[index];
+      const Matrix4f transform = cascade.proj * modelLightView;
 
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perspectivePipelineLayout, 0, 1, &mainSceneDescriptorSet, 0, nullptr);
+      if(entry.valid && std::memcmp(&entry.transform, &transform, sizeof transform) == 0)
+        return;
 
-      vkCmdBindDescriptorSets(
-            commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perspectivePipelineLayout, 1, 1, &vulkanMaterials[mesh.material].descriptorSet, 0, nullptr);
+      entry.valid = true;
+      entry.transform = transform;
 
-      MyUniformBlock constants{};
-      constants.model = model;
-      constants.view = m_camera.mat;
-      constants.proj = perspective(1.5, 4.0 / 3.0, 0.1, 100);
-      constants.LightMVP = mvpLight;
-
-      // convert row-major (app) to column-major (GLSL)
-      constants.model = transpose(constants.model);
-      constants.view = transpose(constants.view);
-      constants.proj = transpose(constants.proj);
-      constants.LightMVP = transpose(constants.LightMVP);
+      VkClearAttachment clear{};
+      clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+      clear.clearValue.depthStencil = {1.0, 0};
 
-      writeToGpuMemory(ctx.device, uniformBufferMemory, &constants, sizeof constants);
+      VkClearRect rect{};
+      rect.rect.extent = {ShadowCascadeSize, ShadowCascadeSize};
+      rect.layerCount = 1;
 
-      vkCmdDraw(commandBuffer, mesh.vertexCount, 1, 0, 0);
+      vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &rect);
     }
 
-    vkCmdEndRenderPass(commandBuffer);
-  }
+    stats.shadowCascadeRenders++;
 
-  void drawFrame(double time, VkFramebuffer swapchainFramebuffer, VkCommandBuffer commandBuffer) override
-  {
-    const float angle = time * 1.2;
-    const Matrix4f model = rotateZ(angle * 0.3);
+    // orthographic: the same LOD scale for all the meshes
+    const float texelsPerUnit = ShadowCascadeSize / (2 * cascade.radius);
 
-    const Matrix4f lightView = lookAt({6, 2, 7}, {}, {0, 0, 1});
-    const Matrix4f lightProj = perspective(1.5, 1, 1, 100);
-    const Matrix4f mvpLight = lightProj * lightView * model;
+    {
+      MyUniformBlock constants{};
+      constants.view = transpose(cascade.view);
+      constants.proj = transpose(cascade.proj);
 
-    drawShadowMap(commandBuffer, shadowMap.framebuffer, model, lightView, lightProj);
-    drawMainScene(commandBuffer, hdrBuffer.framebuffer, model, mvpLight);
+      writeToGpuMemory(ctx.device, shadowMapUniformBufferMemory[index], &constants, sizeof constants);
+    }
 
-    // threshold render pass: read from hdrBuffer, write to bloomBuffer[0]
-    {
-      VkRenderPassBeginInfo renderPassInfo{};
-      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      renderPassInfo.renderPass = postprocRenderPass;
-      renderPassInfo.framebuffer = bloomBuffer[0].framebuffer;
-      renderPassInfo.renderArea.extent = ctx.swapchainExtent;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowMapPipeline);
+    vkCmdBindDescriptorSets(
+          commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, perspectivePipelineLayout, 0, 1, &shadowMapDescriptorSet[index], 0, nullptr);
 
-      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, thresholdPipeline);
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postprocPipelineLayout, 0, 1, &postprocDescriptorSet_Hdr_And_Bloom0, 0, nullptr);
+    for(auto& mesh : vulkanMeshes)
+    {
+      if(!isShadowCaster(cascade, mesh, modelLightView))
+        continue;
+
+      VkBuffer vertexBuffers[] = {mesh.positionBuffer};
+      VkDeviceSize offsets[] = {0};
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+      // the depth shader always dequantizes (identity box for float positions)
+      pushMeshConstants(commandBuffer, mesh, frameModel);
+
+      auto& lod = mesh.lods[selectLodAtScale(mesh, texelsPerUnit, ShadowLodMaxPixelError)];
+      vkCmdDraw(commandBuffer, lod.vertexCount, 1, lod.firstVertex, 0);
+      stats.shadowDrawCalls++;
+    }
+  }
+
+  // The color pass of the frame graph.
+  // The statistics query must begin and end in the same subpass: here, inside the render pass.
+  void drawColorPass(VkCommandBuffer commandBuffer)
+  {
+    writeTimestamp(commandBuffer, TimestampShadowEnd);
+
+    if(statisticsQueryPool)
+      vkCmdBeginQuery(commandBuffer, statisticsQueryPool, querySlot, 0);
+
+    drawMainScene(commandBuffer, frameModel);
+
+    if(statisticsQueryPool)
+      vkCmdEndQuery(commandBuffer, statisticsQueryPool, querySlot);
+
+    // post-processing timing: from the end of the color pass (after its draws), to the end of the tone-mapping
+    writeTimestamp(commandBuffer, TimestampColorEnd);
+  }
+
+  // In the color render pass: the one of the frame graph, or the one of 'subpasstonemap'
+  void drawMainScene(VkCommandBuffer commandBuffer, const Matrix4f& model)
+  {
+    const Matrix4f proj = perspective(CameraFovy, CameraAspect, CameraNear, CameraFar);
+
+    {
+      MyUniformBlock constants{};
+      constants.view = m_camera.mat;
+      constants.proj = proj;
+
+      // unused cascades: never selected, the last split is the end of the shadows
+      for(int i = 0; i < MaxShadowCascadeCount; ++i)
+      {
+        const ShadowCascade& cascade = shadowCascades[std::min(i, shadowCascadeCount - 1)];
+        constants.cascadeViewProj[i] = transpose(cascade.proj * cascade.view);
+        constants.cascadeSplits[i] = cascade.splitDistance;
+      }
+
+      // convert row-major (app) to column-major (GLSL)
+      constants.view = transpose(constants.view);
+      constants.proj = transpose(constants.proj);
+
+      writeToGpuMemory(ctx.device, uniformBufferMemory, &constants, sizeof constants);
+    }
+
+    const Matrix4f modelView = m_camera.mat * model;
+
+    // Pipeline ids, in recording order: the depth prepass must be complete before shading
+    enum
+    {
+      DepthPrepassPipelineId,
+      ColorPipelineId,
+    };
+
+    renderQueue.clear();
+
+    for(int i = 0; i < (int)vulkanMeshes.size(); ++i)
+    {
+      auto& mesh = vulkanMeshes[i];
+      const float depth = computeSortDepth(mesh, modelView);
+
+      if(depthPrepass)
+        renderQueue.push(makeSortKey(DepthPrepassPipelineId, depth, 0), i);
+
+      renderQueue.push(makeSortKey(ColorPipelineId, depth, mesh.material), i);
+    }
+
+    renderQueue.sort();
+
+    BindState state{};
+
+    for(auto& item : renderQueue.getItems())
+    {
+      auto& mesh = vulkanMeshes[item.mesh];
+
+      // The prepass uses the same LODs as the color pass, so the depths match exactly
+      auto& lod = mesh.lods[selectLod(mesh, modelView, proj, ctx.swapchainExtent.height, LodMaxPixelError)];
+
+      if(getSortKeyPipeline(item.key) == DepthPrepassPipelineId)
+      {
+        bindPipeline(commandBuffer, state, depthPrepassPipeline);
+        bindVertexBuffer(commandBuffer, state, mesh.positionBuffer);
+        bindDescriptorSet(commandBuffer, state, 0, mainSceneDescriptorSet);
+      }
+      else
+      {
+        bindPipeline(commandBuffer, state, colorPipeline);
+        bindVertexBuffer(commandBuffer, state, mesh.vertexBuffer);
+        bindDescriptorSet(commandBuffer, state, 0, mainSceneDescriptorSet);
+        bindDescriptorSet(commandBuffer, state, 1, materialDescriptorSet); // the material table: bound once
+      }
+
+      pushMeshConstants(commandBuffer, mesh, model);
+
+      vkCmdDraw(commandBuffer, lod.vertexCount, 1, lod.firstVertex, 0);
+      stats.drawCalls++;
+    }
+
+    // Tone-mapping subpass: read the HDR color from the tile memory + the bloom of the previous frame
+    if(subpassTonemap)
+    {
+      vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, tonemapPipeline);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, subpassTonemapPipelineLayout, 0, 1, &tonemapDescriptorSet, 0, nullptr);
 
       vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-      vkCmdEndRenderPass(commandBuffer);
     }
+  }
+
+  void writeTimestamp(VkCommandBuffer commandBuffer, Timestamp timestamp, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+  {
+    if(timestampQueryPool)
+      vkCmdWriteTimestamp(commandBuffer, stage, timestampQueryPool, querySlot * TimestampCount + timestamp);
+  }
 
-    for(int k = 0; k < 4; ++k)
+  // Reads back the statistics of the frame which last used 'querySlot', if they're ready.
+  // Called before the slot gets reset for the current frame.
+  void collectStatistics()
+  {
+    if(frameCount < QueryRingSize)
+      return;
+
+    const auto flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+    if(statisticsQueryPool)
     {
-      // Horz blur render pass: read from bloomBuffer[0], write to bloomBuffer[1]
+      uint64_t result[2]{}; // fragment shader invocations, availability
+
+      const VkResult status = vkGetQueryPoolResults(ctx.device, statisticsQueryPool, querySlot, 1, sizeof result, result, sizeof result, flags);
+
+      if(status == VK_SUCCESS && result[1])
       {
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = postprocRenderPass;
-        renderPassInfo.framebuffer = bloomBuffer[1].framebuffer;
-        renderPassInfo.renderArea.extent = ctx.swapchainExtent;
-
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, horzBlurPipeline);
-        vkCmdBindDescriptorSets(
-              commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postprocPipelineLayout, 0, 1, &postprocDescriptorSet_Bloom0_And_Bloom1, 0, nullptr);
-
-        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-        vkCmdEndRenderPass(commandBuffer);
+        stats.fragmentInvocations += result[0];
+        stats.frameCount++;
       }
+    }
+
+    if(timestampQueryPool)
+    {
+      uint64_t result[TimestampCount][2]{}; // (timestamp, availability), see 'Timestamp'
+
+      const VkResult status = vkGetQueryPoolResults(ctx.device, timestampQueryPool, querySlot * TimestampCount, TimestampCount, sizeof result, result,
+            sizeof result[0], flags);
+
+      bool available = status == VK_SUCCESS;
+
+      for(auto& timestamp : result)
+        available = available && timestamp[1];
 
-      // Vert blur render pass: read from bloomBuffer[1], write to bloomBuffer[0]
+      if(available)
       {
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = postprocRenderPass;
-        renderPassInfo.framebuffer = bloomBuffer[0].framebuffer;
-        renderPassInfo.renderArea.extent = ctx.swapchainExtent;
-
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vertBlurPipeline);
-        vkCmdBindDescriptorSets(
-              commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postprocPipelineLayout, 0, 1, &postprocDescriptorSet_Bloom0_And_Bloom1, 0, nullptr);
-
-        vkCmdDraw(commandBuffer, 6, 1, 0, 0);
-        vkCmdEndRenderPass(commandBuffer);
+        stats.shadowTicks += result[TimestampShadowEnd][0] - result[TimestampFrameStart][0];
+        stats.colorTicks += result[TimestampColorEnd][0] - result[TimestampShadowEnd][0];
+        stats.postprocTicks += result[TimestampFrameEnd][0] - result[TimestampColorEnd][0];
+        stats.timedFrameCount++;
       }
     }
+  }
+
+  void reportStatistics()
+  {
+    if(stats.frameCount > 0)
+    {
+      const double pixelCount = double(ctx.swapchainExtent.width) * ctx.swapchainExtent.height;
+      const double invocations = double(stats.fragmentInvocations) / stats.frameCount;
+
+      fprintf(stderr, "Color pass: %.0f fragment invocations/frame, %.2f per pixel (depth prepass: %s)%s\n", invocations, invocations / pixelCount,
+            depthPrepass ? "on" : "off", subpassTonemap ? ", including the tone-mapping subpass" : "");
+    }
 
-    // Tone-mapping render pass: read from hdrBuffer + bloomBuffer[0], write to the swapchain framebuffer
+    if(stats.timedFrameCount > 0)
+    {
+      const double shadowMilliseconds = stats.shadowTicks * timestampPeriod / 1e6 / stats.timedFrameCount;
+      fprintf(stderr, "Shadow cascades: %.3f ms/frame (cache: %s, scene: %s)\n", shadowMilliseconds, shadowCache ? "on" : "off",
+            rotateScene ? "rotating" : "static");
+
+      const double colorMilliseconds = stats.colorTicks * timestampPeriod / 1e6 / stats.timedFrameCount;
+      fprintf(stderr, "Color pass: %.3f ms/frame (shadow filter: %s)%s\n", colorMilliseconds, describeShadowFilter().c_str(),
+            subpassTonemap ? ", including the tone-mapping subpass" : "");
+
+      const double milliseconds = stats.postprocTicks * timestampPeriod / 1e6 / stats.timedFrameCount;
+      const char* path = bloomMipChain ? "mip chain" : computeBloom ? "full resolution, compute" : "full resolution, fragment";
+
+      if(subpassTonemap)
+        fprintf(stderr, "Post-processing (bloom: %s, for the next frame): %.3f ms/frame (tonemapping: in the color pass)\n", path, milliseconds);
+      else
+        fprintf(stderr, "Post-processing (bloom: %s, tonemapping): %.3f ms/frame%s\n", path, milliseconds, bloomDiff ? " (both bloom paths)" : "");
+    }
+
+    if(stats.recordedFrameCount > 0)
+    {
+      const double n = stats.recordedFrameCount;
+      fprintf(stderr, "Color pass, per frame: %.1f draws, %.1f pipeline binds, %.1f vertex buffer binds, %.1f descriptor set binds\n", stats.drawCalls / n,
+            stats.pipelineBinds / n, stats.vertexBufferBinds / n, stats.descriptorSetBinds / n);
+      fprintf(stderr, "Shadow cascades, per frame: %.2f of %d rendered, %.1f draws (%d without culling)\n", stats.shadowCascadeRenders / n,
+            shadowCascadeCount, stats.shadowDrawCalls / n, shadowCascadeCount * (int)vulkanMeshes.size());
+    }
+
+    stats = {};
+  }
+
+  std::string describeShadowFilter() const
+  {
+    const int size = shadowKernelSize;
+
+    switch(shadowFilter)
+    {
+    case ShadowFilterRotatedGrid:
+      return "rotated grid, " + std::to_string(size) + "x" + std::to_string(size) + " taps";
+    case ShadowFilterPoisson:
+      return "Poisson disk, " + std::to_string(size * size) + " taps";
+    default:
+      return "hardware, 1 tap";
+    }
+  }
+
+  void drawFrame(double time, VkFramebuffer swapchainFramebuffer, VkCommandBuffer commandBuffer) override
+  {
+    if(shaderWatcher)
+      replaceReloadedPipelines();
+
+    const float angle = rotateScene ? time * 1.2 : 0;
+    const Matrix4f model = rotateZ(angle * 0.3);
+
+    // read by the passes of the frame graph
+    frameModel = model;
+    frameSwapchainFramebuffer = swapchainFramebuffer;
+    computeShadowCascades(shadowCascades, shadowCascadeCount, m_camera.mat, frameModel, vulkanMeshes);
+
+    querySlot = frameCount % QueryRingSize;
+    collectStatistics();
+
+    if(statisticsQueryPool)
+      vkCmdResetQueryPool(commandBuffer, statisticsQueryPool, querySlot, 1);
+
+    if(timestampQueryPool)
+      vkCmdResetQueryPool(commandBuffer, timestampQueryPool, querySlot * TimestampCount, TimestampCount);
+
+    writeTimestamp(commandBuffer, TimestampFrameStart, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+    if(frameCount > 0 && frameCount % StatsReportPeriod == 0)
+      reportStatistics();
+
+    // The tone-mapping set is transient: written each frame, in the slot of a frame the GPU is done with
+    descriptorAllocator.beginFrame(frameCount);
+
+    if(subpassTonemap)
+      tonemapDescriptorSet =
+            descriptorAllocator.allocateTransient(subpassTonemapDescriptorSetLayout, describeDescriptorSet_SubpassTonemap(hdrBuffer.view, bloomMips[0]));
+    else
+      tonemapDescriptorSet = descriptorAllocator.allocateTransient(
+            postprocDescriptorSetLayout, describeDescriptorSet_InputPicture(hdrBuffer, bloomMipChain ? bloomMips[0] : bloomBuffer[0]));
+
+    ++frameCount;
+    stats.recordedFrameCount++;
+
+    if(!historyInitialized)
+    {
+      initializeHistoryImages(commandBuffer);
+      historyInitialized = true;
+    }
+
+    // Shadow cascades, then scene + tone-mapping in one render pass, then the bloom for the next frame
+    if(subpassTonemap)
+    {
+      frameGraph.execute(commandBuffer);
+      writeTimestamp(commandBuffer, TimestampFrameEnd);
+
+      return;
+    }
+
+    // shadow cascades, color pass, bloom
+    frameGraph.execute(commandBuffer);
+
+    // the compute blur isn't part of the graph: it reads the HDR color once the graph is done
+    if(computeBloom && (!bloomMipChain || bloomDiff))
+      drawBloomCompute(commandBuffer);
+
+    // Tone-mapping render pass: read from hdrBuffer + bloom, write to the swapchain framebuffer
     {
       VkClearValue clearColor{};
 
@@ -1471,49 +2675,867 @@ public:
       vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
       vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, tonemapPipeline);
-      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postprocPipelineLayout, 0, 1, &postprocDescriptorSet_Hdr_And_Bloom0, 0, nullptr);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postprocPipelineLayout, 0, 1, &tonemapDescriptorSet, 0, nullptr);
 
       vkCmdDraw(commandBuffer, 6, 1, 0, 0);
 
       vkCmdEndRenderPass(commandBuffer);
     }
+
+    writeTimestamp(commandBuffer, TimestampFrameEnd);
+
+    if(bloomDiff)
+    {
+      // the copy recorded 'QueryRingSize' frames ago is complete by now
+      if(bloomReadbackFrame >= 0 && frameCount - bloomReadbackFrame >= QueryRingSize)
+      {
+        compareBloomImages();
+        bloomReadbackFrame = -1;
+      }
+
+      if(bloomReadbackFrame < 0 && frameCount % StatsReportPeriod == 1)
+      {
+        recordBloomReadback(commandBuffer);
+        bloomReadbackFrame = frameCount;
+      }
+    }
+  }
+
+  // The color pass with 'subpasstonemap': an external pass of the frame graph, as it also renders to the swapchain image.
+  // The statistics query covers both subpasses: it can't be inside the render pass.
+  void drawSubpassColorPass(VkCommandBuffer commandBuffer)
+  {
+    writeTimestamp(commandBuffer, TimestampShadowEnd);
+
+    if(statisticsQueryPool)
+      vkCmdBeginQuery(commandBuffer, statisticsQueryPool, querySlot, 0);
+
+    {
+      VkClearValue clearValues[4]{}; // [2]: bright-pass (below the threshold). [3]: swapchain image, not cleared
+      clearValues[0].color.float32[0] = 0.1f;
+      clearValues[0].color.float32[1] = 0.1f;
+      clearValues[0].color.float32[2] = 0.1f;
+      clearValues[0].color.float32[3] = 1.0f;
+      clearValues[1].depthStencil.depth = 1;
+      clearValues[1].depthStencil.stencil = 0;
+
+      VkRenderPassBeginInfo renderPassInfo{};
+      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      renderPassInfo.renderPass = colorRenderPass;
+      renderPassInfo.framebuffer = getSubpassFramebuffer(frameSwapchainFramebuffer);
+      renderPassInfo.renderArea.offset = {0, 0};
+      renderPassInfo.renderArea.extent = ctx.swapchainExtent;
+      renderPassInfo.clearValueCount = lengthof(clearValues);
+      renderPassInfo.pClearValues = clearValues;
+
+      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+      drawMainScene(commandBuffer, frameModel);
+      vkCmdEndRenderPass(commandBuffer);
+    }
+
+    if(statisticsQueryPool)
+      vkCmdEndQuery(commandBuffer, statisticsQueryPool, querySlot);
+
+    writeTimestamp(commandBuffer, TimestampColorEnd);
+  }
+
+  // The framebuffer of 'createSubpassTonemapRenderPass' targeting the same swapchain image
+  VkFramebuffer getSubpassFramebuffer(VkFramebuffer swapchainFramebuffer) const
+  {
+    for(size_t i = 0; i < ctx.swapchainFramebuffers.size(); ++i)
+    {
+      if(ctx.swapchainFramebuffers[i] == swapchainFramebuffer)
+        return subpassFramebuffers[i];
+    }
+
+    throw std::runtime_error("unknown swapchain framebuffer");
+  }
+
+  // Before the first frame: the history images of the frame graph are expected in their read layout
+  void initializeHistoryImages(VkCommandBuffer commandBuffer)
+  {
+    if(subpassTonemap)
+      clearBloomHistory(commandBuffer);
+
+    // no need to clear the content: the first frame renders all the cascades
+    if(shadowCache)
+    {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = shadowMap.image;
+      barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, (uint32_t)shadowCascadeCount};
+
+      vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+  }
+
+  // With 'subpasstonemap', the first frame samples bloomMips[0] before anything was written to it
+  void clearBloomHistory(VkCommandBuffer commandBuffer)
+  {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = bloomMips[0].image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkClearColorValue black{};
+    vkCmdClearColorImage(commandBuffer, bloomMips[0].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &barrier.subresourceRange);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+  }
+
+  // Same as the full resolution passes of 'buildFrameGraph', with compute shaders: the threshold is fused into the horizontal blur,
+  // each blur loads its input once per workgroup into shared memory.
+  void drawBloomCompute(VkCommandBuffer commandBuffer)
+  {
+    auto makeBarrier = [](VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = srcAccess;
+      barrier.dstAccessMask = dstAccess;
+      barrier.oldLayout = oldLayout;
+      barrier.newLayout = newLayout;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image;
+      barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+      return barrier;
+    };
+
+    const uint32_t width = ctx.swapchainExtent.width;
+    const uint32_t height = ctx.swapchainExtent.height;
+
+    // hdrBuffer: written by the color pass (already in its read-only layout).
+    // bloomBuffer[0..1]: last read during the previous frame, their content is discarded.
+    {
+      const VkImageMemoryBarrier barriers[] = {
+            makeBarrier(hdrBuffer.image, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+            makeBarrier(bloomBuffer[1].image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL),
+            makeBarrier(bloomBuffer[0].image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL),
+      };
+
+      const VkPipelineStageFlags srcStages =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+      vkCmdPipelineBarrier(
+            commandBuffer, srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, lengthof(barriers), barriers);
+    }
+
+    vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(computeBlurConstants), &computeBlurConstants);
+
+    // threshold + horz blur: read from hdrBuffer, write to bloomBuffer[1]
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeHorzBlurPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSet[0], 0, nullptr);
+    vkCmdDispatch(commandBuffer, (width + ComputeBlurTileSize - 1) / ComputeBlurTileSize, height, 1);
+
+    {
+      const VkImageMemoryBarrier barrier = makeBarrier(bloomBuffer[1].image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+      vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+            &barrier);
+    }
+
+    // vert blur: read from bloomBuffer[1], write to bloomBuffer[0]
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeVertBlurPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSet[1], 0, nullptr);
+    vkCmdDispatch(commandBuffer, (height + ComputeBlurTileSize - 1) / ComputeBlurTileSize, width, 1);
+
+    // bloomBuffer[0] gets sampled by the tone-mapping pass
+    {
+      const VkImageMemoryBarrier barrier = makeBarrier(bloomBuffer[0].image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+      vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+            &barrier);
+    }
+  }
+
+  // The passes of the frame, except the compute blur, and the tone-mapping to the swapchain image.
+  // With 'subpasstonemap', the color pass is external: it begins its own render pass, with the tone-mapping subpass.
+  // The frame graph derives their render passes, their barriers, and the memory of their images:
+  // e.g: the bloom images reuse the memory of the shadow cascades and of the depth buffer.
+  FrameImages addFrameGraphPasses(FrameGraph& graph, VkExtent2D extent)
+  {
+    const bool fullResPasses = !computeBloom && (!bloomMipChain || bloomDiff);
+    const bool mipChainPasses = bloomMipChain || bloomDiff;
+    const VkImageUsageFlags readbackUsage = bloomDiff ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0;
+
+    FrameImages images;
+
+    VkClearValue clearDepth{};
+    clearDepth.depthStencil = {1.0, 0};
+
+    // Cached: kept from one frame to the next, and cleared by 'drawShadowCascade' when it renders again
+    images.shadowMap = graph.createImageArray(
+          "shadow cascades", {ShadowCascadeSize, ShadowCascadeSize}, shadowCascadeCount, DepthFormat, shadowMapLinear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+    graph.setSamplerCompare(images.shadowMap, VK_COMPARE_OP_LESS_OR_EQUAL); // lit: in front of the casters
+    const FrameGraphLoad shadowLoad = shadowCache ? FrameGraphLoad::Keep : FrameGraphLoad::Clear;
+
+    for(int i = 0; i < shadowCascadeCount; ++i)
+      graph.addPass({"shadow cascade " + std::to_string(i), {}, {{images.shadowMap, shadowLoad, clearDepth, (uint32_t)i}}, {},
+            [this, i](VkCommandBuffer commandBuffer) { drawShadowCascade(commandBuffer, i); }});
+
+    if(shadowCache)
+      graph.markHistory(images.shadowMap);
+
+    // bilinear sampling: the downsample/upsample filters rely on it
+    if(mipChainPasses)
+    {
+      for(int i = 0; i < BloomMipCount; ++i)
+      {
+        const VkImageUsageFlags usage = i == 0 ? readbackUsage | (subpassTonemap ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0) : 0;
+        const std::string name = "bloom mip " + std::to_string(i);
+        images.bloomMips[i] = graph.createImage(name.c_str(), computeBloomMipExtent(extent, i), hdrFormat, VK_FILTER_LINEAR, usage);
+      }
+    }
+
+    if(subpassTonemap)
+    {
+      // the transient HDR color and depth never leave the render pass: only the bright-pass is known to the graph
+      images.hdr = graph.importImage("bright-pass", extent, hdrFormat, brightPassBuffer.image, brightPassBuffer.view, brightPassBuffer.sampler);
+
+      // the tone-mapping subpass reads the bloom of the previous frame
+      FrameGraphPassDesc colorPass{"color", {{images.hdr}}, {}, {images.shadowMap, images.bloomMips[0]},
+            [this](VkCommandBuffer commandBuffer) { drawSubpassColorPass(commandBuffer); }};
+      colorPass.external = true;
+      graph.addPass(colorPass);
+    }
+    else
+    {
+      images.hdr = graph.createImage("hdr", extent, hdrFormat);
+      images.depth = graph.createImage("depth", extent, DepthFormat);
+
+      VkClearValue clearColor{};
+      clearColor.color = {{0.1f, 0.1f, 0.1f, 1.0f}};
+
+      std::vector<FrameGraphWrite> colorWrites = {{images.hdr, FrameGraphLoad::Clear, clearColor}};
+
+      // the color pass writes the bright-pass straight into the full resolution bloom (cleared: below the threshold)
+      if(brightPassTarget)
+      {
+        images.bloom[0] = graph.createImage("bloom 0", extent, hdrFormat, VK_FILTER_LINEAR, readbackUsage);
+        colorWrites.push_back({images.bloom[0], FrameGraphLoad::Clear});
+      }
+
+      graph.addPass({"color", colorWrites, {{images.depth, FrameGraphLoad::Clear, clearDepth}}, {images.shadowMap},
+            [this](VkCommandBuffer commandBuffer) { drawColorPass(commandBuffer); }});
+
+      // sampled by the tone-mapping (and the compute blur)
+      graph.markOutput(images.hdr);
+    }
+
+    // Reference bloom: threshold, then one separable Gaussian blur, all at full resolution.
+    // The whole radius is covered by a single kernel: no need to iterate the blur.
+    if(fullResPasses)
+    {
+      // bilinear sampling: the blur kernel taps land between texels
+      if(!brightPassTarget)
+        images.bloom[0] = graph.createImage("bloom 0", extent, hdrFormat, VK_FILTER_LINEAR, readbackUsage);
+
+      images.bloom[1] = graph.createImage("bloom 1", extent, hdrFormat, VK_FILTER_LINEAR);
+
+      // unless the color pass already wrote the bright-pass to bloom 0
+      if(!brightPassTarget)
+        graph.addPass({"threshold", {{images.bloom[0]}}, {}, {images.hdr},
+              [this](VkCommandBuffer commandBuffer) { drawPostprocPass(commandBuffer, thresholdPipeline, postprocDescriptorSet_Hdr_And_Bloom0); }});
+
+      graph.addPass({"horizontal blur", {{images.bloom[1]}}, {}, {images.bloom[0]},
+            [this](VkCommandBuffer commandBuffer) { drawPostprocPass(commandBuffer, horzBlurPipeline, postprocDescriptorSet_Bloom0_And_Bloom1); }});
+
+      graph.addPass({"vertical blur", {{images.bloom[0]}}, {}, {images.bloom[1]},
+            [this](VkCommandBuffer commandBuffer) { drawPostprocPass(commandBuffer, vertBlurPipeline, postprocDescriptorSet_Bloom0_And_Bloom1); }});
+
+      graph.markOutput(images.bloom[0]);
+    }
+
+    // Bloom mip chain, from half resolution: threshold + 2x2 downsample, 13-tap downsamples,
+    // then tent upsamples blended back up to mip 0.
+    // With 'subpasstonemap', mip 0 is read before being written (by the tone-mapping of the next frame),
+    // and gets cleared once. As a history image, no other image shares its memory.
+    if(mipChainPasses)
+    {
+      auto& mips = images.bloomMips;
+
+      graph.addPass({"bloom prefilter", {{mips[0]}}, {}, {images.hdr},
+            [this](VkCommandBuffer commandBuffer) { drawBloomPass(commandBuffer, 0, bloomPrefilterPipeline, postprocDescriptorSet_Hdr_And_Bloom0); }});
+
+      for(int i = 1; i < BloomMipCount; ++i)
+        graph.addPass({"bloom downsample " + std::to_string(i), {{mips[i]}}, {}, {mips[i - 1]},
+              [this, i](VkCommandBuffer commandBuffer) { drawBloomPass(commandBuffer, i, bloomDownsamplePipeline, bloomMipDescriptorSet[i - 1]); }});
+
+      // blends over the downsampled content
+      for(int i = BloomMipCount - 2; i >= 0; --i)
+        graph.addPass({"bloom upsample " + std::to_string(i), {{mips[i], FrameGraphLoad::Keep}}, {}, {mips[i + 1]},
+              [this, i](VkCommandBuffer commandBuffer) { drawBloomPass(commandBuffer, i, bloomUpsamplePipeline, bloomMipDescriptorSet[i + 1]); }});
+
+      if(subpassTonemap)
+        graph.markHistory(mips[0]);
+      else
+        graph.markOutput(mips[0]);
+    }
+
+    return images;
+  }
+
+  // Compiles the frame graph, then creates the pipelines of its passes
+  void buildFrameGraph(int blurSigma)
+  {
+    const bool fullResPasses = !computeBloom && (!bloomMipChain || bloomDiff);
+    const bool mipChainPasses = bloomMipChain || bloomDiff;
+    const VkExtent2D extent = ctx.swapchainExtent;
+
+    const FrameImages images = addFrameGraphPasses(frameGraph, extent);
+    frameGraph.compile();
+    frameGraph.printSummary();
+
+    // the same graph at 4K, for comparison: only its memory layout
+    {
+      FrameGraph graph(ctx.device, ctx.physicalDevice);
+      addFrameGraphPasses(graph, {3840, 2160});
+      graph.computeMemoryLayout();
+
+      const double megabyte = 1024.0 * 1024.0;
+      fprintf(stderr, "Render targets: %.1f MB aliased, %.1f MB with one allocation per image. At 3840x2160: %.1f MB aliased, %.1f MB\n",
+            frameGraph.getMemorySize() / megabyte, frameGraph.getUnaliasedMemorySize() / megabyte, graph.getMemorySize() / megabyte,
+            graph.getUnaliasedMemorySize() / megabyte);
+    }
+
+    auto getTexture = [&](FrameGraphImage image) {
+      VulkanFramebuffer result{};
+      result.image = frameGraph.getImage(image);
+      result.view = frameGraph.getView(image);
+      result.sampler = frameGraph.getSampler(image);
+      return result;
+    };
+
+    shadowMap = getTexture(images.shadowMap);
+
+    // all the cascades have compatible render passes
+    if(subpassTonemap)
+    {
+      createScenePipelines(frameGraph.getRenderPass("shadow cascade 0"), colorRenderPass);
+    }
+    else
+    {
+      static_cast<VulkanFramebuffer&>(hdrBuffer) = getTexture(images.hdr);
+      createScenePipelines(frameGraph.getRenderPass("shadow cascade 0"), frameGraph.getRenderPass("color"));
+    }
+
+    Specialization thresholdSpecialization;
+    thresholdSpecialization.set(0, BloomThreshold);
+
+    if(fullResPasses)
+    {
+      bloomBuffer[0] = getTexture(images.bloom[0]);
+      bloomBuffer[1] = getTexture(images.bloom[1]);
+
+      if(!brightPassTarget)
+      {
+        const VkRenderPass renderPass = frameGraph.getRenderPass("threshold");
+        createReloadablePostprocPipeline(thresholdPipeline, "bin/src/fulldemo/threshold.frag.spv", [=]() {
+          return createPostprocPipeline(ctx.device, postprocPipelineLayout, extent, renderPass, "bin/src/fulldemo/threshold.frag.spv", false, false, 0,
+                thresholdSpecialization.getInfo());
+        });
+      }
+
+      const BlurKernel kernel = computeBlurKernel((float)blurSigma);
+      const VkRenderPass horzRenderPass = frameGraph.getRenderPass("horizontal blur");
+      const VkRenderPass vertRenderPass = frameGraph.getRenderPass("vertical blur");
+      createReloadablePostprocPipeline(horzBlurPipeline, "bin/src/fulldemo/blur.frag.spv", [=]() {
+        return createBlurPipeline(ctx.device, postprocPipelineLayout, extent, horzRenderPass, kernel, false);
+      });
+      createReloadablePostprocPipeline(vertBlurPipeline, "bin/src/fulldemo/blur.frag.spv", [=]() {
+        return createBlurPipeline(ctx.device, postprocPipelineLayout, extent, vertRenderPass, kernel, true);
+      });
+
+      fprintf(stderr, "Blur: sigma %d px, radius %d px, %d fetches per pass (%d without linear sampling)\n", blurSigma, kernel.radius,
+            2 * kernel.tapCount - 1, 2 * kernel.radius + 1);
+    }
+
+    // all the passes of the chain have compatible render passes
+    if(mipChainPasses)
+    {
+      for(int i = 0; i < BloomMipCount; ++i)
+        bloomMips[i] = getTexture(images.bloomMips[i]);
+
+      Specialization upsampleSpecialization;
+      upsampleSpecialization.set(0, BloomUpsampleRadius);
+
+      const VkRenderPass prefilterRenderPass = frameGraph.getRenderPass("bloom prefilter");
+      const VkRenderPass downsampleRenderPass = frameGraph.getRenderPass("bloom downsample 1");
+      const VkRenderPass upsampleRenderPass = frameGraph.getRenderPass("bloom upsample 0");
+
+      createReloadablePostprocPipeline(bloomPrefilterPipeline, "bin/src/fulldemo/bloomprefilter.frag.spv", [=]() {
+        return createPostprocPipeline(ctx.device, postprocPipelineLayout, extent, prefilterRenderPass, "bin/src/fulldemo/bloomprefilter.frag.spv", true,
+              false, 0, thresholdSpecialization.getInfo());
+      });
+      createReloadablePostprocPipeline(bloomDownsamplePipeline, "bin/src/fulldemo/bloomdownsample.frag.spv", [=]() {
+        return createPostprocPipeline(ctx.device, postprocPipelineLayout, extent, downsampleRenderPass, "bin/src/fulldemo/bloomdownsample.frag.spv", true);
+      });
+      createReloadablePostprocPipeline(bloomUpsamplePipeline, "bin/src/fulldemo/bloomupsample.frag.spv", [=]() {
+        return createPostprocPipeline(ctx.device, postprocPipelineLayout, extent, upsampleRenderPass, "bin/src/fulldemo/bloomupsample.frag.spv", true, true,
+              BloomScatter, upsampleSpecialization.getInfo());
+      });
+    }
+  }
+
+  // Against the render passes of the frame graph, or the color one of 'subpasstonemap'
+  void createScenePipelines(VkRenderPass shadowPass, VkRenderPass colorPass)
+  {
+    const std::string vertexShader = compactVertices ? "bin/src/fulldemo/compact.vert.spv" : "bin/src/fulldemo/shader.vert.spv";
+
+    createReloadablePipeline(shadowMapPipeline, {"bin/src/fulldemo/depth.vert.spv"},
+          [=]() { return createShadowMapPipeline(ctx.device, perspectivePipelineLayout, shadowPass, compactVertices); });
+    createReloadablePipeline(colorPipeline, {vertexShader, "bin/src/fulldemo/shader.frag.spv"}, [=]() {
+      return createColorPipeline(ctx.device, perspectivePipelineLayout, ctx.swapchainExtent, colorPass, compactVertices, depthPrepass, brightPassTarget,
+            shadowFilter, shadowKernelSize);
+    });
+
+    if(depthPrepass)
+      createReloadablePipeline(depthPrepassPipeline, {"bin/src/fulldemo/depth.vert.spv"}, [=]() {
+        return createDepthPrepassPipeline(ctx.device, perspectivePipelineLayout, ctx.swapchainExtent, colorPass, compactVertices, brightPassTarget);
+      });
+  }
+
+  // Creates the pipeline, and keeps 'create' to create it again when one of its shaders is recompiled, see 'hotreload'
+  void createReloadablePipeline(VkPipeline& pipeline, std::vector<std::string> shaders, std::function<VkPipeline()> create)
+  {
+    pipeline = create();
+    reloadablePipelines.push_back({&pipeline, std::move(shaders), std::move(create)});
+  }
+
+  // Full screen pass: quad.vert.glsl + 'fragShader'
+  void createReloadablePostprocPipeline(VkPipeline& pipeline, const char* fragShader, std::function<VkPipeline()> create)
+  {
+    createReloadablePipeline(pipeline, {"bin/src/fulldemo/quad.vert.spv", fragShader}, std::move(create));
+  }
+
+  // On the watcher thread: creates the pipelines using 'spvPath' again.
+  // They replace the current ones at the beginning of the next frame, see 'replaceReloadedPipelines'.
+  void rebuildPipelines(const std::string& spvPath)
+  {
+    for(auto& reloadable : reloadablePipelines)
+    {
+      if(std::find(reloadable.shaders.begin(), reloadable.shaders.end(), spvPath) == reloadable.shaders.end())
+        continue;
+
+      try
+      {
+        const VkPipeline pipeline = reloadable.create();
+
+        std::lock_guard<std::mutex> lock(reloadedPipelinesMutex);
+        reloadedPipelines.push_back({reloadable.pipeline, pipeline});
+      }
+      catch(const std::exception& e)
+      {
+        fprintf(stderr, "Shader hot-reload: %s, keeping the previous pipeline\n", e.what());
+      }
+    }
+  }
+
+  // At a frame boundary, on the main thread
+  void replaceReloadedPipelines()
+  {
+    std::vector<ReloadedPipeline> reloaded;
+
+    {
+      std::lock_guard<std::mutex> lock(reloadedPipelinesMutex);
+      reloaded.swap(reloadedPipelines);
+    }
+
+    if(reloaded.empty())
+      return;
+
+    // the frames in flight may still use the previous pipelines
+    vkDeviceWaitIdle(ctx.device);
+
+    for(auto& r : reloaded)
+    {
+      vkDestroyPipeline(ctx.device, *r.target, nullptr);
+      *r.target = r.pipeline;
+    }
+
+    // the cached cascades were drawn by the previous shaders
+    for(auto& entry : shadowCacheEntries)
+      entry.valid = false;
+
+    fprintf(stderr, "Shader hot-reload: %d pipelines replaced\n", (int)reloaded.size());
+  }
+
+  // Full resolution post-processing pass, in a render pass begun by 'frameGraph'
+  void drawPostprocPass(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkDescriptorSet descriptorSet)
+  {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postprocPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+  }
+
+  // One level of the bloom mip chain, in a render pass begun by 'frameGraph'
+  void drawBloomPass(VkCommandBuffer commandBuffer, int level, VkPipeline pipeline, VkDescriptorSet descriptorSet)
+  {
+    const VkExtent2D extent = getBloomMipExtent(level);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, postprocPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = (float)extent.height;
+    viewport.width = (float)extent.width;
+    viewport.height = -(float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+  }
+
+  VkExtent2D getBloomMipExtent(int level) const { return computeBloomMipExtent(ctx.swapchainExtent, level); }
+
+  // Copies the final bloom of both paths to host-visible memory
+  void recordBloomReadback(VkCommandBuffer commandBuffer)
+  {
+    struct Copy
+    {
+      VulkanFramebuffer& source;
+      VkExtent2D extent;
+      VkBuffer destination;
+    };
+
+    const Copy copies[] = {
+          {bloomBuffer[0], ctx.swapchainExtent, bloomReadback[0].buffer},
+          {bloomMips[0], getBloomMipExtent(0), bloomReadback[1].buffer},
+    };
+
+    for(auto& copy : copies)
+    {
+      VkImageMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = copy.source.image;
+      barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+      vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+      VkBufferImageCopy region{};
+      region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+      region.imageExtent = {copy.extent.width, copy.extent.height, 1};
+      vkCmdCopyImageToBuffer(commandBuffer, copy.source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.destination, 1, &region);
+
+      // back to the layout the next frame expects
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+      vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    // make the copies visible to the host
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  // Image diff between the full resolution bloom (reference, box-filtered to half resolution)
+  // and the mip chain bloom.
+  void compareBloomImages()
+  {
+    const VkExtent2D full = ctx.swapchainExtent;
+    const VkExtent2D half = getBloomMipExtent(0);
+
+    const float* reference = nullptr;
+    const float* candidate = nullptr;
+    vkMapMemory(ctx.device, bloomReadback[0].memory, 0, VK_WHOLE_SIZE, 0, (void**)&reference);
+    vkMapMemory(ctx.device, bloomReadback[1].memory, 0, VK_WHOLE_SIZE, 0, (void**)&candidate);
+
+    double sumSquaredDiff = 0;
+    double sumSquaredRef = 0;
+    float maxDiff = 0;
+
+    for(uint32_t y = 0; y < half.height; ++y)
+    {
+      for(uint32_t x = 0; x < half.width; ++x)
+      {
+        for(int c = 0; c < 3; ++c)
+        {
+          float ref = 0;
+
+          for(uint32_t k = 0; k < 4; ++k)
+          {
+            const uint32_t srcX = std::min(x * 2 + (k & 1), full.width - 1);
+            const uint32_t srcY = std::min(y * 2 + (k >> 1), full.height - 1);
+            ref += reference[(srcY * full.width + srcX) * 4 + c] * 0.25f;
+          }
+
+          const float diff = candidate[(y * half.width + x) * 4 + c] - ref;
+          sumSquaredDiff += diff * diff;
+          sumSquaredRef += ref * ref;
+          maxDiff = std::max(maxDiff, std::abs(diff));
+        }
+      }
+    }
+
+    vkUnmapMemory(ctx.device, bloomReadback[0].memory);
+    vkUnmapMemory(ctx.device, bloomReadback[1].memory);
+
+    const double count = 3.0 * half.width * half.height;
+    const double rmsDiff = std::sqrt(sumSquaredDiff / count);
+    const double rmsRef = std::sqrt(sumSquaredRef / count);
+
+    fprintf(stderr, "Bloom image diff (mip chain vs full resolution): rms=%g (%.1f%% of the reference rms), max=%g\n", rmsDiff,
+          rmsRef > 0 ? 100.0 * rmsDiff / rmsRef : 0.0, maxDiff);
+  }
+
+  // 'hdrdiff': image diff of the tone-mapped output, between the selected HDR format and an RGBA32F reference
+  // (a second FullDemo), both rendering the same frame, bloom included.
+  // Tolerance: the worst case of one store in the format (see hdrprecision.h), plus one step, as both
+  // pictures are rounded to 8 bits. The diff measures what the stores of the bloom chain add.
+  void compareHdrFormatWithReference()
+  {
+    if(subpassTonemap)
+    {
+      fprintf(stderr, "hdrdiff=1 isn't supported with subpasstonemap=1: it renders to the swapchain images only\n");
+      return;
+    }
+
+    if(hdrFormatInfo->bits == 32)
+    {
+      fprintf(stderr, "hdrdiff=1: the HDR format is already RGBA32F, nothing to compare\n");
+      return;
+    }
+
+    const VkFormat outputFormat = ctx.swapchainFormat;
+
+    if(outputFormat != VK_FORMAT_B8G8R8A8_SRGB && outputFormat != VK_FORMAT_B8G8R8A8_UNORM && outputFormat != VK_FORMAT_R8G8B8A8_SRGB &&
+          outputFormat != VK_FORMAT_R8G8B8A8_UNORM)
+    {
+      fprintf(stderr, "hdrdiff=1 needs an 8-bit swapchain format\n");
+      return;
+    }
+
+    const std::vector<uint8_t> candidate = renderTonemappedFrame(ctx, *this);
+    std::vector<uint8_t> reference;
+
+    {
+      fprintf(stderr, "HDR image diff: creating the RGBA32F reference\n");
+      FullDemo referenceApp(ctx, 32);
+      reference = renderTonemappedFrame(ctx, referenceApp);
+    }
+
+    const int tolerance = (int)std::ceil(measureTonemapError(hdrFormatInfo->mantissaBits).max) + 1;
+
+    double sumSquaredDiff = 0;
+    int maxDiff = 0;
+    int pixelsOverTolerance = 0;
+
+    for(size_t i = 0; i < candidate.size(); i += 4)
+    {
+      int pixelDiff = 0;
+
+      // the alpha channel is always 1
+      for(int c = 0; c < 3; ++c)
+      {
+        const int diff = std::abs(int(candidate[i + c]) - int(reference[i + c]));
+        sumSquaredDiff += diff * diff;
+        pixelDiff = std::max(pixelDiff, diff);
+      }
+
+      maxDiff = std::max(maxDiff, pixelDiff);
+
+      if(pixelDiff > tolerance)
+        ++pixelsOverTolerance;
+    }
+
+    const double count = 3.0 * candidate.size() / 4;
+
+    fprintf(stderr, "HDR image diff (%d bits vs RGBA32F, tone-mapped, 8-bit steps): rms=%.3f, max=%d, tolerance=%d: %s (%d pixels over)\n",
+          hdrFormatInfo->bits, std::sqrt(sumSquaredDiff / count), maxDiff, tolerance, maxDiff <= tolerance ? "pass" : "FAIL", pixelsOverTolerance);
   }
 
 private:
+  bool compactVertices = false;
+  bool depthPrepass = false;
+  bool bloomMipChain = true;
+  bool computeBloom = false; // full resolution bloom, with compute shaders
+  bool brightPassTarget = false; // the color pass writes the bloom threshold to bloomBuffer[0] (or brightPassBuffer)
+  bool bloomDiff = false; // run both bloom paths, and periodically compare them
+  bool subpassTonemap = false; // tone-mapping as a second subpass of the color pass, see 'createSubpassTonemapRenderPass'
+  bool shadowCache = false; // the cascades are only rendered again when their transform changes, see 'drawShadowCascade'
+  bool rotateScene = true; // otherwise, the scene is static: the shadow cache is always valid
+  bool historyInitialized = false;
+  bool shadowMapLinear = true; // the shadow lookups blend 2x2 compares
+  int shadowFilter = ShadowFilterHardware;
+  int shadowKernelSize = 3; // see 'ShadowFilter'
+  VkFormat hdrFormat{}; // HDR color, bright-pass and bloom images, see 'selectHdrFormat'
+  int hdrPixelSize = 0; // in bytes
+  const HdrFormatInfo* hdrFormatInfo = nullptr;
+  const int forcedHdrFormatBits;
+
+  // State of the frame being recorded, see 'drawFrame'
+  Matrix4f frameModel;
+  VkFramebuffer frameSwapchainFramebuffer{};
+  ShadowCascade shadowCascades[MaxShadowCascadeCount];
+  int shadowCascadeCount = MaxShadowCascadeCount;
+
+  // What each cached cascade was rendered with
+  struct ShadowCacheEntry
+  {
+    bool valid = false;
+    Matrix4f transform; // model to cascade clip space
+  };
+
+  ShadowCacheEntry shadowCacheEntries[MaxShadowCascadeCount];
+
+  struct Statistics
+  {
+    uint64_t fragmentInvocations = 0; // color pass
+    int frameCount = 0; // number of frames read back
+
+    uint64_t shadowTicks = 0; // shadow cascades, GPU time
+    uint64_t colorTicks = 0; // color pass, GPU time: depends on the shadow filter
+    uint64_t postprocTicks = 0; // bloom + tone-mapping, GPU time
+    int timedFrameCount = 0;
+
+    // color pass, counted on the CPU while recording
+    int recordedFrameCount = 0;
+    int drawCalls = 0;
+    int pipelineBinds = 0;
+    int vertexBufferBinds = 0;
+    int descriptorSetBinds = 0;
+    int shadowDrawCalls = 0; // all the cascades
+    int shadowCascadeRenders = 0; // not taken from the cache
+  };
+
+  Statistics stats;
+  RenderQueue renderQueue;
+  int frameCount = 0;
+  int querySlot = 0;
+  VkQueryPool statisticsQueryPool{};
+  VkQueryPool timestampQueryPool{};
+  float timestampPeriod = 0; // in nanoseconds per tick
+
   VkPipelineLayout perspectivePipelineLayout{};
   VkPipelineLayout postprocPipelineLayout{};
+  VkPipelineLayout computePipelineLayout{};
+  VkPipelineLayout subpassTonemapPipelineLayout{};
 
   VkPipeline shadowMapPipeline{};
   VkPipeline colorPipeline{};
+  VkPipeline depthPrepassPipeline{};
   VkPipeline thresholdPipeline{};
   VkPipeline vertBlurPipeline{};
   VkPipeline horzBlurPipeline{};
+  VkPipeline bloomPrefilterPipeline{};
+  VkPipeline bloomDownsamplePipeline{};
+  VkPipeline bloomUpsamplePipeline{};
   VkPipeline tonemapPipeline{};
+  VkPipeline computeHorzBlurPipeline{};
+  VkPipeline computeVertBlurPipeline{};
+
+  // Shader hot-reload ('hotreload=1'): how to create each pipeline again, see 'createReloadablePipeline'
+  struct ReloadablePipeline
+  {
+    VkPipeline* pipeline;
+    std::vector<std::string> shaders; // .spv paths
+    std::function<VkPipeline()> create;
+  };
+
+  // Created by the watcher thread, not in use yet
+  struct ReloadedPipeline
+  {
+    VkPipeline* target;
+    VkPipeline pipeline;
+  };
+
+  std::vector<ReloadablePipeline> reloadablePipelines; // not modified once the watcher runs
+  std::vector<ReloadedPipeline> reloadedPipelines;
+  std::mutex reloadedPipelinesMutex;
+  std::unique_ptr<ShaderWatcher> shaderWatcher;
+  ComputeBlurPushConstant computeBlurConstants{};
 
   std::vector<VulkanMesh> vulkanMeshes;
-  std::vector<VulkanMaterial> vulkanMaterials;
+  VkBuffer materialBuffer{};
+  VkDeviceMemory materialMemory{};
+  VkDescriptorSet materialDescriptorSet{};
 
   VkDescriptorSetLayout sceneDescriptorSetLayout{};
   VkDescriptorSetLayout materialDescriptorSetLayout{};
   VkDescriptorSetLayout postprocDescriptorSetLayout{};
+  VkDescriptorSetLayout computeDescriptorSetLayout{};
+  VkDescriptorSetLayout subpassTonemapDescriptorSetLayout{};
 
-  VkDescriptorPool descriptorPool{};
+  DescriptorAllocator descriptorAllocator;
   VkDescriptorSet mainSceneDescriptorSet{};
-  VkDescriptorSet shadowMapDescriptorSet{};
+  VkDescriptorSet shadowMapDescriptorSet[MaxShadowCascadeCount]{};
   VkDescriptorSet postprocDescriptorSet_Hdr_And_Bloom0{};
   VkDescriptorSet postprocDescriptorSet_Bloom0_And_Bloom1{};
+  VkDescriptorSet bloomMipDescriptorSet[BloomMipCount]{}; // samples bloomMips[i]
+  VkDescriptorSet computeDescriptorSet[2]{}; // horz blur, vert blur
+  VkDescriptorSet tonemapDescriptorSet{}; // transient, see 'drawFrame'
   VkBuffer uniformBuffer{};
-  VkBuffer shadowMapUniformBuffer{};
+  VkBuffer shadowMapUniformBuffer[MaxShadowCascadeCount]{};
   VkDeviceMemory uniformBufferMemory{};
-  VkDeviceMemory shadowMapUniformBufferMemory{};
-  VulkanFramebuffer shadowMap{};
+  VkDeviceMemory shadowMapUniformBufferMemory[MaxShadowCascadeCount]{};
+  VulkanFramebuffer shadowMap{}; // image of 'frameGraph', one layer per cascade, no framebuffer
 
-  VkRenderPass shadowRenderPass{};
-  VkRenderPass colorRenderPass{};
-  VkRenderPass postprocRenderPass{};
+  VkRenderPass colorRenderPass{}; // only for 'subpasstonemap', else: see 'frameGraph'
+
+  VulkanFramebufferWithDepth hdrBuffer{}; // transient with 'subpasstonemap': no sampler, no framebuffer. Else: image of 'frameGraph', color only
+  VulkanFramebuffer brightPassBuffer{}; // only for 'subpasstonemap'
+  std::vector<VkFramebuffer> subpassFramebuffers; // only for 'subpasstonemap', one per swapchain image
+
+  // Shadow, color and bloom render passes, and their images. The color pass is external with 'subpasstonemap'.
+  FrameGraph frameGraph;
+  VulkanFramebuffer externalBloomBuffer[2]{}; // full resolution bloom written outside of 'frameGraph', by the compute blur
+
+  // Not owned: images of 'frameGraph' or 'externalBloomBuffer', no framebuffers
+  VulkanFramebuffer bloomBuffer[2]{}; // full resolution bloom, only for 'bloomchain=0' or 'bloomdiff=1'
+  VulkanFramebuffer bloomMips[BloomMipCount]{};
+
+  struct ReadbackBuffer
+  {
+    VkBuffer buffer{};
+    VkDeviceMemory memory{};
+  };
 
-  VulkanFramebufferWithDepth hdrBuffer{};
-  VulkanFramebuffer bloomBuffer[2]{};
+  ReadbackBuffer bloomReadback[2]{}; // full resolution, mip chain
+  int bloomReadbackFrame = -1;
 
   const AppCreationContext ctx;
 };
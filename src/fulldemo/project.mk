@@ -1,9 +1,20 @@
 SRCS+=$(GetMyDir)/program.cpp
 SRCS+=$(GetMyDir)/objloader.cpp
+SRCS+=$(GetMyDir)/meshsimplifier.cpp
+SRCS+=$(GetMyDir)/compactvertex.cpp
+SRCS+=$(GetMyDir)/renderqueue.cpp
+SRCS+=$(GetMyDir)/gaussianblur.cpp
+SRCS+=$(GetMyDir)/hdrprecision.cpp
 SHADERS+=$(GetMyDir)/shader.vert.glsl
+SHADERS+=$(GetMyDir)/compact.vert.glsl
+SHADERS+=$(GetMyDir)/depth.vert.glsl
 SHADERS+=$(GetMyDir)/shader.frag.glsl
 SHADERS+=$(GetMyDir)/quad.vert.glsl
 SHADERS+=$(GetMyDir)/threshold.frag.glsl
-SHADERS+=$(GetMyDir)/horzblur.frag.glsl
-SHADERS+=$(GetMyDir)/vertblur.frag.glsl
+SHADERS+=$(GetMyDir)/blur.frag.glsl
+SHADERS+=$(GetMyDir)/bloomblur.comp.glsl
+SHADERS+=$(GetMyDir)/bloomprefilter.frag.glsl
+SHADERS+=$(GetMyDir)/bloomdownsample.frag.glsl
+SHADERS+=$(GetMyDir)/bloomupsample.frag.glsl
 SHADERS+=$(GetMyDir)/tonemapping.frag.glsl
+SHADERS+=$(GetMyDir)/tonemapping_subpass.frag.glsl
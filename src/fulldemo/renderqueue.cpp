@@ -0,0 +1,43 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cmath>
+
+uint64_t makeSortKey(int pipeline, float depth, int material)
+{
+  const uint64_t MaxDepth = (1 << 24) - 1;
+  const uint64_t quantizedDepth = (uint64_t)std::lround(std::min(std::max(depth, 0.0f), 1.0f) * MaxDepth);
+
+  return (uint64_t(pipeline & 0xFF) << 56) | (quantizedDepth << 32) | (uint64_t(material & 0xFFFF) << 16);
+}
+
+void RenderQueue::sort()
+{
+  scratch.resize(items.size());
+
+  for(int shift = 0; shift < 64; shift += 8)
+  {
+    int count[256]{};
+
+    for(auto& item : items)
+      count[(item.key >> shift) & 0xFF]++;
+
+    // all the keys share this byte: nothing to do
+    if(count[(items.empty() ? 0 : items[0].key >> shift) & 0xFF] == (int)items.size())
+      continue;
+
+    int offset[256];
+    int sum = 0;
+
+    for(int i = 0; i < 256; ++i)
+    {
+      offset[i] = sum;
+      sum += count[i];
+    }
+
+    for(auto& item : items)
+      scratch[offset[(item.key >> shift) & 0xFF]++] = item;
+
+    items.swap(scratch);
+  }
+}
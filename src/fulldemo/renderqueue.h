@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// One draw call, waiting to be recorded
+struct DrawItem
+{
+  uint64_t key; // see 'makeSortKey'
+  int mesh;
+};
+
+// Sort key layout, from most to least significant bits:
+// - pipeline (8 bits): all the draws of a pipeline are recorded together
+// - depth (24 bits): front-to-back, to get the most out of early-Z
+// - material (16 bits): tie-break, keeps the order stable
+// 'depth' is normalized to [0;1], out-of-range values are clamped.
+uint64_t makeSortKey(int pipeline, float depth, int material);
+
+inline int getSortKeyPipeline(uint64_t key) { return int(key >> 56); }
+
+// Per-frame list of draws, sorted by key
+class RenderQueue
+{
+public:
+  void clear() { items.clear(); }
+  void push(uint64_t key, int mesh) { items.push_back({key, mesh}); }
+
+  // Stable LSD radix sort, 8 bits per pass.
+  // Passes where all the keys share the same byte are skipped.
+  void sort();
+
+  const std::vector<DrawItem>& getItems() const { return items; }
+
+private:
+  std::vector<DrawItem> items;
+  std::vector<DrawItem> scratch;
+};
@@ -1,34 +1,116 @@
 #version 450
 
 layout(location = 0) in vec3 inNormal;
-layout(location = 1) in vec4 fragPositionLightSpace;
+layout(location = 1) in vec3 inWorldPosition;
+layout(location = 2) in float inViewDistance;
 
 layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec4 outBrightPass;
 
-// Scene DescriptorSet (set=0), Shadow Map (binding=1)
-layout(set=0, binding=1) uniform sampler2D shadowMapSampler;
+// Second render target: the bloom threshold, see 'createColorRenderPass'
+layout(constant_id = 0) const bool BrightPassTarget = false;
+layout(constant_id = 3) const float BloomThreshold = 0.95; // see 'BloomThreshold'
 
-// Material DescriptorSet (set=0), MaterialParams (binding=0)
-layout(set=1, binding=0, std140) uniform MaterialParamsDescriptorSet
+// Filtering of the shadow lookups, see 'ShadowFilter'
+layout(constant_id = 1) const int ShadowFilter = 0; // 0: hardware, 1: rotated grid, 2: Poisson disk
+layout(constant_id = 2) const int ShadowKernelSize = 3; // grid and disk: ShadowKernelSize^2 taps, about ShadowKernelSize texels wide
+
+// Cascaded shadow map, see 'MaxShadowCascadeCount'
+const int MaxCascadeCount = 4;
+
+// Scene DescriptorSet (set=0), Camera (binding=0), same as shader.vert.glsl
+layout(set=0, binding=0, std140) uniform MyDescriptorSet
+{
+  mat4x4 view;
+  mat4x4 proj;
+
+  // unused cascades repeat the last one
+  mat4x4 cascadeViewProj[MaxCascadeCount];
+  vec4 cascadeSplits; // far view distance of each cascade
+} UniformBlock;
+
+// Scene DescriptorSet (set=0), Shadow Map (binding=1): one layer per cascade.
+// Depth compare sampler: each lookup returns the lit fraction of 2x2 texels. The bias is in the shadow pipeline.
+layout(set=0, binding=1) uniform sampler2DArrayShadow shadowMapSampler;
+
+struct Material
 {
   vec4 diffuse;
   vec4 emissive;
-} MaterialParams;
+};
 
-float computeShadow(vec4 pos)
+// Material DescriptorSet (set=1), Material table (binding=0): all the materials of the scene
+layout(set=1, binding=0, std430) readonly buffer MaterialTable
 {
-  if (pos.z <= -1.0 || pos.z >= +1.0 || pos.w <= 0.0)
-    return 1;
+  Material materials[];
+} MaterialTable;
 
-  vec2 uv = pos.xy * 0.5 + 0.5;
-  uv.y = 1-uv.y;
+// See 'MeshPushConstant': the transform is only read by the vertex shader
+layout(push_constant) uniform MeshPushConstant
+{
+  layout(offset = 80) int materialIndex;
+} PushConstant;
+
+// In the unit disk, see 'ShadowFilterPoisson'
+const vec2 PoissonDisk[16] = vec2[](
+  vec2(-0.9420, -0.3991), vec2(0.9456, -0.7689), vec2(-0.0942, -0.9294), vec2(0.3450, 0.2939),
+  vec2(-0.9159, 0.4577), vec2(-0.8154, -0.8791), vec2(-0.3828, 0.2768), vec2(0.9748, 0.7565),
+  vec2(0.4432, -0.9751), vec2(0.5374, -0.4737), vec2(-0.2650, -0.4189), vec2(0.7920, 0.1909),
+  vec2(-0.2419, 0.9971), vec2(-0.8141, 0.9144), vec2(0.1998, 0.7864), vec2(0.1438, -0.1410));
+
+// Lit fraction around 'uv', in shadow map texels
+float filterShadow(vec2 uv, float cascade, float depth)
+{
+  if(ShadowFilter == 0)
+    return texture(shadowMapSampler, vec4(uv, cascade, depth));
+
+  vec2 texelSize = 1.0 / vec2(textureSize(shadowMapSampler, 0).xy);
+  float angle;
+
+  if(ShadowFilter == 1)
+    angle = 0.4636; // atan(1/2)
+  else
+    angle = 6.2832 * fract(52.9829 * fract(dot(gl_FragCoord.xy, vec2(0.06711, 0.00584)))); // interleaved gradient noise
 
-  float dist = texture(shadowMapSampler, uv).r;
+  mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+  float sum = 0;
 
-  if (dist >= pos.z - 0.01)
-    return 1;
+  for(int i = 0; i < ShadowKernelSize * ShadowKernelSize; ++i)
+  {
+    vec2 offset;
 
-  return 0.5; // in shadow
+    if(ShadowFilter == 1)
+      offset = vec2(i % ShadowKernelSize, i / ShadowKernelSize) - 0.5 * (ShadowKernelSize - 1);
+    else
+      offset = PoissonDisk[i] * 0.5 * ShadowKernelSize;
+
+    sum += texture(shadowMapSampler, vec4(uv + rotation * offset * texelSize, cascade, depth));
+  }
+
+  return sum / (ShadowKernelSize * ShadowKernelSize);
+}
+
+float computeShadow(vec3 worldPosition, float viewDistance)
+{
+  // the first cascade whose slice reaches the fragment
+  int cascade = 0;
+
+  for(int i = 0; i < MaxCascadeCount; ++i)
+  {
+    if(viewDistance > UniformBlock.cascadeSplits[i])
+      cascade = i + 1;
+  }
+
+  if(cascade == MaxCascadeCount)
+    return 1; // beyond the shadow distance
+
+  // orthographic: w = 1
+  vec4 pos = UniformBlock.cascadeViewProj[cascade] * vec4(worldPosition, 1);
+
+  vec2 uv = pos.xy * 0.5 + 0.5;
+  uv.y = 1-uv.y;
+
+  return mix(0.5, 1.0, filterShadow(uv, float(cascade), pos.z)); // 0.5: in shadow
 }
 
 void main()
@@ -36,13 +118,19 @@ void main()
   vec3 ambient = vec3(1, 1, 1) * 0.04;
   vec3 lightVector = normalize(vec3(1, 1, 1));
   float light = max(dot(inNormal, lightVector), 0) * 0.5;
-  float shadow = computeShadow(fragPositionLightSpace / fragPositionLightSpace.w);
+  float shadow = computeShadow(inWorldPosition, inViewDistance);
+
+  Material material = MaterialTable.materials[PushConstant.materialIndex];
 
   vec3 totalLight = vec3(0, 0, 0);
 
-  totalLight += MaterialParams.diffuse.rgb * ambient.rgb;
-  totalLight += MaterialParams.diffuse.rgb * shadow * light;
-  totalLight += MaterialParams.emissive.rgb;
+  totalLight += material.diffuse.rgb * ambient.rgb;
+  totalLight += material.diffuse.rgb * shadow * light;
+  totalLight += material.emissive.rgb;
 
   outColor = vec4(totalLight, 1);
+
+  // same as threshold.frag.glsl
+  if(BrightPassTarget)
+    outBrightPass = length(totalLight) < BloomThreshold ? vec4(0, 0, 0, 1) : vec4(totalLight, 1);
 }
@@ -4,23 +4,44 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 
 layout(location = 0) out vec3 outNormal;
-layout(location = 1) out vec4 fragPositionLightSpace;
+layout(location = 1) out vec3 outWorldPosition;
+layout(location = 2) out float outViewDistance;
+
+// must match depth.vert.glsl bit-for-bit (EQUAL depth test after the prepass)
+invariant gl_Position;
 
 // Scene DescriptorSet (set=0), Camera (binding=0)
 layout(set=0, binding=0, std140) uniform MyDescriptorSet
 {
-  mat4x4 model;
   mat4x4 view;
   mat4x4 proj;
-  mat4x4 lightMVP;
+
+  // color pass only, see shader.frag.glsl
+  mat4x4 cascadeViewProj[4];
+  vec4 cascadeSplits;
 } UniformBlock;
 
+// Per draw: model transform (see 'PackedAffine'), and quantization box (identity for float positions)
+layout(push_constant) uniform MeshPushConstantBlock
+{
+  vec4 modelRows[3]; // affine: the last row is (0, 0, 0, 1)
+  vec4 boxMin;
+  vec4 boxSize;
+} Mesh;
+
 void main()
 {
-  mat4x4 tx = UniformBlock.proj * UniformBlock.view * UniformBlock.model;
-  gl_Position = tx * vec4(inPosition, 1);
-  fragPositionLightSpace = UniformBlock.lightMVP * vec4(inPosition, 1);
+  mat4x4 model = transpose(mat4x4(Mesh.modelRows[0], Mesh.modelRows[1], Mesh.modelRows[2], vec4(0, 0, 0, 1)));
+  // same expression as in depth.vert.glsl
+  vec3 position = Mesh.boxMin.xyz + inPosition * Mesh.boxSize.xyz;
 
-  outNormal = (UniformBlock.model * vec4(inNormal, 0)).xyz;
-}
+  mat4x4 tx = UniformBlock.proj * UniformBlock.view * model;
+  gl_Position = tx * vec4(position, 1);
+
+  // the cascade is selected per fragment
+  vec4 worldPosition = model * vec4(position, 1);
+  outWorldPosition = worldPosition.xyz;
+  outViewDistance = -(UniformBlock.view * worldPosition).z;
 
+  outNormal = (model * vec4(inNormal, 0)).xyz;
+}
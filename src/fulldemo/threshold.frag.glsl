@@ -6,11 +6,13 @@ layout(location = 0) out vec4 outColor;
 
 layout(set=0, binding=0) uniform sampler2D inputPicture;
 
+layout(constant_id = 0) const float Threshold = 0.95; // see 'BloomThreshold'
+
 void main()
 {
   vec3 result = texture(inputPicture, uv).rgb;
 
-  if(length(result) < 0.95)
+  if(length(result) < Threshold)
     result = vec3(0);
 
   outColor = vec4(result, 1.0);
@@ -0,0 +1,28 @@
+#version 450
+
+// Same as tonemapping.frag.glsl, as the second subpass of the scene render pass:
+// the HDR color is read from the tile memory, see 'createSubpassTonemapRenderPass'.
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(input_attachment_index = 0, set=0, binding=0) uniform subpassInput hdrInput;
+layout(set=0, binding=1) uniform sampler2D bloomPicture; // lower resolution, from the previous frame
+
+layout(constant_id = 0) const float Gamma = 1.0; // see 'TonemapGamma'
+
+void main()
+{
+  vec3 result = subpassLoad(hdrInput).rgb + texture(bloomPicture, uv).rgb;
+
+  // tone mapping
+  vec3 hdrColor = result;
+
+  // reinhard tone mapping
+  vec3 mapped = hdrColor / (hdrColor + vec3(1.0));
+
+  // gamma correction
+  mapped = pow(mapped, vec3(1.0 / Gamma));
+
+  outColor = vec4(mapped, 1.0);
+}
@@ -1,5 +1,7 @@
 #include "common/app.h"
+#include "common/descriptorallocator.h"
 #include "common/matrix4.h"
+#include "common/texture.h"
 #include "common/util.h"
 #include "common/vkutil.h"
 
@@ -140,36 +142,25 @@ VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device)
   return descriptorSetLayout;
 }
 
-VkDescriptorPool createDescriptorPool(VkDevice device)
+// Per draw, see 'shader.vert.glsl'
+struct MyPushConstantBlock
 {
-  VkDescriptorPoolSize sizes[2];
-
-  // Samplers : 1 total
-  sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  sizes[0].descriptorCount = 1;
-
-  // Uniform buffers : 1 total
-  sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  sizes[1].descriptorCount = 1;
-
-  // Create the global descriptor pool
-  VkDescriptorPoolCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  info.poolSizeCount = lengthof(sizes);
-  info.pPoolSizes = sizes;
-  info.maxSets = 1; // number of desc sets that can be allocated from this pool
-
-  VkDescriptorPool descriptorPool;
-  vkCreateDescriptorPool(device, &info, nullptr, &descriptorPool);
-  return descriptorPool;
-}
+  PackedAffine model;
+};
 
 VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout)
 {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(MyPushConstantBlock);
+
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = 1;
   pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
   VkPipelineLayout pipelineLayout;
 
@@ -303,225 +294,9 @@ VkBuffer createVertexBuffer(VkDevice device, size_t size)
   return vertexBuffer;
 }
 
-VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout)
-{
-  VkDescriptorSetAllocateInfo allocateInfo{};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocateInfo.descriptorPool = pool;
-  allocateInfo.descriptorSetCount = 1;
-  allocateInfo.pSetLayouts = &layout;
-  VkDescriptorSet descriptorSet;
-  vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
-  return descriptorSet;
-}
-
-static int findTransferQueue(VkPhysicalDevice device)
-{
-  uint32_t queueFamilyCount = 0;
-  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-  int i = 0;
-
-  for(const auto& queueFamily : queueFamilies)
-  {
-    if(queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
-      return i;
-  }
-
-  return 0;
-}
-
-void setImageLayout(VkCommandBuffer cmdbuffer,
-      VkImage image,
-      VkImageLayout oldImageLayout,
-      VkImageLayout newImageLayout,
-      VkImageSubresourceRange subresourceRange)
-{
-  VkImageMemoryBarrier imageMemoryBarrier{};
-  imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  imageMemoryBarrier.oldLayout = oldImageLayout;
-  imageMemoryBarrier.newLayout = newImageLayout;
-  imageMemoryBarrier.image = image;
-  imageMemoryBarrier.subresourceRange = subresourceRange;
-
-  // Make sure any writes to the image have been finished
-  imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-  vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-}
-
-struct VulkanTexture
-{
-  VkImage image;
-  VkImageView view;
-  VkDeviceMemory memory;
-  VkSampler sampler;
-};
-
-VulkanTexture createTexture(VkDevice device, VkPhysicalDevice physicalDevice, void* srcPixels, int width, int height)
-{
-  const int bufferSize = width * height * sizeof(float) * 4;
-
-  // Create a host-visible staging buffer that contains the raw image data
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingMemory;
-
-  // This buffer is used as a transfer source for the buffer copy
-  {
-    {
-      VkBufferCreateInfo info{};
-      info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      info.size = bufferSize;
-      info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-      info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-      vkCreateBuffer(device, &info, nullptr, &stagingBuffer);
-    }
-
-    // Get memory requirements for the staging buffer (alignment, memory type bits)
-    VkMemoryRequirements memReqs;
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-
-    // Allocate memory for the staging buffer
-    {
-      VkMemoryAllocateInfo memAllocInfo{};
-      memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      memAllocInfo.allocationSize = memReqs.size;
-      memAllocInfo.memoryTypeIndex =
-            findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-      vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory);
-    }
-
-    vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
-  }
-
-  // Copy texture data into staging buffer
-  writeToGpuMemory(device, stagingMemory, srcPixels, bufferSize);
-
-  auto const format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-  VulkanTexture texture{};
-
-  // Create optimal tiled target image
-  {
-    VkImageCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    info.imageType = VK_IMAGE_TYPE_2D;
-    info.format = format;
-    info.mipLevels = 1;
-    info.arrayLayers = 1;
-    info.samples = VK_SAMPLE_COUNT_1_BIT;
-    info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    info.extent = {(uint32_t)width, (uint32_t)height, 1};
-    info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-    // Ensure that the TRANSFER_DST bit is set for staging
-    info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    vkCreateImage(device, &info, nullptr, &texture.image);
-  }
-
-  // Allocate memory for the texture image
-  {
-    {
-      VkMemoryRequirements memReqs;
-      vkGetImageMemoryRequirements(device, texture.image, &memReqs);
-
-      VkMemoryAllocateInfo info{};
-      info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      info.allocationSize = memReqs.size;
-      info.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-      vkAllocateMemory(device, &info, nullptr, &texture.memory);
-    }
-
-    vkBindImageMemory(device, texture.image, texture.memory, 0);
-  }
-
-  auto TransferDataFromStagingBufferToTexture = [&](VkCommandBuffer cmdBuf) {
-    // Image barrier for optimal image (target)
-    // Optimal image will be used as destination for the copy
-    VkImageSubresourceRange range{};
-    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    range.baseMipLevel = 0;
-    range.levelCount = 1;
-    range.layerCount = 1;
-
-    setImageLayout(cmdBuf, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
-
-    // Copy data from staging buffer
-    VkBufferImageCopy region{};
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageExtent.width = width;
-    region.imageExtent.height = height;
-    region.imageExtent.depth = 1;
-    region.bufferOffset = 0;
-
-    vkCmdCopyBufferToImage(cmdBuf, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    setImageLayout(cmdBuf, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
-  };
-
-  const int transferQueue = findTransferQueue(physicalDevice);
-  executeOneShotCommandBufferOnQueue(device, TransferDataFromStagingBufferToTexture, transferQueue);
-
-  // Clean up staging resources
-  vkFreeMemory(device, stagingMemory, nullptr);
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-
-  // Create sampler
-  {
-    VkSamplerCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    info.magFilter = VK_FILTER_LINEAR;
-    info.minFilter = VK_FILTER_LINEAR;
-    info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    info.mipLodBias = 0.0f;
-    info.compareOp = VK_COMPARE_OP_NEVER;
-    info.minLod = 0.0f;
-    info.maxLod = 0.0f;
-    info.maxAnisotropy = 1.0f;
-    vkCreateSampler(device, &info, nullptr, &texture.sampler);
-  }
-
-  // Create image view
-  {
-    VkImageViewCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    info.pNext = NULL;
-    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    info.format = format;
-    info.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
-    info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-    info.subresourceRange.levelCount = 1;
-    info.image = texture.image;
-    vkCreateImageView(device, &info, nullptr, &texture.view);
-  }
-
-  return texture;
-}
-
-void destroyTexture(VkDevice device, const VulkanTexture& texture)
-{
-  vkDestroyImageView(device, texture.view, nullptr);
-  vkDestroySampler(device, texture.sampler, nullptr);
-  vkDestroyImage(device, texture.image, nullptr);
-  vkFreeMemory(device, texture.memory, nullptr);
-}
-
+// Per frame: the model transform is in 'MyPushConstantBlock'
 struct MyUniformBlock
 {
-  Matrix4f model;
   Matrix4f view;
   Matrix4f proj;
 };
@@ -530,11 +305,11 @@ class HelloCube : public IApp
 {
 public:
   HelloCube(const AppCreationContext& ctx_)
-      : ctx(ctx_)
+      : descriptorAllocator(ctx_.device)
+      , ctx(ctx_)
   {
-    descriptorPool = createDescriptorPool(ctx.device);
     descriptorSetLayout = createDescriptorSetLayout(ctx.device);
-    descriptorSet = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
+    descriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
 
     pipelineLayout = createPipelineLayout(ctx.device, descriptorSetLayout);
     graphicsPipeline = createGraphicsPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, ctx.renderPass);
@@ -586,7 +361,8 @@ public:
       }
     }
 
-    texture = createTexture(ctx.device, ctx.physicalDevice, tex, N, N);
+    texture = createTexture(*ctx.immediate, ctx.physicalDevice, tex, N, N);
+    printTextureSummary("checkerboard", texture);
 
     // associate descriptor sets and buffers
     {
@@ -636,9 +412,7 @@ public:
     vkDestroyPipeline(ctx.device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
 
-    // vkFreeDescriptorSets(ctx.device, descriptorPool, 1, &descriptorSet);
     vkDestroyDescriptorSetLayout(ctx.device, descriptorSetLayout, nullptr);
-    vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
   }
 
   Camera m_camera;
@@ -675,17 +449,19 @@ public:
     MyUniformBlock constants{};
     const float angle = time * 0.4;
 
-    constants.model = rotateZ(angle * 0.3) * rotateY(angle * 0.2) * rotateX(angle * 0.25);
     constants.view = m_camera.mat;
     constants.proj = perspective(1.5, 4.0 / 3.0, 1, 100);
 
     // convert row-major (app) to column-major (GLSL)
-    constants.model = transpose(constants.model);
     constants.view = transpose(constants.view);
     constants.proj = transpose(constants.proj);
 
     writeToGpuMemory(ctx.device, uniformBufferMemory, &constants, sizeof constants);
 
+    MyPushConstantBlock pushConstants{};
+    pushConstants.model = packAffine(rotateZ(angle * 0.3) * rotateY(angle * 0.2) * rotateX(angle * 0.25));
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pushConstants, &pushConstants);
+
     vkCmdDraw(commandBuffer, lengthof(vertices), 1, 0, 0);
 
     vkCmdEndRenderPass(commandBuffer);
@@ -697,11 +473,11 @@ private:
   VkBuffer vertexBuffer{};
   VkDeviceMemory vertexBufferMemory{};
   VkDescriptorSetLayout descriptorSetLayout{};
-  VkDescriptorPool descriptorPool{};
+  DescriptorAllocator descriptorAllocator;
   VkDescriptorSet descriptorSet{};
   VkBuffer uniformBuffer{};
   VkDeviceMemory uniformBufferMemory{};
-  VulkanTexture texture{};
+  Texture texture{};
 
   const AppCreationContext ctx;
 };
@@ -7,15 +7,20 @@ layout(location = 0) out vec2 outUv;
 
 layout(binding=1, std140) uniform MyDescriptorSet
 {
-  mat4x4 model;
   mat4x4 view;
   mat4x4 proj;
 } UniformBlock;
 
+// Per draw: model transform (see 'PackedAffine')
+layout(push_constant) uniform MyPushConstantBlock
+{
+  vec4 modelRows[3];
+} PushConstant;
 
 void main()
 {
-  mat4x4 tx = UniformBlock.proj * UniformBlock.view * UniformBlock.model;
+  mat4x4 model = transpose(mat4x4(PushConstant.modelRows[0], PushConstant.modelRows[1], PushConstant.modelRows[2], vec4(0, 0, 0, 1)));
+  mat4x4 tx = UniformBlock.proj * UniformBlock.view * model;
   gl_Position = tx * vec4(inPosition, 1);
   outUv = inUv;
 }
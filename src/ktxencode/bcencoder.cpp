@@ -0,0 +1,268 @@
+#include "bcencoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring> // memcpy
+
+namespace
+{
+// Endpoints of the segment fitting the texels, along their principal axis (first 'channels' channels)
+void findEndpoints(const uint8_t* texels, int channels, float lo[4], float hi[4])
+{
+  float mean[4]{};
+
+  for(int i = 0; i < 16; ++i)
+  {
+    for(int c = 0; c < channels; ++c)
+      mean[c] += texels[i * 4 + c] / 16.0f;
+  }
+
+  float covariance[4][4]{};
+
+  for(int i = 0; i < 16; ++i)
+  {
+    for(int a = 0; a < channels; ++a)
+    {
+      for(int b = 0; b < channels; ++b)
+        covariance[a][b] += (texels[i * 4 + a] - mean[a]) * (texels[i * 4 + b] - mean[b]);
+    }
+  }
+
+  // Power iteration: converges to the eigenvector of the largest eigenvalue.
+  // Starts from the channel which varies the most: never orthogonal to the principal axis.
+  float axis[4]{};
+  int widest = 0;
+
+  for(int c = 1; c < channels; ++c)
+  {
+    if(covariance[c][c] > covariance[widest][widest])
+      widest = c;
+  }
+
+  axis[widest] = 1;
+
+  for(int iteration = 0; iteration < 8; ++iteration)
+  {
+    float next[4]{};
+    float length = 0;
+
+    for(int a = 0; a < channels; ++a)
+    {
+      for(int b = 0; b < channels; ++b)
+        next[a] += covariance[a][b] * axis[b];
+
+      length = std::max(length, std::abs(next[a]));
+    }
+
+    // flat block: any axis will do
+    if(length == 0)
+      break;
+
+    for(int c = 0; c < channels; ++c)
+      axis[c] = next[c] / length;
+  }
+
+  float minProj = 0;
+  float maxProj = 0;
+  float axisLengthSq = 0;
+
+  for(int c = 0; c < channels; ++c)
+    axisLengthSq += axis[c] * axis[c];
+
+  for(int i = 0; i < 16; ++i)
+  {
+    float proj = 0;
+
+    for(int c = 0; c < channels; ++c)
+      proj += (texels[i * 4 + c] - mean[c]) * axis[c];
+
+    minProj = std::min(minProj, proj / axisLengthSq);
+    maxProj = std::max(maxProj, proj / axisLengthSq);
+  }
+
+  for(int c = 0; c < channels; ++c)
+  {
+    lo[c] = std::min(std::max(mean[c] + axis[c] * minProj, 0.0f), 255.0f);
+    hi[c] = std::min(std::max(mean[c] + axis[c] * maxProj, 0.0f), 255.0f);
+  }
+}
+
+// Index of the closest palette entry, for each texel
+void pickIndices(const uint8_t* texels, int channels, const int palette[][4], int paletteSize, int indices[16])
+{
+  for(int i = 0; i < 16; ++i)
+  {
+    int bestError = 1 << 30;
+
+    for(int p = 0; p < paletteSize; ++p)
+    {
+      int error = 0;
+
+      for(int c = 0; c < channels; ++c)
+      {
+        const int delta = texels[i * 4 + c] - palette[p][c];
+        error += delta * delta;
+      }
+
+      if(error < bestError)
+      {
+        bestError = error;
+        indices[i] = p;
+      }
+    }
+  }
+}
+
+uint16_t packRgb565(const float color[4])
+{
+  const int r = int(color[0] * 31 / 255 + 0.5f);
+  const int g = int(color[1] * 63 / 255 + 0.5f);
+  const int b = int(color[2] * 31 / 255 + 0.5f);
+  return uint16_t((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(uint16_t value, int color[4])
+{
+  const int r = (value >> 11) & 31;
+  const int g = (value >> 5) & 63;
+  const int b = value & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+  color[3] = 255;
+}
+
+// BC7 endpoint channel: 7 bits, and a p-bit shared by the 4 channels of the endpoint
+void quantizeWithPBit(const float color[4], int quantized[4], int& pBit)
+{
+  int bestError = 1 << 30;
+
+  for(int p = 0; p < 2; ++p)
+  {
+    int candidate[4];
+    int error = 0;
+
+    for(int c = 0; c < 4; ++c)
+    {
+      candidate[c] = std::min(std::max(int((color[c] - p) / 2 + 0.5f), 0), 127);
+      const int delta = ((candidate[c] << 1) | p) - int(color[c] + 0.5f);
+      error += delta * delta;
+    }
+
+    if(error < bestError)
+    {
+      bestError = error;
+      pBit = p;
+      memcpy(quantized, candidate, sizeof candidate);
+    }
+  }
+}
+
+// Little-endian bit stream
+struct BitWriter
+{
+  uint8_t* data;
+  int position = 0;
+
+  void write(uint32_t value, int bitCount)
+  {
+    for(int i = 0; i < bitCount; ++i, ++position)
+    {
+      if((value >> i) & 1)
+        data[position / 8] |= uint8_t(1 << (position % 8));
+    }
+  }
+};
+
+const int BC7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+}
+
+void encodeBC1Block(const uint8_t* texels, uint8_t* block)
+{
+  float lo[4], hi[4];
+  findEndpoints(texels, 3, lo, hi);
+
+  uint16_t color0 = packRgb565(hi);
+  uint16_t color1 = packRgb565(lo);
+
+  // 4-color mode needs color0 > color1
+  if(color0 < color1)
+    std::swap(color0, color1);
+
+  int palette[4][4];
+  unpackRgb565(color0, palette[0]);
+  unpackRgb565(color1, palette[1]);
+
+  for(int c = 0; c < 4; ++c)
+  {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+
+  int indices[16]{};
+
+  // equal endpoints: 3-color mode, where index 0 is still color0
+  if(color0 != color1)
+    pickIndices(texels, 3, palette, 4, indices);
+
+  uint32_t indexBits = 0;
+
+  for(int i = 0; i < 16; ++i)
+    indexBits |= uint32_t(indices[i]) << (2 * i);
+
+  memcpy(block + 0, &color0, 2);
+  memcpy(block + 2, &color1, 2);
+  memcpy(block + 4, &indexBits, 4);
+}
+
+void encodeBC7Block(const uint8_t* texels, uint8_t* block)
+{
+  float lo[4], hi[4];
+  findEndpoints(texels, 4, lo, hi);
+
+  int endpoints[2][4];
+  int pBits[2];
+  quantizeWithPBit(lo, endpoints[0], pBits[0]);
+  quantizeWithPBit(hi, endpoints[1], pBits[1]);
+
+  int palette[16][4];
+
+  for(int i = 0; i < 16; ++i)
+  {
+    for(int c = 0; c < 4; ++c)
+    {
+      const int e0 = (endpoints[0][c] << 1) | pBits[0];
+      const int e1 = (endpoints[1][c] << 1) | pBits[1];
+      palette[i][c] = ((64 - BC7Weights4[i]) * e0 + BC7Weights4[i] * e1 + 32) >> 6;
+    }
+  }
+
+  int indices[16];
+  pickIndices(texels, 4, palette, 16, indices);
+
+  // The index of the first texel is stored without its most significant bit
+  if(indices[0] >= 8)
+  {
+    std::swap(endpoints[0], endpoints[1]);
+    std::swap(pBits[0], pBits[1]);
+
+    for(auto& index : indices)
+      index = 15 - index;
+  }
+
+  memset(block, 0, 16);
+  BitWriter writer{block};
+  writer.write(1 << 6, 7); // mode 6
+
+  for(int c = 0; c < 4; ++c)
+  {
+    writer.write(endpoints[0][c], 7);
+    writer.write(endpoints[1][c], 7);
+  }
+
+  writer.write(pBits[0], 1);
+  writer.write(pBits[1], 1);
+
+  for(int i = 0; i < 16; ++i)
+    writer.write(indices[i], i == 0 ? 3 : 4);
+}
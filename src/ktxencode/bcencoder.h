@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// Block-compression of 4x4 texels: 'texels' holds 16 RGBA8 texels, row by row.
+// Both fit the endpoints along the principal axis of the block colors, then
+// pick the closest palette entry for each texel.
+
+// 8 bytes, 4-color mode: alpha is ignored
+void encodeBC1Block(const uint8_t* texels, uint8_t* block);
+
+// 16 bytes, mode 6: one subset, RGBA endpoints with p-bits, 4-bit indices
+void encodeBC7Block(const uint8_t* texels, uint8_t* block);
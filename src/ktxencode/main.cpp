@@ -0,0 +1,241 @@
+// Offline texture encoder: converts a PPM/PAM image into a KTX2 file, with its
+// full mip chain, block-compressed or not. Built along with vulkanisch.exe.
+//
+//   bin/ktxencode.exe <bc1|bc7|rgba8> input.ppm output.ktx2 [srgb]
+
+#include "common/ktx2.h"
+#include "common/util.h" // loadFile
+
+#include "bcencoder.h"
+
+#include <algorithm>
+#include <cctype> // isspace
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+struct Image
+{
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> texels; // RGBA8, row by row
+};
+
+// Binary PPM (P6) and PAM (P7, RGB or RGB_ALPHA), 8 bits per channel
+Image loadNetpbm(const char* path)
+{
+  const auto file = loadFile(path);
+  size_t pos = 0;
+
+  auto skipBlanksAndComments = [&]() {
+    while(pos < file.size() && (isspace(file[pos]) || file[pos] == '#'))
+    {
+      if(file[pos] == '#')
+      {
+        while(pos < file.size() && file[pos] != '\n')
+          ++pos;
+      }
+      else
+        ++pos;
+    }
+  };
+
+  auto readToken = [&]() {
+    skipBlanksAndComments();
+    std::string token;
+
+    while(pos < file.size() && !isspace(file[pos]))
+      token += char(file[pos++]);
+
+    return token;
+  };
+
+  Image image;
+  int channels = 3;
+  int maxValue = 0;
+
+  const auto magic = readToken();
+
+  if(magic == "P6")
+  {
+    image.width = atoi(readToken().c_str());
+    image.height = atoi(readToken().c_str());
+    maxValue = atoi(readToken().c_str());
+  }
+  else if(magic == "P7")
+  {
+    for(auto token = readToken(); token != "ENDHDR"; token = readToken())
+    {
+      if(token.empty())
+        throw std::runtime_error(std::string("'") + path + "': truncated PAM header");
+      else if(token == "WIDTH")
+        image.width = atoi(readToken().c_str());
+      else if(token == "HEIGHT")
+        image.height = atoi(readToken().c_str());
+      else if(token == "DEPTH")
+        channels = atoi(readToken().c_str());
+      else if(token == "MAXVAL")
+        maxValue = atoi(readToken().c_str());
+      else if(token == "TUPLTYPE")
+        readToken();
+    }
+  }
+  else
+    throw std::runtime_error(std::string("'") + path + "': not a binary PPM or PAM file");
+
+  // a single whitespace ends the header
+  ++pos;
+
+  if(image.width <= 0 || image.height <= 0 || maxValue != 255 || (channels != 3 && channels != 4))
+    throw std::runtime_error(std::string("'") + path + "': only 8-bit RGB or RGBA images are supported");
+
+  if(file.size() < pos + size_t(image.width) * image.height * channels)
+    throw std::runtime_error(std::string("'") + path + "': truncated pixel data");
+
+  image.texels.resize(size_t(image.width) * image.height * 4);
+
+  for(size_t i = 0; i < size_t(image.width) * image.height; ++i)
+  {
+    for(int c = 0; c < 4; ++c)
+      image.texels[i * 4 + c] = c < channels ? file[pos + i * channels + c] : 255;
+  }
+
+  return image;
+}
+
+// 2x2 box filter. Odd sizes: the last row/column is counted twice.
+Image downsample(const Image& src)
+{
+  Image dst;
+  dst.width = std::max(src.width / 2, 1);
+  dst.height = std::max(src.height / 2, 1);
+  dst.texels.resize(size_t(dst.width) * dst.height * 4);
+
+  for(int y = 0; y < dst.height; ++y)
+  {
+    const int y0 = std::min(2 * y, src.height - 1);
+    const int y1 = std::min(2 * y + 1, src.height - 1);
+
+    for(int x = 0; x < dst.width; ++x)
+    {
+      const int x0 = std::min(2 * x, src.width - 1);
+      const int x1 = std::min(2 * x + 1, src.width - 1);
+
+      for(int c = 0; c < 4; ++c)
+      {
+        const int sum = src.texels[(y0 * src.width + x0) * 4 + c] + src.texels[(y0 * src.width + x1) * 4 + c] +
+              src.texels[(y1 * src.width + x0) * 4 + c] + src.texels[(y1 * src.width + x1) * 4 + c];
+        dst.texels[(y * dst.width + x) * 4 + c] = uint8_t((sum + 2) / 4);
+      }
+    }
+  }
+
+  return dst;
+}
+
+// Appends the blocks of 'image' to 'out'. Partial blocks repeat the last row/column.
+void encodeLevel(const Image& image, int blockSize, void (*encodeBlock)(const uint8_t*, uint8_t*), std::vector<uint8_t>& out)
+{
+  for(int by = 0; by < image.height; by += 4)
+  {
+    for(int bx = 0; bx < image.width; bx += 4)
+    {
+      uint8_t texels[16 * 4];
+
+      for(int i = 0; i < 16; ++i)
+      {
+        const int x = std::min(bx + i % 4, image.width - 1);
+        const int y = std::min(by + i / 4, image.height - 1);
+        memcpy(texels + i * 4, &image.texels[(y * image.width + x) * 4], 4);
+      }
+
+      uint8_t block[16];
+      encodeBlock(texels, block);
+      out.insert(out.end(), block, block + blockSize);
+    }
+  }
+}
+
+int run(int argc, char* argv[])
+{
+  if(argc != 4 && argc != 5)
+  {
+    fprintf(stderr, "Usage: %s <bc1|bc7|rgba8> input.ppm output.ktx2 [srgb]\n", argv[0]);
+    return 1;
+  }
+
+  const std::string format = argv[1];
+  const bool srgb = argc == 5 && std::string(argv[4]) == "srgb";
+
+  Ktx2Image result{};
+  int blockSize = 0;
+  void (*encodeBlock)(const uint8_t*, uint8_t*) = nullptr;
+
+  if(format == "bc1")
+  {
+    result.format = srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    blockSize = 8;
+    encodeBlock = encodeBC1Block;
+  }
+  else if(format == "bc7")
+  {
+    result.format = srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    blockSize = 16;
+    encodeBlock = encodeBC7Block;
+  }
+  else if(format == "rgba8")
+    result.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+  else
+    throw std::runtime_error("unknown format '" + format + "'");
+
+  // sRGB texels are averaged as they're stored, like 'createTexture' does on the CPU
+  Image level = loadNetpbm(argv[2]);
+  const size_t uncompressedSize = level.texels.size();
+
+  while(true)
+  {
+    TextureLevel info{};
+    info.width = level.width;
+    info.height = level.height;
+    info.offset = result.data.size();
+
+    if(encodeBlock)
+      encodeLevel(level, blockSize, encodeBlock, result.data);
+    else
+      result.data.insert(result.data.end(), level.texels.begin(), level.texels.end());
+
+    info.size = result.data.size() - info.offset;
+    result.levels.push_back(info);
+
+    if(level.width == 1 && level.height == 1)
+      break;
+
+    level = downsample(level);
+  }
+
+  saveKtx2(argv[3], result);
+
+  fprintf(stderr, "%s: %dx%d %s, %d mip levels, %.1f KB (first level: %.1f KB, %.1f KB as RGBA8)\n", argv[3], result.levels[0].width,
+        result.levels[0].height, format.c_str(), (int)result.levels.size(), result.data.size() / 1024.0, result.levels[0].size / 1024.0,
+        uncompressedSize / 1024.0);
+
+  return 0;
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    return run(argc, argv);
+  }
+  catch(const std::exception& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    return 1;
+  }
+}
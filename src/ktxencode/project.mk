@@ -0,0 +1,21 @@
+# Offline texture encoder, a separate executable
+TARGETS+=$(BIN)/ktxencode.exe
+
+$(BIN)/ktxencode.exe: \
+	$(BIN)/$(GetMyDir)/main.cpp.o\
+	$(BIN)/$(GetMyDir)/bcencoder.cpp.o\
+	$(BIN)/src/common/ktx2.cpp.o\
+	$(BIN)/src/common/util.cpp.o\
+
+# Texture assets: 'bin/data/name-format.ktx2' from 'data/name.ppm'
+$(BIN)/data/%-bc1.ktx2: data/%.ppm $(BIN)/ktxencode.exe
+	@mkdir -p $(dir $@)
+	$(BIN)/ktxencode.exe bc1 "$<" "$@"
+
+$(BIN)/data/%-bc7.ktx2: data/%.ppm $(BIN)/ktxencode.exe
+	@mkdir -p $(dir $@)
+	$(BIN)/ktxencode.exe bc7 "$<" "$@"
+
+$(BIN)/data/%-rgba8.ktx2: data/%.ppm $(BIN)/ktxencode.exe
+	@mkdir -p $(dir $@)
+	$(BIN)/ktxencode.exe rgba8 "$<" "$@"
@@ -1,4 +1,5 @@
 #include "common/app.h"
+#include "common/descriptorallocator.h"
 #include "common/matrix4.h"
 #include "common/util.h"
 #include "common/vkutil.h"
@@ -11,6 +12,8 @@ namespace
 {
 const VkFormat DepthFormat = VK_FORMAT_D16_UNORM;
 const int ShadowMapSize = 4096;
+const float ShadowDepthBiasConstant = 2.0f; // in steps of DepthFormat, see 'createShadowMapPipeline'
+const float ShadowDepthBiasSlope = 2.0f; // times the depth slope of the polygon, per texel
 
 ///////////////////////////////////////////////////////////////////////////////
 // Vertex
@@ -153,36 +156,25 @@ VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device)
   return descriptorSetLayout;
 }
 
-VkDescriptorPool createDescriptorPool(VkDevice device)
+// Per draw, see 'shader.vert.glsl'
+struct MyPushConstantBlock
 {
-  VkDescriptorPoolSize sizes[2];
-
-  // Uniform buffers
-  sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  sizes[0].descriptorCount = 2;
-
-  // Samplers
-  sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  sizes[1].descriptorCount = 2;
-
-  // Create the global descriptor pool
-  VkDescriptorPoolCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  info.poolSizeCount = lengthof(sizes);
-  info.pPoolSizes = sizes;
-  info.maxSets = 2; // number of desc sets that can be allocated from this pool
-
-  VkDescriptorPool descriptorPool;
-  vkCreateDescriptorPool(device, &info, nullptr, &descriptorPool);
-  return descriptorPool;
-}
+  PackedAffine model;
+};
 
 VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout)
 {
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(MyPushConstantBlock);
+
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   pipelineLayoutInfo.setLayoutCount = 1;
   pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
   VkPipelineLayout pipelineLayout;
 
@@ -245,7 +237,11 @@ VkPipeline createShadowMapPipeline(VkDevice device, VkPipelineLayout pipelineLay
   rasterizer.lineWidth = 1.0f;
   rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
   rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-  rasterizer.depthBiasEnable = VK_FALSE;
+
+  // pushes the casters away from the light, so the receivers don't shadow themselves
+  rasterizer.depthBiasEnable = VK_TRUE;
+  rasterizer.depthBiasConstantFactor = ShadowDepthBiasConstant;
+  rasterizer.depthBiasSlopeFactor = ShadowDepthBiasSlope;
 
   VkPipelineMultisampleStateCreateInfo multisampling{};
   multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
@@ -407,18 +403,6 @@ VkBuffer createVertexBuffer(VkDevice device, size_t size)
   return vertexBuffer;
 }
 
-VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout)
-{
-  VkDescriptorSetAllocateInfo allocateInfo{};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocateInfo.descriptorPool = pool;
-  allocateInfo.descriptorSetCount = 1;
-  allocateInfo.pSetLayouts = &layout;
-  VkDescriptorSet descriptorSet;
-  vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
-  return descriptorSet;
-}
-
 struct VulkanTexture
 {
   VkImage image;
@@ -476,16 +460,22 @@ VulkanTexture createFramebufferForShadowMap(VkDevice device, VkPhysicalDevice ph
     vkCreateImageView(device, &info, nullptr, &result.view);
   }
 
-  // Create sampler
+  // Create sampler: depth compare (sampler2DShadow), with linear filtering each lookup blends 2x2 compares
   {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, DepthFormat, &properties);
+    const bool linear = properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
     VkSamplerCreateInfo info{};
     info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    info.magFilter = VK_FILTER_NEAREST;
-    info.minFilter = VK_FILTER_NEAREST;
+    info.magFilter = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    info.minFilter = linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
     info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    info.compareEnable = VK_TRUE;
+    info.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL; // lit: in front of the casters
     info.mipLodBias = 0.0f;
     info.maxAnisotropy = 1.0f;
     info.minLod = 0.0f;
@@ -520,12 +510,12 @@ void destroyTexture(VkDevice device, const VulkanTexture& texture)
   vkFreeMemory(device, texture.memory, nullptr);
 }
 
+// Per pass: the model transform is in 'MyPushConstantBlock'
 struct MyUniformBlock
 {
-  Matrix4f model;
   Matrix4f view;
   Matrix4f proj;
-  Matrix4f LightMVP;
+  Matrix4f LightViewProj;
 };
 
 VkRenderPass createShadowMapRenderPass(VkDevice device)
@@ -587,12 +577,12 @@ class ShadowMap : public IApp
 {
 public:
   ShadowMap(const AppCreationContext& ctx_)
-      : ctx(ctx_)
+      : descriptorAllocator(ctx_.device)
+      , ctx(ctx_)
   {
-    descriptorPool = createDescriptorPool(ctx.device);
     descriptorSetLayout = createDescriptorSetLayout(ctx.device);
-    mainSceneDescriptorSet = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
-    shadowMapDescriptorSet = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
+    mainSceneDescriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
+    shadowMapDescriptorSet = descriptorAllocator.allocate(descriptorSetLayout);
 
     shadowMapRenderPass = createShadowMapRenderPass(ctx.device);
 
@@ -703,7 +693,6 @@ public:
     vkDestroyRenderPass(ctx.device, shadowMapRenderPass, nullptr);
 
     vkDestroyDescriptorSetLayout(ctx.device, descriptorSetLayout, nullptr);
-    vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
   }
 
   Camera m_camera;
@@ -717,7 +706,6 @@ public:
 
     const Matrix4f lightView = lookAt({6, 2, 7}, {}, {0, 0, 1});
     const Matrix4f lightProj = perspective(1.5, 1, 1, 100);
-    const Matrix4f mvpLight = lightProj * lightView * model;
 
     {
       VkClearValue clearDepth{};
@@ -743,17 +731,19 @@ public:
       vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &shadowMapDescriptorSet, 0, nullptr);
 
       MyUniformBlock constants{};
-      constants.model = model;
       constants.view = lightView;
       constants.proj = lightProj;
 
       // convert row-major (app) to column-major (GLSL)
-      constants.model = transpose(constants.model);
       constants.view = transpose(constants.view);
       constants.proj = transpose(constants.proj);
 
       writeToGpuMemory(ctx.device, shadowMapUniformBufferMemory, &constants, sizeof constants);
 
+      MyPushConstantBlock pushConstants{};
+      pushConstants.model = packAffine(model);
+      vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pushConstants, &pushConstants);
+
       vkCmdDraw(commandBuffer, lengthof(vertices), 1, 0, 0);
 
       vkCmdEndRenderPass(commandBuffer);
@@ -786,19 +776,21 @@ public:
       vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &mainSceneDescriptorSet, 0, nullptr);
 
       MyUniformBlock constants{};
-      constants.model = model;
       constants.view = m_camera.mat;
       constants.proj = perspective(1.5, 4.0 / 3.0, 0.1, 100);
-      constants.LightMVP = mvpLight;
+      constants.LightViewProj = lightProj * lightView;
 
       // convert row-major (app) to column-major (GLSL)
-      constants.model = transpose(constants.model);
       constants.view = transpose(constants.view);
       constants.proj = transpose(constants.proj);
-      constants.LightMVP = transpose(constants.LightMVP);
+      constants.LightViewProj = transpose(constants.LightViewProj);
 
       writeToGpuMemory(ctx.device, uniformBufferMemory, &constants, sizeof constants);
 
+      MyPushConstantBlock pushConstants{};
+      pushConstants.model = packAffine(model);
+      vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof pushConstants, &pushConstants);
+
       vkCmdDraw(commandBuffer, lengthof(vertices), 1, 0, 0);
 
       vkCmdEndRenderPass(commandBuffer);
@@ -812,7 +804,7 @@ private:
   VkBuffer vertexBuffer{};
   VkDeviceMemory vertexBufferMemory{};
   VkDescriptorSetLayout descriptorSetLayout{};
-  VkDescriptorPool descriptorPool{};
+  DescriptorAllocator descriptorAllocator;
   VkDescriptorSet mainSceneDescriptorSet{};
   VkDescriptorSet shadowMapDescriptorSet{};
   VkBuffer uniformBuffer{};
@@ -5,7 +5,8 @@ layout(location = 1) in vec4 fragPositionLightSpace;
 
 layout(location = 0) out vec4 outColor;
 
-layout(binding = 0) uniform sampler2D shadowMapSampler;
+// Depth compare sampler: returns the lit fraction of 2x2 texels. The bias is in the shadow map pipeline.
+layout(binding = 0) uniform sampler2DShadow shadowMapSampler;
 
 vec3 checkerTexture(vec2 uv)
 {
@@ -23,12 +24,7 @@ float computeShadow(vec4 pos)
   vec2 uv = pos.xy * 0.5 + 0.5;
   uv.y = 1-uv.y;
 
-  float dist = texture(shadowMapSampler, uv).r;
-
-  if (dist >= pos.z - 0.01)
-    return 1;
-
-  return 0.5; // in shadow
+  return mix(0.5, 1.0, texture(shadowMapSampler, vec3(uv, pos.z))); // 0.5: in shadow
 }
 
 void main()
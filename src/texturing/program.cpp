@@ -1,8 +1,16 @@
 #include "common/app.h"
+#include "common/descriptorallocator.h"
+#include "common/ktx2.h"
+#include "common/texture.h"
+#include "common/uploadstreamer.h"
 #include "common/util.h"
 #include "common/vkutil.h"
 
+#include <cstdio>
+#include <cstring> // memcpy
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 namespace
@@ -94,30 +102,6 @@ VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device)
   return descriptorSetLayout;
 }
 
-VkDescriptorPool createDescriptorPool(VkDevice device)
-{
-  VkDescriptorPoolSize sizes[2];
-
-  // Samplers : 1 total
-  sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  sizes[0].descriptorCount = 1;
-
-  // Uniform buffers : 1 total
-  sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  sizes[1].descriptorCount = 1;
-
-  // Create the global descriptor pool
-  VkDescriptorPoolCreateInfo info{};
-  info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  info.poolSizeCount = lengthof(sizes);
-  info.pPoolSizes = sizes;
-  info.maxSets = 1; // number of desc sets that can be allocated from this pool
-
-  VkDescriptorPool descriptorPool;
-  vkCreateDescriptorPool(device, &info, nullptr, &descriptorPool);
-  return descriptorPool;
-}
-
 VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout)
 {
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
@@ -257,216 +241,60 @@ VkBuffer createVertexBuffer(VkDevice device, size_t size)
   return vertexBuffer;
 }
 
-VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout layout)
-{
-  VkDescriptorSetAllocateInfo allocateInfo{};
-  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  allocateInfo.descriptorPool = pool;
-  allocateInfo.descriptorSetCount = 1;
-  allocateInfo.pSetLayouts = &layout;
-  VkDescriptorSet descriptorSet;
-  vkAllocateDescriptorSets(device, &allocateInfo, &descriptorSet);
-  return descriptorSet;
-}
-
-static int findTransferQueue(VkPhysicalDevice device)
+// Same picture as 'data/checkerboard.ppm', in floats: 16 bytes per texel
+Texture createCheckerboardTexture(ImmediateSubmitter& immediate, VkPhysicalDevice physicalDevice)
 {
-  uint32_t queueFamilyCount = 0;
-  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-  int i = 0;
-
-  for(const auto& queueFamily : queueFamilies)
+  struct Pixel
   {
-    if(queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
-      return i;
-  }
-
-  return 0;
-}
-
-void setImageLayout(VkCommandBuffer cmdbuffer,
-      VkImage image,
-      VkImageLayout oldImageLayout,
-      VkImageLayout newImageLayout,
-      VkImageSubresourceRange subresourceRange)
-{
-  VkImageMemoryBarrier imageMemoryBarrier{};
-  imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-  imageMemoryBarrier.oldLayout = oldImageLayout;
-  imageMemoryBarrier.newLayout = newImageLayout;
-  imageMemoryBarrier.image = image;
-  imageMemoryBarrier.subresourceRange = subresourceRange;
-
-  // Make sure any writes to the image have been finished
-  imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-  vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-}
-
-struct VulkanTexture
-{
-  VkImage image;
-  VkImageView view;
-  VkDeviceMemory memory;
-  VkSampler sampler;
-};
-
-VulkanTexture createTexture(VkDevice device, VkPhysicalDevice physicalDevice, void* srcPixels, int width, int height)
-{
-  const int bufferSize = width * height * sizeof(float) * 4;
-
-  // Create a host-visible staging buffer that contains the raw image data
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingMemory;
+    float r, g, b, a;
+  };
 
-  // This buffer is used as a transfer source for the buffer copy
+  const int N = 128;
+  const int period = N / 4;
+  Pixel tex[N][N]{};
+  for(int y = 0; y < N; ++y)
   {
+    for(int x = 0; x < N; ++x)
     {
-      VkBufferCreateInfo info{};
-      info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-      info.size = bufferSize;
-      info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-      info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-      vkCreateBuffer(device, &info, nullptr, &stagingBuffer);
-    }
-
-    // Get memory requirements for the staging buffer (alignment, memory type bits)
-    VkMemoryRequirements memReqs;
-    vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-
-    // Allocate memory for the staging buffer
-    {
-      VkMemoryAllocateInfo memAllocInfo{};
-      memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      memAllocInfo.allocationSize = memReqs.size;
-      memAllocInfo.memoryTypeIndex =
-            findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-      vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory);
+      tex[y][x].a = 1;
+      if((x / period) % 2 == (y / period) % 2)
+      {
+        tex[y][x].r = 1;
+        tex[y][x].g = 1;
+        tex[y][x].b = 1;
+      }
+      else
+      {
+        tex[y][x].r = 1;
+        tex[y][x].g = 0;
+        tex[y][x].b = 0;
+      }
     }
-
-    vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
   }
 
-  // Copy texture data into staging buffer
-  writeToGpuMemory(device, stagingMemory, srcPixels, bufferSize);
-
-  auto const format = VK_FORMAT_R32G32B32A32_SFLOAT;
-
-  VulkanTexture texture{};
+  return createTexture(immediate, physicalDevice, tex, N, N);
+}
 
-  // Create optimal tiled target image
-  {
-    VkImageCreateInfo info{};
-    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    info.imageType = VK_IMAGE_TYPE_2D;
-    info.format = format;
-    info.mipLevels = 1;
-    info.arrayLayers = 1;
-    info.samples = VK_SAMPLE_COUNT_1_BIT;
-    info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    info.extent = {(uint32_t)width, (uint32_t)height, 1};
-    info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-    // Ensure that the TRANSFER_DST bit is set for staging
-    info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    vkCreateImage(device, &info, nullptr, &texture.image);
-  }
+// 'compression': 1 for BC1, 7 for BC7. Falls back to the RGBA8 version if the device can't sample the BC format.
+Ktx2Image loadCheckerboardImage(VkPhysicalDevice physicalDevice, int compression)
+{
+  const std::string path = std::string("bin/data/checkerboard-") + (compression == 1 ? "bc1" : "bc7") + ".ktx2";
+  auto image = loadKtx2(path.c_str());
 
-  // Allocate memory for the texture image
+  if(!isTextureFormatSupported(physicalDevice, image.format))
   {
-    {
-      VkMemoryRequirements memReqs;
-      vkGetImageMemoryRequirements(device, texture.image, &memReqs);
-
-      VkMemoryAllocateInfo info{};
-      info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-      info.allocationSize = memReqs.size;
-      info.memoryTypeIndex = findMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-      vkAllocateMemory(device, &info, nullptr, &texture.memory);
-    }
-
-    vkBindImageMemory(device, texture.image, texture.memory, 0);
+    fprintf(stderr, "'%s': format not supported by the device, using the RGBA8 version\n", path.c_str());
+    image = loadKtx2("bin/data/checkerboard-rgba8.ktx2");
   }
 
-  auto TransferDataFromStagingBufferToTexture = [&](VkCommandBuffer cmdBuf) {
-    // Image barrier for optimal image (target)
-    // Optimal image will be used as destination for the copy
-    VkImageSubresourceRange range{};
-    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    range.baseMipLevel = 0;
-    range.levelCount = 1;
-    range.layerCount = 1;
-
-    setImageLayout(cmdBuf, texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
-
-    // Copy data from staging buffer
-    VkBufferImageCopy region{};
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageExtent.width = width;
-    region.imageExtent.height = height;
-    region.imageExtent.depth = 1;
-    region.bufferOffset = 0;
-
-    vkCmdCopyBufferToImage(cmdBuf, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    setImageLayout(cmdBuf, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
-  };
-
-  const int transferQueue = findTransferQueue(physicalDevice);
-  executeOneShotCommandBufferOnQueue(device, TransferDataFromStagingBufferToTexture, transferQueue);
-
-  // Clean up staging resources
-  vkFreeMemory(device, stagingMemory, nullptr);
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-
-  // Create sampler
-  VkSamplerCreateInfo samplerCreateInfo{};
-  samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
-  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
-  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-  samplerCreateInfo.mipLodBias = 0.0f;
-  samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
-  samplerCreateInfo.minLod = 0.0f;
-  samplerCreateInfo.maxLod = 0.0f;
-  samplerCreateInfo.maxAnisotropy = 1.0f;
-  vkCreateSampler(device, &samplerCreateInfo, nullptr, &texture.sampler);
-
-  // Create image view
-  VkImageViewCreateInfo viewCreateInfo{};
-  viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-  viewCreateInfo.pNext = NULL;
-  viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-  viewCreateInfo.format = format;
-  viewCreateInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
-  viewCreateInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-  viewCreateInfo.subresourceRange.levelCount = 1;
-  viewCreateInfo.image = texture.image;
-  vkCreateImageView(device, &viewCreateInfo, nullptr, &texture.view);
-
-  return texture;
+  return image;
 }
 
-void destroyTexture(VkDevice device, const VulkanTexture& texture)
+// Drawn until the streamed checkerboard is resident
+Texture createPlaceholderTexture(ImmediateSubmitter& immediate, VkPhysicalDevice physicalDevice)
 {
-  vkDestroyImageView(device, texture.view, nullptr);
-  vkDestroySampler(device, texture.sampler, nullptr);
-  vkDestroyImage(device, texture.image, nullptr);
-  vkFreeMemory(device, texture.memory, nullptr);
+  const float grey[4] = {0.5f, 0.5f, 0.5f, 1.0f};
+  return createTexture(immediate, physicalDevice, grey, 1, 1, VK_FORMAT_R32G32B32A32_SFLOAT, false);
 }
 
 struct MyUniformBlock
@@ -474,23 +302,38 @@ struct MyUniformBlock
   float angle;
 };
 
+std::vector<DescriptorWrite> describeDescriptorSet(const Texture& texture, VkBuffer uniformBuffer)
+{
+  return {
+        imageDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture.view, texture.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+        bufferDescriptor(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer, sizeof(MyUniformBlock)),
+  };
+}
+
 class Texturing : public IApp
 {
 public:
   Texturing(const AppCreationContext& ctx_)
-      : ctx(ctx_)
+      : descriptorAllocator(ctx_.device)
+      , ctx(ctx_)
   {
-    descriptorPool = createDescriptorPool(ctx.device);
     descriptorSetLayout = createDescriptorSetLayout(ctx.device);
-    descriptorSet = createDescriptorSet(ctx.device, descriptorPool, descriptorSetLayout);
 
     pipelineLayout = createPipelineLayout(ctx.device, descriptorSetLayout);
     graphicsPipeline = createGraphicsPipeline(ctx.device, pipelineLayout, ctx.swapchainExtent, ctx.renderPass);
 
-    // Create the vertex buffer and send it to the GPU
-    vertexBuffer = createVertexBuffer(ctx.device, lengthof(vertices) * sizeof(vertices[0]));
-    vertexBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, vertexBuffer);
-    writeToGpuMemory(ctx.device, vertexBufferMemory, vertices, lengthof(vertices) * sizeof(vertices[0]));
+    // 'stream': the texture and the vertex buffer are uploaded in the background (see uploadstreamer.h).
+    // The triangle appears once its vertices are resident, with a placeholder until the texture is.
+    if(getOption("stream", 0))
+      streamer.reset(new UploadStreamer(ctx.device, ctx.physicalDevice, ctx.graphicsQueueFamily, ctx.transferQueueFamily));
+
+    // Create the vertex buffer and send it to the GPU. When streaming, the streamer owns it.
+    if(!streamer)
+    {
+      vertexBuffer = createVertexBuffer(ctx.device, lengthof(vertices) * sizeof(vertices[0]));
+      vertexBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, vertexBuffer);
+      writeToGpuMemory(ctx.device, vertexBufferMemory, vertices, lengthof(vertices) * sizeof(vertices[0]));
+    }
 
     {
       VkBufferCreateInfo info{};
@@ -505,76 +348,48 @@ public:
       uniformBufferMemory = createBufferMemory(ctx.physicalDevice, ctx.device, uniformBuffer);
     }
 
-    // Create the texture image
-    struct Pixel
-    {
-      float r, g, b, a;
-    };
+    // 'ktx': 0 for the procedural texture, 1 or 7 for the BC1 or BC7 asset (see src/ktxencode)
+    const int ktx = getOption("ktx", 0);
 
-    const int N = 128;
-    const int period = N / 4;
-    Pixel tex[N][N]{};
-    for(int y = 0; y < N; ++y)
+    if(streamer)
     {
-      for(int x = 0; x < N; ++x)
-      {
-        tex[y][x].a = 1;
-        if((x / period) % 2 == (y / period) % 2)
-        {
-          tex[y][x].r = 1;
-          tex[y][x].g = 1;
-          tex[y][x].b = 1;
-        }
-        else
-        {
-          tex[y][x].r = 1;
-          tex[y][x].g = 0;
-          tex[y][x].b = 0;
-        }
-      }
-    }
+      const VkPhysicalDevice physicalDevice = ctx.physicalDevice;
+      const int compression = ktx ? ktx : 7;
 
-    texture = createTexture(ctx.device, ctx.physicalDevice, tex, N, N);
+      streamedTexture = streamer->streamTexture("checkerboard", [physicalDevice, compression]() { return loadCheckerboardImage(physicalDevice, compression); });
+      streamedVertices = streamer->streamBuffer("triangle", VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, []() {
+        std::vector<uint8_t> data(sizeof vertices);
+        memcpy(data.data(), vertices, sizeof vertices);
+        return data;
+      });
 
-    // associate descriptor sets and buffers
+      texture = createPlaceholderTexture(*ctx.immediate, ctx.physicalDevice);
+    }
+    else if(ktx)
     {
-      VkDescriptorImageInfo info{};
-      info.sampler = texture.sampler;
-      info.imageView = texture.view;
-      info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-      // Binding 0: Sampler
-      VkWriteDescriptorSet writeDescriptorSets[1]{};
-      writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      writeDescriptorSets[0].dstSet = descriptorSet;
-      writeDescriptorSets[0].dstBinding = 0;
-      writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-      writeDescriptorSets[0].pImageInfo = &info;
-      writeDescriptorSets[0].descriptorCount = 1;
-
-      vkUpdateDescriptorSets(ctx.device, lengthof(writeDescriptorSets), writeDescriptorSets, 0, nullptr);
+      const auto image = loadCheckerboardImage(ctx.physicalDevice, ktx);
+      texture = createTextureFromLevels(*ctx.immediate, ctx.physicalDevice, image.format, image.levels, image.data.data());
+      printTextureSummary("checkerboard", texture);
     }
-
+    else
     {
-      VkDescriptorBufferInfo info{};
-      info.buffer = uniformBuffer;
-      info.range = sizeof(MyUniformBlock);
-
-      // Binding 1: uniform buffer
-      VkWriteDescriptorSet writeDescriptorSets[1]{};
-      writeDescriptorSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      writeDescriptorSets[0].dstSet = descriptorSet;
-      writeDescriptorSets[0].dstBinding = 1;
-      writeDescriptorSets[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      writeDescriptorSets[0].pBufferInfo = &info;
-      writeDescriptorSets[0].descriptorCount = 1;
-
-      vkUpdateDescriptorSets(ctx.device, lengthof(writeDescriptorSets), writeDescriptorSets, 0, nullptr);
+      texture = createCheckerboardTexture(*ctx.immediate, ctx.physicalDevice);
+      printTextureSummary("checkerboard", texture);
     }
   }
 
   ~Texturing()
   {
+    if(streamer)
+      streamer->printSummary();
+
+    // the cached descriptor sets must not outlive the textures
+    if(streamer && streamer->isResident(streamedTexture))
+      forgetTexture(streamer->getTexture(streamedTexture));
+
+    forgetTexture(texture);
+
+    streamer.reset();
     destroyTexture(ctx.device, texture);
 
     vkDestroyBuffer(ctx.device, uniformBuffer, nullptr);
@@ -584,15 +399,27 @@ public:
     vkDestroyPipeline(ctx.device, graphicsPipeline, nullptr);
     vkDestroyPipelineLayout(ctx.device, pipelineLayout, nullptr);
 
-    // vkFreeDescriptorSets(ctx.device, descriptorPool, 1, &descriptorSet);
     vkDestroyDescriptorSetLayout(ctx.device, descriptorSetLayout, nullptr);
-    vkDestroyDescriptorPool(ctx.device, descriptorPool, nullptr);
   }
 
   void drawFrame(double time, VkFramebuffer framebuffer, VkCommandBuffer commandBuffer) override
   {
     (void)time;
 
+    // Before recording: submits the staged uploads, and picks the assets which are now resident
+    const Texture* drawnTexture = &texture;
+    VkBuffer drawnVertices = vertexBuffer;
+
+    if(streamer)
+    {
+      streamer->update();
+
+      if(streamer->isResident(streamedTexture))
+        drawnTexture = &streamer->getTexture(streamedTexture);
+
+      drawnVertices = streamer->isResident(streamedVertices) ? streamer->getBuffer(streamedVertices) : VK_NULL_HANDLE;
+    }
+
     VkClearValue clearColor{};
     clearColor.color.float32[0] = 0.0f;
     clearColor.color.float32[1] = 0.0f;
@@ -610,34 +437,48 @@ public:
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-    VkBuffer vertexBuffers[] = {vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
     MyUniformBlock constants;
     constants.angle = time * 2;
     writeToGpuMemory(ctx.device, uniformBufferMemory, &constants, sizeof constants);
 
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    if(drawnVertices)
+    {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+      VkBuffer vertexBuffers[] = {drawnVertices};
+      VkDeviceSize offsets[] = {0};
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+
+      // one set per texture: a set used by a frame in flight can't be rewritten
+      auto descriptorSet = descriptorAllocator.getSet(descriptorSetLayout, describeDescriptorSet(*drawnTexture, uniformBuffer));
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+      vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    }
 
     vkCmdEndRenderPass(commandBuffer);
   }
 
 private:
+  void forgetTexture(const Texture& destroyed)
+  {
+    descriptorAllocator.forget(destroyed.view);
+    descriptorAllocator.forget(destroyed.sampler);
+  }
+
   VkPipelineLayout pipelineLayout{};
   VkPipeline graphicsPipeline{};
-  VkBuffer vertexBuffer{};
+  VkBuffer vertexBuffer{}; // null when streaming
   VkDeviceMemory vertexBufferMemory{};
   VkDescriptorSetLayout descriptorSetLayout{};
-  VkDescriptorPool descriptorPool{};
-  VkDescriptorSet descriptorSet{};
+  DescriptorAllocator descriptorAllocator;
   VkBuffer uniformBuffer{};
   VkDeviceMemory uniformBufferMemory{};
-  VulkanTexture texture{};
+  Texture texture{}; // the placeholder, when streaming
+
+  std::unique_ptr<UploadStreamer> streamer; // 'stream' option
+  int streamedTexture = -1;
+  int streamedVertices = -1;
 
   const AppCreationContext ctx;
 };
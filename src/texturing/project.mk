@@ -1,3 +1,8 @@
 SRCS+=$(GetMyDir)/program.cpp
 SHADERS+=$(GetMyDir)/shader.vert.glsl
 SHADERS+=$(GetMyDir)/shader.frag.glsl
+
+# see the 'ktx' option
+TARGETS+=$(BIN)/data/checkerboard-bc1.ktx2
+TARGETS+=$(BIN)/data/checkerboard-bc7.ktx2
+TARGETS+=$(BIN)/data/checkerboard-rgba8.ktx2